@@ -4,6 +4,10 @@
 #define COMPILED_MODEL_EXECUTE_HPP_
 #include "include/core/tensor.hpp"
 namespace RVTensor {
-RamTensor::sptr yolov3_model_execute(RamTensor::sptr input_yolov3_0);
+// output: tensor the last op writes into, allocated when nullptr
+RamTensor::sptr yolov3_model_execute(RamTensor::sptr input_yolov3_0,
+                                     RamTensor::sptr output = nullptr);
+// float32 reference pass of rvtensor_calibrate, host builds only
+RamTensor::sptr yolov3_model_calibrate(RamTensor::sptr input_yolov3_0);
 }
 #endif // COMPILED_MODEL_EXECUTE_HPP_
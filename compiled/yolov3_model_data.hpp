@@ -17,5 +17,16 @@ static uint8_t conv_kpu_0_weight_fix8_data[] __attribute__((aligned(128))) = {
 static uint8_t conv_kpu_0_bias_fix8_data[] __attribute__((aligned(128))) = {
 0x12, 0x15, 0x22, 0x11, 0x10, 0x14, 0x11};
 
+// RVTensor calibration begin
+static const float graph_cpu_0_output0_min_range = 0.000000000e+00f;
+static const float graph_cpu_0_output0_max_range = 2.550000000e+02f;
+static const float graph_cpu_0_output0_scale = 1.000000000e+00f;
+static const int32_t graph_cpu_0_output0_zero_point = 0;
+static const float input_yolov3_0_min_range = 0.000000000e+00f;
+static const float input_yolov3_0_max_range = 2.550000000e+02f;
+static const float input_yolov3_0_scale = 1.000000000e+00f;
+static const int32_t input_yolov3_0_zero_point = 0;
+// RVTensor calibration end
+
 }
 #endif // COMPILED_YOLOV3_MODEL_DATA_HPP_
@@ -4,7 +4,9 @@
 #include "include/core/tensor.hpp"
 #include "include/core/types.hpp"
 #include "include/ops/conv.hpp"
+#if RVTENSOR_KENDRYTE
 #include "include/ops/kpu/kpu_conv.hpp"
+#endif
 #include "model_execute.hpp"
 // #include "graph_cpu_0.hpp"
 // #include "graph_kpu_0.hpp"
@@ -23,7 +25,7 @@ void graph_cpu_0_execute(RamTensor::sptr input_0, RamTensor::sptr output_0) {
   CPUConvOp::sptr conv_cpu_0_fix8 = CPUConvOp::create(conv_cpu_0_param,
         conv_cpu_0_input_0, conv_cpu_0_output_0,
         conv_cpu_0_weight_fix8, nullptr);
-  conv_cpu_0_fix8->forward_compute();
+  conv_cpu_0_fix8->run();
 }
 
 // void graph_kpu_0_execute(RamTensor::sptr input_0, RamTensor::sptr output_0) {
@@ -43,10 +45,20 @@ void graph_cpu_0_execute(RamTensor::sptr input_0, RamTensor::sptr output_0) {
 //   // delete conv_kpu_0_fix8;
 // }
 
-RamTensor::sptr yolov3_model_execute(RamTensor::sptr input_yolov3_0) {
+RamTensor::sptr yolov3_model_execute(RamTensor::sptr input_yolov3_0,
+                                     RamTensor::sptr output) {
+  input_yolov3_0->setName("input_yolov3_0");
+  input_yolov3_0->setQuantizeParams(input_yolov3_0_min_range,
+      input_yolov3_0_max_range, input_yolov3_0_scale,
+      input_yolov3_0_zero_point);
   RamTensor::sptr graph_cpu_0_input0 = input_yolov3_0;
 
-  RamTensor::sptr graph_cpu_0_output0 = RamTensor::create(1, 16, 240, 320, 1u);
+  RamTensor::sptr graph_cpu_0_output0 = output ? output :
+      RamTensor::create(1, 16, 240, 320, 1u);
+  graph_cpu_0_output0->setName("graph_cpu_0_output0");
+  graph_cpu_0_output0->setQuantizeParams(graph_cpu_0_output0_min_range,
+      graph_cpu_0_output0_max_range, graph_cpu_0_output0_scale,
+      graph_cpu_0_output0_zero_point);
   graph_cpu_0_execute(graph_cpu_0_input0, graph_cpu_0_output0);
 
 
@@ -60,6 +72,19 @@ RamTensor::sptr yolov3_model_execute(RamTensor::sptr input_yolov3_0) {
   return graph_cpu_0_output0;
 }
 
+#if !RVTENSOR_KENDRYTE
+RamTensor::sptr yolov3_model_calibrate(RamTensor::sptr input_yolov3_0) {
+  input_yolov3_0->setName("input_yolov3_0");
+  input_yolov3_0->setQuantizeParams(input_yolov3_0_min_range,
+      input_yolov3_0_max_range, input_yolov3_0_scale,
+      input_yolov3_0_zero_point);
+  RamTensor::sptr graph_cpu_0_output0 = RamTensor::create(1, 16, 240, 320, 4u);
+  graph_cpu_0_output0->setName("graph_cpu_0_output0");
+  graph_cpu_0_execute(input_yolov3_0, graph_cpu_0_output0);
+  return graph_cpu_0_output0;
+}
+#endif  // !RVTENSOR_KENDRYTE
+
 // void graph_cpu_1_execute(RamTensor::sptr input_0, RamTensor::sptr input_1,
 //   RamTensor::sptr output_0) {
 // {
@@ -0,0 +1,31 @@
+# riscv64 linux with the vector extension, e.g.
+#   cmake -DCMAKE_TOOLCHAIN_FILE=../environments/riscv64-linux.toolchain.cmake \
+#         -DTOOLCHAIN_DIR=/opt/riscv ..
+# the RVV intrinsics need gcc 13 or clang 16 or later
+set (CMAKE_SYSTEM_NAME "Linux")
+set (CMAKE_SYSTEM_PROCESSOR riscv64)
+set (RVV True)
+
+if(NOT TOOLCHAIN_DIR)
+    set(TOOLCHAIN_DIR /usr)
+endif()
+set(CMAKE_C_COMPILER ${TOOLCHAIN_DIR}/bin/riscv64-linux-gnu-gcc)
+set(CMAKE_CXX_COMPILER ${TOOLCHAIN_DIR}/bin/riscv64-linux-gnu-g++)
+
+set(CMAKE_TOOLCHAIN_PREFIX riscv64-linux-gnu-)
+
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
+
+# the tools built for the target run on the host under user mode qemu
+if(NOT QEMU_VLEN)
+    set(QEMU_VLEN 128)
+endif()
+set(CMAKE_CROSSCOMPILING_EMULATOR qemu-riscv64 -cpu rv64,v=true,vlen=${QEMU_VLEN}
+    -L ${TOOLCHAIN_DIR}/riscv64-linux-gnu)
+
+add_compile_options(-march=rv64gcv)
+add_compile_options(-mabi=lp64d)
+set(CMAKE_CXX_FLAGS "-O2 -std=gnu++11 ${CMAKE_CXX_FLAGS}")
+set(CMAKE_C_FLAGS "-O2 -std=gnu11 ${CMAKE_C_FLAGS}")
@@ -15,8 +15,7 @@
 #include <sys/unistd.h>
 #include <devices.h>
 #include "dvp_camera.h"
-
-extern uint8_t* g_ai_buf;
+#include "extern.h"
 
 enum _data_for
 {
@@ -30,11 +29,11 @@ enum _enable
     ENABLE = 1,
 } ;
 
-volatile uint8_t dvp_finish_flag;
-volatile uint8_t gram_mux;
 handle_t file_dvp;
-uint32_t lcd_gram0[38400] __attribute__((aligned(64)));
-uint32_t lcd_gram1[38400] __attribute__((aligned(64)));
+uint32_t lcd_gram[DVP_SLOT_NUM][38400] __attribute__((aligned(64)));
+static void* dvp_pipeline;
+/* slot the sensor is writing to */
+static volatile int dvp_slot;
 
 void sensor_restart()
 {
@@ -48,7 +47,11 @@ void sensor_restart()
     usleep(200 * 1000);
 }
 
-extern volatile uint8_t refresh_flag;
+static void dvp_set_slot(int slot)
+{
+    dvp_set_output_attributes(file_dvp, DATA_FOR_DISPLAY, VIDEO_FMT_RGB565, lcd_gram[slot]);
+    dvp_set_output_attributes(file_dvp, DATA_FOR_AI, VIDEO_FMT_RGB24_PLANAR, pipeline_slot_buffer(dvp_pipeline, slot));
+}
 
 void on_irq_dvp(dvp_frame_event_t event, void* userdata)
 {
@@ -58,16 +61,28 @@ void on_irq_dvp(dvp_frame_event_t event, void* userdata)
             dvp_enable_frame(file_dvp);
             break;
         case VIDEO_FE_END:
-            dvp_set_output_attributes(file_dvp, DATA_FOR_DISPLAY, VIDEO_FMT_RGB565, gram_mux ? lcd_gram0 : lcd_gram1);
-            dvp_finish_flag = 1;
+        {
+            /* hand the frame to inference and capture into a free slot,
+               if all slots are busy the next frame overwrites this one */
+            int next = pipeline_acquire_slot_from_isr(dvp_pipeline);
+            if (next >= 0)
+            {
+                pipeline_submit_slot_from_isr(dvp_pipeline, dvp_slot);
+                dvp_slot = next;
+                dvp_set_slot(next);
+            }
             break;
+        }
         default:
             configASSERT(!"Invalid event.");
     }
 }
 
-void dvp_init(void* ai_buf)
+void dvp_init(void* pipeline)
 {
+    dvp_pipeline = pipeline;
+    dvp_slot = pipeline_acquire_slot(pipeline);
+
     file_dvp = io_open("/dev/dvp0");
     configASSERT(file_dvp);
     sensor_restart();
@@ -77,9 +92,7 @@ void dvp_init(void* ai_buf)
     dvp_set_output_enable(file_dvp, DATA_FOR_AI, ENABLE);
     dvp_set_output_enable(file_dvp, DATA_FOR_DISPLAY, ENABLE);
 
-    dvp_set_output_attributes(file_dvp, DATA_FOR_DISPLAY, VIDEO_FMT_RGB565, (void*)lcd_gram0);
-
-    dvp_set_output_attributes(file_dvp, DATA_FOR_AI, VIDEO_FMT_RGB24_PLANAR, (void*)ai_buf);
+    dvp_set_slot(dvp_slot);
 
     dvp_set_frame_event_enable(file_dvp, VIDEO_FE_END, DISABLE);
     dvp_set_frame_event_enable(file_dvp, VIDEO_FE_BEGIN, DISABLE);
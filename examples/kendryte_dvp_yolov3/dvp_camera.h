@@ -19,11 +19,10 @@
 #define DVP_WIDTH 320
 #define DVP_HIGHT 240
 
-extern volatile uint8_t dvp_finish_flag;
-extern volatile uint8_t gram_mux;
+/* frame slots of the pipeline: capture, inference and display */
+#define DVP_SLOT_NUM 3
 
-extern uint32_t lcd_gram0[38400];
-extern uint32_t lcd_gram1[38400];
+extern uint32_t lcd_gram[DVP_SLOT_NUM][38400];
 
-void dvp_init(void* ai_buf);
+void dvp_init(void* pipeline);
 #endif
@@ -8,24 +8,102 @@
 #ifndef _EXTERN_H
 #define _EXTERN_H
 
+typedef struct {
+  const void* data;
+  int n, c, h, w;
+  size_t cstep;
+  size_t element_size;
+  int data_type;
+  float scale;
+  int32_t zero_point;
+} tensor_view_t;
+
+typedef struct {
+  size_t live_bytes;
+  size_t peak_bytes;
+  size_t alloc_count;
+} allocator_stats_t;
+
 extern void create_executor(void** ptr, char* model_name, int thread_num);
 
 extern void analysis_model(void* ptr);
 
+extern void load_model_by_buf(void* ptr, const void* model_buf, size_t size);
+
+extern void load_model_by_path(void* ptr, char* model_path);
+
+extern void share_model(void* ptr, void* other);
+
 extern void load_image_by_buf(void* ptr, uint8_t* ai_buf, int channel,
                               int height, int width);
 
+extern void bind_input_buf(void* ptr, uint8_t* data, int channel,
+                           int height, int width, size_t cstep);
+
+extern void set_preprocess(void* ptr, int resize, const int* channel_order,
+                           const float* mean, const float* std);
+
+extern void load_frame_by_buf(void* ptr, const void* frame, int format,
+                              int height, int width);
+
+extern void load_images_by_buf(void* ptr, uint8_t** ai_bufs, int batch,
+                               int channel, int height, int width);
+
 extern void load_image_by_path(void* ptr, char* image_path, int channel,
                                int height, int width);
 
 extern void compute_model(void* ptr);
 
+extern void compute_model_async(void* ptr, void (*callback)(int status,
+                                void* userdata), void* userdata);
+
+extern void wait_model(void* ptr);
+
+extern int poll_model(void* ptr);
+
 extern void copy_output_buf(void* ptr, void* data_ptr, size_t size);
 
+extern void copy_batch_output_buf(void* ptr, int index, void* data_ptr,
+                                  size_t size);
+
+extern int get_output_view(void* ptr, tensor_view_t* view);
+
+extern void bind_output_buf(void* ptr, void* data_ptr, size_t size);
+
 extern void inference_result(void* ptr,
                       void* result_buf,
                       uint64_t size,
                       void* call);
 
 void destroy_executor(void* ptr);
+
+extern void create_pipeline(void** pptr, void* executor, int slot_num,
+                            int channel, int height, int width);
+
+extern void start_pipeline(void* ptr, int priority);
+
+extern uint8_t* pipeline_slot_buffer(void* ptr, int slot);
+
+extern int pipeline_acquire_slot(void* ptr);
+
+extern int pipeline_acquire_slot_from_isr(void* ptr);
+
+extern void pipeline_submit_slot(void* ptr, int slot);
+
+extern int pipeline_submit_slot_from_isr(void* ptr, int slot);
+
+extern int pipeline_wait_result(void* ptr);
+
+extern void pipeline_copy_output(void* ptr, int slot, void* data_ptr,
+                                 size_t size);
+
+extern int pipeline_output_view(void* ptr, int slot, tensor_view_t* view);
+
+extern void pipeline_release_slot(void* ptr, int slot);
+
+extern void destroy_pipeline(void* ptr);
+
+extern int use_pool_allocator(void* region, size_t size);
+
+extern void get_allocator_stats(allocator_stats_t* stats);
 #endif
@@ -15,53 +15,43 @@
 
 #include "extern.h"
 
-uint8_t g_ai_buf[320 * 240 * 3] __attribute__((aligned(128)));
-uint8_t g_ai_outbuf[320 * 240 * 16] __attribute__((aligned(128)));
-
-void vTaskYolov3(void* param)
+/* display stage: the camera captures and the pipeline task infers the
+   following frames meanwhile */
+void vTaskDisplay(void* param)
 {
+    void* pipeline = param;
     while (1)
     {
-        while (dvp_finish_flag == 0)
-            ;
-        // start to inference
-        void* exe = NULL;
-        create_executor(&exe, "yolov3", 1);
-        load_image_by_buf(exe, g_ai_buf, 3, 240, 320);
-        compute_model(exe);
-        // copy_output_buf(exe, (void*)g_ai_outbuf, 16 * 240 * 320);
-        // if (lable) {
-        //   for (int c = 0; c < 16; c++) {
-        //     for (int h = 0; h < 240; h++) {
-        //       for (int w = 0; w < 320; w++) {
-        //         printk("%02x ", g_ai_outbuf[c * 240 * 320 + h * 320 + w]);
-        //       }
-        //     }
-        //   }
-        // }
-        destroy_executor(exe);
+        int slot = pipeline_wait_result(pipeline);
+        // the slot output is read in place, no copy
+        tensor_view_t output;
+        pipeline_output_view(pipeline, slot, &output);
 
-        // break;
         // display pic
-        dvp_finish_flag = 0;
-        lcd_draw_picture(0, 0, 320, 240, gram_mux ? lcd_gram1 : lcd_gram0);
-        gram_mux ^= 0x01;
+        lcd_draw_picture(0, 0, 320, 240, lcd_gram[slot]);
 
         // draw boxes
-        // inference_result(exe, (void*)g_ai_output, 3, NULL);
+        // inference_result(exe, (void*)output.data, 3, NULL);
+        pipeline_release_slot(pipeline, slot);
     }
 }
 
 int main(void)
 {
+    void* exe = NULL;
+    void* pipeline = NULL;
+
     printf("lcd init\n");
     lcd_init();
+    create_executor(&exe, "yolov3", 1);
+    create_pipeline(&pipeline, exe, DVP_SLOT_NUM, 3, 240, 320);
     printf("DVP init\n");
-    dvp_init((void*)g_ai_buf);
+    dvp_init(pipeline);
     ov5640_init();
 
     vTaskSuspendAll();
-    xTaskCreate(vTaskYolov3, "vTaskYolov3", 1024, NULL, 3, NULL);
+    start_pipeline(pipeline, 3);
+    xTaskCreate(vTaskDisplay, "vTaskDisplay", 1024, pipeline, 2, NULL);
     if(!xTaskResumeAll())
     {
         taskYIELD();
@@ -70,4 +60,3 @@ int main(void)
     while (1)
         ;
 }
-
@@ -8,141 +8,160 @@
 #ifndef INCLUDE_CORE_ALLOCATOR_HPP_
 #define INCLUDE_CORE_ALLOCATOR_HPP_
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <cassert>
-#include <stdexcept>
+#include <vector>
+#include "include/core/os.hpp"
 
-namespace eigen {
+namespace RVTensor {
 
-// #if defined(RISCV)
-  const std::size_t default_alignment = 64;
-// #else
-//  const std::size_t default_alignment = 8;
-// #endif
-
-template<typename T>
-inline void check_size_for_overflow(std::size_t size) {
-  if (size > std::size_t(-1) / sizeof(T))
-    throw std::runtime_error("bad alloc");
+/**
+ * Aligns a buffer size to the specified number of bytes
+ */
+static inline size_t alignSize(size_t sz, int n) {
+  return (sz + n-1) & -n;
 }
 
-/* ----- Hand made implementations of aligned malloc/free and realloc ----- */
-
-/** Like malloc, but the returned pointer is guaranteed to be 16-byte aligned.
-  * Fast, but wastes 16 additional bytes of memory.
-  * Does not throw any exception.
-  */
-inline void* handmade_aligned_malloc(std::size_t size) {
-  void *original = std::malloc(size + default_alignment);
-  if (original == 0)
-    return 0;
-  void *aligned = reinterpret_cast<void*>(
-                  (reinterpret_cast<std::size_t>(original) &
-                  ~(std::size_t(default_alignment - 1))) + default_alignment);
-  *(reinterpret_cast<void**>(aligned) - 1) = original;
-  return aligned;
-}
+/**
+ * the default alignment of the allocated buffers and channel planes
+ */
+#define MALLOC_ALIGN    16
 
-/** \internal Frees memory allocated with handmade_aligned_malloc */
-inline void handmade_aligned_free(void *ptr) {
-  if (ptr)
-    std::free(*(reinterpret_cast<void**>(ptr) - 1));
+/**
+ * alignments a tensor may ask for: a cache line, a vector register of the
+ * widest enabled SIMD extension, a KPU DMA burst row
+ */
+#define CACHE_LINE_ALIGN  64
+#if defined(__AVX__)
+#define VECTOR_ALIGN      32
+#else
+#define VECTOR_ALIGN      16
+#endif
+#define KPU_ROW_ALIGN     64
+
+/**Aligns a pointer to the specified number of bytes
+ * @param ptr: Aligned pointer
+ * @param n: Alignment size that must be a power of two
+ */
+template<typename _Tp> static inline _Tp* alignPtr(
+    _Tp* ptr, int n = sizeof(_Tp)) {
+  return reinterpret_cast<_Tp*>(((size_t)ptr + n - 1) & -n);
 }
 
+/**
+ * allocation counters, bytes are the requested sizes
+ */
+struct AllocatorStats {
+  size_t live_bytes;
+  size_t peak_bytes;
+  size_t alloc_count;
+};
 
-/** Allocates size bytes.
- *  The returned pointer is guaranteed to have 16 or 32 bytes alignment
- *  depending on the requirements.
- * On allocation error, the returned pointer is null,
- * and std::bad_alloc is thrown.
+/**
+ * Allocator of tensor data, every buffer is aligned to a power of two of
+ * at least MALLOC_ALIGN bytes.
+ *
+ * RamTensor takes the default allocator when it allocates its data and
+ * returns the data to that allocator, so the default may be replaced at
+ * any time (by the task that creates executors, before they compute).
  */
-inline void* aligned_malloc(std::size_t size) {
-  void *result;
-
-  if (default_alignment == 0) {
-    result = std::malloc(size);
-  } else if (default_alignment == 16) {
-    if (!(size < 16 || (std::size_t(result) % 16) == 0))
-      throw std::runtime_error("System's malloc returned an unaligned pointer");
-  } else {
-    result = handmade_aligned_malloc(size);
-  }
-
-  if (!result && size)
-    throw std::runtime_error("bad alloc");
-
-  return result;
-}
+class Allocator {
+ public:
+    using sptr = std::shared_ptr<Allocator>;
 
-/** Frees memory allocated with aligned_malloc. */
-inline void aligned_free(void *ptr) {
-  if (default_alignment == 0)
-    std::free(ptr);
-  else
-    handmade_aligned_free(ptr);
-}
+    /**
+     * Constructor & Deconstructor
+     */
+    Allocator();
+    virtual ~Allocator() {}
+
+    /**
+     * nullptr when out of memory, alignment is raised to MALLOC_ALIGN
+     */
+    virtual void* allocate(size_t size, size_t alignment = MALLOC_ALIGN) = 0;
+    virtual void deallocate(void* ptr) = 0;
+
+    AllocatorStats stats();
 
-/****************************************************************************/
-
-/** aligned_allocator
-*
-* STL compatible allocator to use with types requiring a non standrad alignment.
-*
-* The memory is aligned as for dynamically aligned matrix/array types such as
-* MatrixXd. By default, it will thus provide at least 16 bytes alignment and
-* more in following cases:
-*  - 32 bytes alignment if AVX is enabled.
-*  - 64 bytes alignment if AVX512 is enabled.
-*
-*/
-template<class T>
-class aligned_allocator : public std::allocator<T> {
+    static sptr getDefault();
+    static void setDefault(sptr allocator);
+
+ protected:
+    /// counters, updated with mutex_ held
+    void recordAllocate(size_t size);
+    void recordDeallocate(size_t size);
+
+    Mutex mutex_;
+
+ private:
+    Allocator(const Allocator&);
+    Allocator& operator=(const Allocator&);
+
+    AllocatorStats stats_;
+};
+
+/**
+ * aligned malloc/free, the default allocator
+ */
+class MallocAllocator: public Allocator {
  public:
-  typedef std::size_t     size_type;
-  typedef std::ptrdiff_t  difference_type;
-  typedef T*              pointer;
-  typedef const T*        const_pointer;
-  typedef T&              reference;
-  typedef const T&        const_reference;
-  typedef T               value_type;
-
-  template<class U>
-  struct rebind {
-    typedef aligned_allocator<U> other;
-  };
-
-  aligned_allocator() : std::allocator<T>() {}
-
-  aligned_allocator(const aligned_allocator& other)
-                      : std::allocator<T>(other) {}
-
-  template<class U>
-  aligned_allocator(const aligned_allocator<U>& other)
-                      : std::allocator<T>(other) {}
-
-  ~aligned_allocator() {}
-
-  pointer allocate(size_type num, const void* /*hint*/ = 0) {
-    check_size_for_overflow<T>(num);
-    return static_cast<pointer>(aligned_malloc(num * sizeof(T)));
-  }
-
-  void deallocate(pointer p, size_type /*num*/) {
-    aligned_free(p);
-  }
+    using sptr = std::shared_ptr<MallocAllocator>;
+    static sptr create();
+
+    void* allocate(size_t size, size_t alignment = MALLOC_ALIGN) override;
+    void deallocate(void* ptr) override;
 };
 
-template<typename T, std::size_t align = std::alignment_of<T>::value, typename... Args>  // NOLINT
-std::shared_ptr<T> make_shared(Args&&... args) {
-  if (align > default_alignment) {
-    typedef aligned_allocator<T> alloc_type;
-    return std::allocate_shared<T, alloc_type>(
-                 alloc_type(), std::forward<Args>(args)...);
-  } else {
-    return std::make_shared<T>(std::forward<Args>(args)...);
-  }
-}
+/**
+ * Size class pool over a fixed region.
+ *
+ * Sizes are rounded up to classes of 64 bytes and then four classes per
+ * power of two (at most 25% slack). A freed buffer goes to the free list
+ * of its class and is reused by the next allocation of that class, so
+ * allocating and freeing the same shapes frame after frame is O(1) and
+ * never fragments the heap. Buffers are carved from the region only when
+ * their class has no free buffer; the region itself is never compacted.
+ * Alignments above MALLOC_ALIGN take alignment - MALLOC_ALIGN bytes more.
+ */
+class PoolAllocator: public Allocator {
+ public:
+    using sptr = std::shared_ptr<PoolAllocator>;
+    /**
+     * pool over caller memory which must outlive the pool
+     */
+    static sptr create(void* region, size_t size);
+    /**
+     * pool over size bytes taken from the heap once
+     */
+    static sptr create(size_t size);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    PoolAllocator(void* region, size_t size, bool owned);
+    ~PoolAllocator();
+
+    void* allocate(size_t size, size_t alignment = MALLOC_ALIGN) override;
+    void deallocate(void* ptr) override;
+
+    /**
+     * bytes of the region carved so far
+     */
+    size_t used() const;
+
+ private:
+    static int classIndex(size_t size);
+    static size_t classSize(int index);
+
+    uint8_t* region_;
+    size_t size_;
+    size_t used_;
+    bool owned_;
+    /// first free buffer of every class, the next one is kept in its data
+    std::vector<void*> free_lists_;
+};
 
-}  // namespace eigen
+}  // namespace RVTensor
 
 #endif  // INCLUDE_CORE_ALLOCATOR_HPP_
@@ -8,17 +8,35 @@
 #ifndef INCLUDE_CORE_EXECUTOR_HPP_
 #define INCLUDE_CORE_EXECUTOR_HPP_
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include "include/core/tensor.hpp"
+#include "include/core/model.hpp"
+#include "include/core/os.hpp"
+#include "include/ops/preprocess.hpp"
 
 namespace RVTensor {
 
 typedef void (*callback_draw_box)(uint32_t x1, uint32_t y1, uint32_t x2,
     uint32_t y2, uint32_t classes, float prob);
 
+/**
+ * completion of an asynchronous compute, status is the compute() result
+ */
+typedef void (*callback_compute)(int status, void* userdata);
+
+/**
+ * asynchronous computes queued before the submitter blocks
+ */
+#define ASYNC_QUEUE_DEPTH 2
+
 /**
  * Executor describes the context of a individual inference task.
+ *
+ * Executors are independent of each other: each owns its activations and
+ * may compute concurrently with the others (KPU layers are serialized on
+ * the hardware).
  */
 class Executor {
  public:
@@ -40,18 +58,116 @@ class Executor {
      * @param width:  width of imput image
      */
     void loadImage(uint8_t* ai_buf, int channel, int height, int width);
+
+    /**
+     * register an input buffer read by every following compute, so a frame
+     * loop only rewrites the buffer; binding the same shape again reuses
+     * the input tensor without allocating
+     *
+     * @param cstep: elements from one channel plane to the next, 0 for
+     *               dense planes (height * width); planes laid out with
+     *               the input tensor cstep are read in place, others are
+     *               copied into an aligned input by each compute
+     */
+    void bindInput(uint8_t* data, int channel, int height, int width,
+                   size_t cstep = 0);
+
+    /**
+     * alignment of the model input; a buffer aligned to it whose planes
+     * are cstep-aligned to it as well is bound without a copy
+     */
+    size_t inputAlignment() const;
+
+    /**
+     * preprocessing of loadFrame, default: bilinear, RGB, no normalization
+     */
+    void setPreprocess(const PreprocessParam& param);
+
+    /**
+     * resize, reorder, normalize and quantize a camera frame into the
+     * model input in one pass; the preprocessed input is reused by the
+     * next loadFrame unless a queued computeAsync still holds it
+     */
+    void loadFrame(const void* frame, FrameFormat format, int height,
+                   int width);
+
+    /**
+     * load a batch of images (e.g. crops of a first stage detector), the
+     * images are copied into one batch tensor and computed together
+     *
+     * @param ai_bufs: batch planar images of channel x height x width
+     */
+    void loadImages(uint8_t* const* ai_bufs, int batch, int channel,
+                    int height, int width);
 // void loadImage(std::string image_path, int channel, int height, int width);
 
+    /**
+     * load a serialized model which replaces the compiled model_name
+     * graph; data is referenced in place and must outlive the Executor
+     */
+    void loadModel(const void* data, size_t size);
+    void loadModel(std::string model_path);
+
+    /**
+     * run the serialized model of other with the same weights but own
+     * activations, both executors can compute at the same time
+     */
+    void shareModel(Executor::sptr other);
+
+    /**
+     * run the op chains of serialized models rows output rows at a time
+     * with band sized intermediates (Model::setTiling), 0 turns it off;
+     * set before loadModel the whole maps of the chains are never
+     * allocated
+     */
+    void setTiling(int rows);
+
     /**
      * Start to inference
      */
     int compute();
 
+    /**
+     * Queue an inference of the loaded image on the inference task and
+     * return at once; call is invoked on that task when it is done.
+     * Blocks while ASYNC_QUEUE_DEPTH computes are already queued.
+     */
+    void computeAsync(callback_compute call, void* userdata);
+
+    /**
+     * wait until all queued computes are done, must not be called from a
+     * callback_compute (neither compute(), which waits as well)
+     */
+    void wait();
+
+    /**
+     * number of queued computes not done yet
+     */
+    int poll();
+
     /**
      * Copy Output data to application
      */
     void copyOutputData(void* data_ptr, size_t size);
 
+    /**
+     * Copy the output of batch item index to application
+     */
+    void copyOutputData(int index, void* data_ptr, size_t size);
+
+    /**
+     * output tensor of the last compute, nullptr before the first one;
+     * a read-only view valid until the next compute
+     */
+    RamTensor::sptr getOutput();
+
+    /**
+     * let the last op write the output straight into caller memory of
+     * n * c * cstep * element_size bytes (the output tensor layout),
+     * nullptr unbinds it
+     */
+    void bindOutput(void* data_ptr, size_t size);
+
     /**
      * analysis inference result
      *
@@ -70,13 +186,41 @@ class Executor {
     Executor& operator=(const Executor& exe);
 
  private:
+    struct AsyncRequest;
+    static void asyncEntry(void* arg);
+    int compute(RamTensor::sptr image);
+    void stageInput();
+
     /// thread num
     int thread_num_;
     /// image struct
     RamTensor::sptr image_ptr;
+    /// bindInput buffer copied into image_ptr before computes, nullptr
+    /// when image_ptr is read in place
+    const uint8_t* input_buf_;
+    size_t input_cstep_;
     RamTensor::sptr output_ptr;
     /// model_name
     std::string model_name_;
+    /// serialized model, nullptr when running a compiled model
+    Model::sptr model_;
+    /// Model tiling rows of loadModel
+    int tile_rows_;
+    /// inference task of computeAsync, started by the first request
+    Task::sptr async_task_;
+    Queue::sptr async_queue_;
+    std::atomic<int> async_pending_;
+    /// caller output buffer of bindOutput
+    void* output_buf_;
+    size_t output_buf_size_;
+    RamTensor::sptr bound_output_;
+    /// loadFrame state, rebuilt when the frame size changes
+    PreprocessParam preprocess_param_;
+    PreprocessOp::sptr preprocess_op_;
+    RamTensor::sptr frame_ptr_;
+    RamTensor::sptr preprocessed_ptr_;
+    /// serializes computes of this instance (pipeline, async, callers)
+    Mutex compute_mutex_;
 };
 
 }  // namespace RVTensor
@@ -0,0 +1,80 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_HALF_HPP_
+#define INCLUDE_CORE_HALF_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+namespace RVTensor {
+
+/**
+ * IEEE 754 binary16 values are stored as their bits in uint16_t, the K210
+ * has no half precision unit so they are converted in software.
+ */
+
+/**
+ * float32 -> float16, rounded to nearest even; overflow gives inf and
+ * values below the smallest subnormal give (signed) zero
+ */
+static inline uint16_t floatToHalf(float value) {
+  uint32_t f;
+  memcpy(&f, &value, sizeof(f));
+  const uint16_t sign = static_cast<uint16_t>((f >> 16) & 0x8000u);
+  const uint32_t abs = f & 0x7fffffffu;
+  if (abs >= 0x7f800000u)  // inf, nan stays a quiet nan
+    return sign | 0x7c00u | (abs > 0x7f800000u ? 0x0200u : 0u);
+  if (abs >= 0x477ff000u)  // rounds to 65520 or more
+    return sign | 0x7c00u;
+  if (abs <= 0x33000000u)  // 2^-25 or less
+    return sign;
+  uint32_t h;
+  uint32_t rem;
+  uint32_t tie;
+  if (abs < 0x38800000u) {
+    // subnormal: units of 2^-24
+    const uint32_t mant = (abs & 0x7fffffu) | 0x800000u;
+    const int shift = 126 - static_cast<int>(abs >> 23);
+    h = mant >> shift;
+    rem = mant & ((1u << shift) - 1);
+    tie = 1u << (shift - 1);
+  } else {
+    // rebias the exponent, a carry of the rounding moves into it
+    h = (abs - 0x38000000u) >> 13;
+    rem = abs & 0x1fffu;
+    tie = 0x1000u;
+  }
+  if (rem > tie || (rem == tie && (h & 1u)))
+    h++;
+  return sign | static_cast<uint16_t>(h);
+}
+
+/**
+ * float16 -> float32, exact
+ */
+static inline float halfToFloat(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+  const uint32_t exp = (value >> 10) & 0x1fu;
+  const uint32_t mant = value & 0x3ffu;
+  uint32_t f;
+  if (exp == 0) {
+    const float v = static_cast<float>(mant) * 5.9604644775390625e-8f;
+    return sign ? -v : v;
+  } else if (exp == 0x1fu) {
+    f = sign | 0x7f800000u | (mant << 13);
+  } else {
+    f = sign | ((exp + 112) << 23) | (mant << 13);
+  }
+  float result;
+  memcpy(&result, &f, sizeof(result));
+  return result;
+}
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_HALF_HPP_
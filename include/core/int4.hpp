@@ -0,0 +1,62 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_INT4_HPP_
+#define INCLUDE_CORE_INT4_HPP_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace RVTensor {
+
+/**
+ * INT4 weights are symmetric quantized to [-7, 7] (zero point 0, -8 is not
+ * produced so the range is symmetric like int8) and stored two per byte,
+ * element 2i in the low nibble and element 2i + 1 in the high nibble. Every
+ * batch item (output channel) starts at a byte, an odd item ends with a
+ * zero high nibble.
+ */
+
+static const int kInt4Max = 7;
+
+/**
+ * bytes of num packed INT4 elements
+ */
+static inline size_t int4Bytes(size_t num) {
+  return (num + 1) / 2;
+}
+
+/**
+ * sign extended low and high element of a byte
+ */
+static inline int32_t int4Low(uint8_t byte) {
+  return static_cast<int8_t>(static_cast<uint8_t>(byte << 4)) >> 4;
+}
+
+static inline int32_t int4High(uint8_t byte) {
+  return static_cast<int8_t>(byte) >> 4;
+}
+
+/**
+ * pack num values clamped to [-7, 7] into int4Bytes(num) bytes
+ */
+static inline void packInt4(const int32_t* src, uint8_t* dst, size_t num) {
+  for (size_t i = 0; i < num; i += 2) {
+    int32_t lo = src[i] < -kInt4Max ? -kInt4Max
+                 : (src[i] > kInt4Max ? kInt4Max : src[i]);
+    int32_t hi = 0;
+    if (i + 1 < num) {
+      hi = src[i + 1] < -kInt4Max ? -kInt4Max
+           : (src[i + 1] > kInt4Max ? kInt4Max : src[i + 1]);
+    }
+    dst[i / 2] = static_cast<uint8_t>((lo & 0xf) | ((hi & 0xf) << 4));
+  }
+}
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_INT4_HPP_
@@ -0,0 +1,150 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_MODEL_HPP_
+#define INCLUDE_CORE_MODEL_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/operation.hpp"
+#include "include/core/model_format.hpp"
+
+namespace RVTensor {
+
+/**
+ * Model is the interpreter form of a serialized model (model_format.hpp).
+ *
+ * Loading walks the tensor and op tables once: weights are bound in place
+ * (flash or a memory mapped file) and never copied, so the load time only
+ * depends on the number of tensors and ops.
+ *
+ * Models made by share() use the same weight tensors and storage but own
+ * their activations, so several instances of a model can run at once.
+ */
+class Model {
+ public:
+    using sptr = std::shared_ptr<Model>;
+
+    /**
+     * parse a serialized model; data must stay valid while the Model lives.
+     * tile_rows > 0 loads it tiled (see setTiling), so the activations
+     * inside the chains are never allocated whole
+     */
+    static sptr load(const void* data, size_t size, int tile_rows = 0);
+
+    /**
+     * map a serialized model file (host only)
+     */
+    static sptr loadFile(const std::string& path, int tile_rows = 0);
+
+    /**
+     * new instance sharing the weights of this model, with its own
+     * activation tensors and ops
+     */
+    sptr share() const;
+
+    /**
+     * Constructor & Deconstructor
+     */
+    Model();
+    ~Model();
+
+    /**
+     * bind the input image data to the model input tensor, the layout must
+     * match the input tensor (shape and cstep)
+     */
+    void bindInput(RamTensor::sptr image);
+
+    /**
+     * let the last op write into caller memory of at least
+     * getOutput()->totalSize() bytes, laid out like the output tensor;
+     * nullptr goes back to an owned buffer
+     */
+    void bindOutput(void* data, size_t size);
+
+    /**
+     * rebuild the activations and ops for a batch of n inputs, every op
+     * then runs over the whole batch with its weights loaded once
+     */
+    void setBatch(int n);
+    int getBatch();
+
+    /**
+     * tiled execution: rebuild the model with every chain of ops that run
+     * by bands (convs with uint8/int8 weights, activations and pools, see
+     * include/ops/tiled.hpp) as a TiledOp computing rows output rows at a
+     * time, so the activations inside a chain are never allocated whole;
+     * 0 runs every op over whole maps again
+     */
+    void setTiling(int rows);
+    int getTiling();
+
+    /**
+     * run all ops in order
+     */
+    void compute();
+
+    /**
+     * model input/output tensors
+     */
+    RamTensor::sptr getInput();
+    RamTensor::sptr getOutput();
+
+    /**
+     * ops in execution order
+     */
+    std::vector<Operation::sptr>& getOps();
+
+ private:
+    /**
+     * batch overrides the serialized batch of all activations if > 0
+     */
+    void parse(const uint8_t* data, size_t size,
+               const std::vector<FlashTensor::sptr>* shared_weights,
+               int batch = 0);
+    Operation::sptr createOp(const ModelFileOp& op);
+    /**
+     * layout propagation: activations joined by convs and quantizes form a
+     * group, a group whose convs are all pointwise CPU convs is NHWC, one
+     * whose convs are all untuned uncompressed uint8/int8 CPU convs is
+     * NCxHWx with blocks of VECTOR_ALIGN / 4 channels and the other groups
+     * stay NCHW. Convs the ConvTuner has an entry for, or all of them in
+     * tuning mode, keep NCHW. The model input/output stay NCHW; when their
+     * group is not, a copy in the layout of the group is appended to the
+     * ram tensors and the ops are redirected to it, the input LayoutOp is
+     * added to ops_ and the output LayoutOp is returned to run after the
+     * model ops.
+     */
+    Operation::sptr planLayouts(std::vector<ModelFileOp>* ops);
+    /// new activations and ops for batch, weights are kept
+    void rebuild(int batch);
+    /**
+     * group ops_ into TiledOps: a chain grows while the next op runs by
+     * bands and is the only reader of the output of the last one, which
+     * is not the model output
+     */
+    void tileOps();
+
+    /// per tensor index: one of them is set depending on the tensor kind
+    std::vector<RamTensor::sptr> ram_tensors_;
+    std::vector<FlashTensor::sptr> flash_tensors_;
+    std::vector<Operation::sptr> ops_;
+    uint32_t input_index_;
+    uint32_t output_index_;
+    /// output rows per band of tiled chains, 0 for no tiling
+    int tile_rows_;
+    /// serialized model, unmapped with the last sharing Model if loadFile
+    /// mapped it
+    std::shared_ptr<const uint8_t> storage_;
+    size_t storage_size_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_MODEL_HPP_
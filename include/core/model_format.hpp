@@ -0,0 +1,107 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_MODEL_FORMAT_HPP_
+#define INCLUDE_CORE_MODEL_FORMAT_HPP_
+
+#include <stdint.h>
+
+namespace RVTensor {
+
+/**
+ * RVTensor serialized model (little endian, all offsets from file start)
+ *
+ *   +--------------------+  0
+ *   | ModelFileHeader    |
+ *   +--------------------+  tensor_offset
+ *   | ModelFileTensor[]  |
+ *   +--------------------+  op_offset
+ *   | ModelFileOp[]      |
+ *   +--------------------+  blob_offset (MODEL_BLOB_ALIGN aligned)
+ *   | weight blobs       |  each blob MODEL_BLOB_ALIGN aligned, referenced
+ *   |                    |  in place by FlashTensor::bindData (or
+ *   |                    |  bindCompressedData)
+ *   +--------------------+
+ */
+
+/// "RVTM"
+#define MODEL_FILE_MAGIC      0x4d545652u
+#define MODEL_FILE_VERSION    1u
+#define MODEL_BLOB_ALIGN      64u
+#define MODEL_NAME_LENGTH     32u
+#define MODEL_NONE_INDEX      0xffffffffu
+#define MODEL_MAX_OP_TENSORS  4u
+#define MODEL_MAX_OP_PARAMS   8u
+
+struct ModelFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t tensor_count;
+  uint32_t op_count;
+  uint32_t tensor_offset;
+  uint32_t op_offset;
+  uint32_t blob_offset;
+  uint32_t input_tensor;
+  uint32_t output_tensor;
+  uint32_t reserved[7];
+};
+
+/// where the data of a tensor lives
+enum ModelTensorKind {
+  MODEL_TENSOR_ACTIVATION = 0,  // RamTensor allocated at load time
+  MODEL_TENSOR_INPUT      = 1,  // RamTensor bound to the caller's image
+  MODEL_TENSOR_CONSTANT   = 2   // FlashTensor referencing a weight blob
+};
+
+struct ModelFileTensor {
+  char name[MODEL_NAME_LENGTH];
+  int32_t n;
+  int32_t c;
+  int32_t h;
+  int32_t w;
+  uint32_t element_size;
+  uint32_t data_type;           // DataType
+  uint32_t kind;                // ModelTensorKind
+  float min_range;
+  float max_range;
+  float scale;
+  int32_t zero_point;
+  uint32_t data_offset;         // constant: blob offset
+  uint32_t data_size;           // constant: blob size in bytes
+  uint32_t channel_scale_offset;  // constant: n float scales, 0 for none
+  uint32_t alignment;           // ram: RamTensor alignment, 0 for default
+  uint32_t compressed;          // constant: the blob is a weight container
+                                // (include/core/weight_codec.hpp)
+};
+
+enum ModelOpType {
+  MODEL_OP_CONV       = 0,  // params: ConvParam, packConvTuning()
+                            // (include/ops/conv_tuner.hpp)
+  MODEL_OP_KPU_CONV   = 1,  // params: ConvParam
+  MODEL_OP_QUANTIZE   = 2,  // params: QuantizeParam
+  MODEL_OP_ACTIVATION = 3,  // params: ActivationType, bits of float alpha
+  MODEL_OP_POOL       = 4   // params: PoolParam
+};
+
+struct ModelFileOp {
+  uint32_t type;                // ModelOpType
+  uint32_t input_count;
+  uint32_t output_count;
+  uint32_t inputs[MODEL_MAX_OP_TENSORS];
+  uint32_t outputs[MODEL_MAX_OP_TENSORS];
+  uint32_t weight;              // tensor index or MODEL_NONE_INDEX
+  uint32_t bias;                // tensor index or MODEL_NONE_INDEX
+  int32_t params[MODEL_MAX_OP_PARAMS];
+};
+
+static_assert(sizeof(ModelFileHeader) == 64, "ModelFileHeader layout");
+static_assert(sizeof(ModelFileTensor) == 96, "ModelFileTensor layout");
+static_assert(sizeof(ModelFileOp) == 84, "ModelFileOp layout");
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_MODEL_FORMAT_HPP_
@@ -14,6 +14,12 @@
 
 namespace RVTensor {
 
+/**
+ * callback invoked with every output tensor after an operation is run,
+ * used by host side tools (e.g. calibration) to look at activations
+ */
+typedef void (*tensor_observer)(RamTensor::sptr tensor, void* userdata);
+
 /**
  * RVTensor operation descriptor
  *
@@ -58,6 +64,26 @@ class Operation {
      */
     virtual void forward_compute() {}
 
+    /**
+     * band execution of op chains (include/ops/tiled.hpp): an op that
+     * supportsRows() computes output rows [h0, h1) of its first output by
+     * forwardRows() reading only input rows [*begin, *end) of its first
+     * input, as given by inputRows(); the default reads all input rows
+     */
+    virtual bool supportsRows() { return false; }
+    virtual void inputRows(int h0, int h1, int* begin, int* end);
+    virtual void forwardRows(int /*h0*/, int /*h1*/) {}
+
+    /**
+     * forward_compute and report outputs to the tensor observer if any
+     */
+    void run();
+
+    /**
+     * install a process wide tensor observer, nullptr to remove it
+     */
+    static void setObserver(tensor_observer observer, void* userdata);
+
  private:
     std::vector<RamTensor::sptr> inputs_;
     std::vector<RamTensor::sptr> outputs_;
@@ -0,0 +1,146 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_OS_HPP_
+#define INCLUDE_CORE_OS_HPP_
+
+#include <cstddef>
+#include <memory>
+
+namespace RVTensor {
+
+struct QueueImpl;
+struct TaskImpl;
+struct MutexImpl;
+
+/**
+ * Bounded FIFO of fixed size items.
+ *
+ * FreeRTOS queue on kendryte, mutex + condition variable on the host.
+ * Items are copied in and out by value, as in xQueueSend/xQueueReceive.
+ */
+class Queue {
+ public:
+    using sptr = std::shared_ptr<Queue>;
+    static sptr create(size_t depth, size_t item_size);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    Queue(size_t depth, size_t item_size);
+    ~Queue();
+
+    /**
+     * block while the queue is full / empty
+     */
+    void send(const void* item);
+    void receive(void* item);
+
+    /**
+     * never block, return false when the queue is full / empty
+     */
+    bool trySend(const void* item);
+    bool tryReceive(void* item);
+
+    /**
+     * non blocking variants callable from an interrupt handler
+     */
+    bool sendFromISR(const void* item);
+    bool receiveFromISR(void* item);
+
+    /**
+     * number of queued items
+     */
+    size_t size();
+
+ private:
+    Queue(const Queue&);
+    Queue& operator=(const Queue&);
+
+    QueueImpl* impl_;
+};
+
+/**
+ * entry of a Task
+ */
+typedef void (*task_entry)(void* arg);
+
+/**
+ * Thread of execution: a FreeRTOS task on kendryte, std::thread on the
+ * host. The Task must be joined (or destroyed, which joins) after entry
+ * returns.
+ */
+class Task {
+ public:
+    using sptr = std::shared_ptr<Task>;
+
+    /**
+     * @param priority: FreeRTOS priority, ignored on the host
+     * @param stack_size: stack size in bytes, ignored on the host
+     */
+    static sptr create(const char* name, task_entry entry, void* arg,
+                       int priority, size_t stack_size = 4096);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    Task(const char* name, task_entry entry, void* arg, int priority,
+         size_t stack_size);
+    ~Task();
+
+    /**
+     * wait until entry returned
+     */
+    void join();
+
+ private:
+    Task(const Task&);
+    Task& operator=(const Task&);
+
+    TaskImpl* impl_;
+};
+
+/**
+ * Mutual exclusion between tasks (not interrupt handlers): FreeRTOS mutex
+ * on kendryte, std::mutex on the host.
+ */
+class Mutex {
+ public:
+    /**
+     * Constructor & Deconstructor
+     */
+    Mutex();
+    ~Mutex();
+
+    void lock();
+    void unlock();
+
+ private:
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+
+    MutexImpl* impl_;
+};
+
+/**
+ * holds a Mutex for the lifetime of the guard
+ */
+class LockGuard {
+ public:
+    explicit LockGuard(Mutex* mutex) : mutex_(mutex) { mutex_->lock(); }
+    ~LockGuard() { mutex_->unlock(); }
+
+ private:
+    LockGuard(const LockGuard&);
+    LockGuard& operator=(const LockGuard&);
+
+    Mutex* mutex_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_OS_HPP_
@@ -0,0 +1,98 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_PIPELINE_HPP_
+#define INCLUDE_CORE_PIPELINE_HPP_
+
+#include <vector>
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/executor.hpp"
+#include "include/core/os.hpp"
+
+namespace RVTensor {
+
+/**
+ * Pipeline overlaps capture, inference and display over N frame slots.
+ *
+ *   capture ---> ready ---> inference task ---> done ---> display
+ *      ^                                                     |
+ *      +------------------------- free <---------------------+
+ *
+ * Every slot owns an input image and the model output, and is
+ * owned by exactly one stage at a time; slots travel between the stages
+ * through queues. While slot k is inferred, the camera captures into slot
+ * k + 1 and slot k - 1 is displayed, so the frame rate is bounded by the
+ * slowest stage instead of the sum of all stages.
+ */
+class Pipeline {
+ public:
+    using sptr = std::shared_ptr<Pipeline>;
+    static sptr create(Executor::sptr executor, int slot_num,
+                       int channel, int height, int width);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    Pipeline(Executor::sptr executor, int slot_num,
+             int channel, int height, int width);
+    ~Pipeline();
+
+    /**
+     * start/stop the inference task, stop waits for the frame in flight
+     */
+    void start(int priority = 3, size_t stack_size = 8192);
+    void stop();
+
+    /**
+     * planar input image of a slot, the capture target
+     */
+    uint8_t* slotBuffer(int slot);
+    int slotNum() const;
+
+    /**
+     * capture stage: take a free slot and hand it to inference once the
+     * frame is in; the FromISR variants never block and return -1/false
+     * when no slot is free (the frame should be dropped then)
+     */
+    int acquireSlot();
+    int acquireSlotFromISR();
+    void submitSlot(int slot);
+    bool submitSlotFromISR(int slot);
+
+    /**
+     * display stage: wait for the next inferred slot, read its output and
+     * release it back to capture
+     */
+    int waitResult();
+    RamTensor::sptr slotOutput(int slot);
+    void releaseSlot(int slot);
+
+    /**
+     * 0 when the last inference of a slot succeeded, -1 when the model
+     * threw; the slot output is not valid then
+     */
+    int slotStatus(int slot);
+
+ private:
+    static void inferenceEntry(void* arg);
+    void inference(int slot);
+
+    Executor::sptr executor_;
+    std::vector<RamTensor::sptr> inputs_;
+    std::vector<RamTensor::sptr> outputs_;
+    std::vector<int> status_;
+    /// slot indices, -1 in ready_ stops the inference task
+    Queue::sptr free_;
+    Queue::sptr ready_;
+    Queue::sptr done_;
+    Task::sptr task_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_PIPELINE_HPP_
@@ -5,19 +5,101 @@
  *
  */
 
-#ifndef INCLUDE_CORE_RVTRNSOR_API_H_
+#ifndef INCLUDE_CORE_RVTENSOR_API_H_
 #define INCLUDE_CORE_RVTENSOR_API_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * read-only description of an output tensor, channel c of batch n starts at
+ * data + (n * c_num + c) * cstep * element_size; data_type is a
+ * RVTensor::DataType (include/core/types.hpp), it tells int8 from uint8
+ * and int32 from float32 outputs of the same element_size
+ */
+typedef struct {
+  const void* data;
+  int n, c, h, w;
+  size_t cstep;
+  size_t element_size;
+  int data_type;
+  float scale;
+  int32_t zero_point;
+} tensor_view_t;
+
+/**
+ * tensor data allocation counters, bytes are the requested sizes
+ */
+typedef struct {
+  size_t live_bytes;
+  size_t peak_bytes;
+  size_t alloc_count;
+} allocator_stats_t;
+
+/**
+ * every executor is an independent handle, released by destroy_executor
+ */
 extern "C"
 void create_executor(void** pptr, char* model_name, int thread_num);
 
 extern "C"
 void analysis_model(void* ptr);
 
+extern "C"
+void load_model_by_buf(void* ptr, const void* model_buf, size_t size);
+
+extern "C"
+void load_model_by_path(void* ptr, char* model_path);
+
+/**
+ * use the model loaded by other without duplicating its weights
+ */
+extern "C"
+void share_model(void* ptr, void* other);
+
+/**
+ * compute the loaded model in bands of rows output rows with band sized
+ * intermediates, 0 turns it off
+ */
+extern "C"
+void set_tiling(void* ptr, int rows);
+
 extern "C"
 void load_image_by_buf(void* ptr, uint8_t* ai_buf, int channel, int height,
                        int width);
 
+/**
+ * register data (channel planes cstep bytes apart, 0 for dense planes) as
+ * the input of every following compute; rebinding the same shape does not
+ * allocate
+ */
+extern "C"
+void bind_input_buf(void* ptr, uint8_t* data, int channel, int height,
+                    int width, size_t cstep);
+
+/**
+ * preprocessing of load_frame_by_buf, resize is a ResizeMethod and
+ * channel_order/mean/std have 3 entries
+ */
+extern "C"
+void set_preprocess(void* ptr, int resize, const int* channel_order,
+                    const float* mean, const float* std);
+
+/**
+ * resize/normalize/quantize a camera frame (format is a FrameFormat:
+ * 0 RGB565, 1 planar RGB24) into the model input
+ */
+extern "C"
+void load_frame_by_buf(void* ptr, const void* frame, int format, int height,
+                       int width);
+
+/**
+ * batch of planar images computed together, see copy_batch_output_buf
+ */
+extern "C"
+void load_images_by_buf(void* ptr, uint8_t** ai_bufs, int batch, int channel,
+                        int height, int width);
+
 extern "C"
 void load_image_by_path(void* ptr, char* image_path, int channel, int height,
                         int width);
@@ -25,9 +107,44 @@ void load_image_by_path(void* ptr, char* image_path, int channel, int height,
 extern "C"
 void compute_model(void* ptr);
 
+/**
+ * queue an inference of the loaded image and return at once, callback is
+ * invoked with the compute status on the inference task; blocks while the
+ * inference task is ASYNC_QUEUE_DEPTH requests behind
+ */
+extern "C"
+void compute_model_async(void* ptr, void (*callback)(int status,
+                         void* userdata), void* userdata);
+
+extern "C"
+void wait_model(void* ptr);
+
+/**
+ * number of queued inferences not done yet
+ */
+extern "C"
+int poll_model(void* ptr);
+
 extern "C"
 void copy_output_buf(void* ptr, void* data_ptr, size_t size);
 
+extern "C"
+void copy_batch_output_buf(void* ptr, int index, void* data_ptr, size_t size);
+
+/**
+ * view of the output without copying it, valid until the next compute;
+ * returns -1 before the first compute
+ */
+extern "C"
+int get_output_view(void* ptr, tensor_view_t* view);
+
+/**
+ * let the last op write the output into data_ptr (size bytes, laid out as
+ * get_output_view reports it), NULL goes back to the executor's own buffer
+ */
+extern "C"
+void bind_output_buf(void* ptr, void* data_ptr, size_t size);
+
 extern "C"
 void inference_result(void* ptr,
                       void* result_buf,
@@ -35,5 +152,68 @@ void inference_result(void* ptr,
                       void* call);
 
 extern "C"
-void destroy_executor(void* pptr);
-#endif  // INCLUDE_CORE_RVTRNSOR_API_H_
+void destroy_executor(void* ptr);
+
+/**
+ * frame pipeline over slot_num input slots, see include/core/pipeline.hpp;
+ * the *_from_isr calls never block and may be used in interrupt handlers
+ */
+extern "C"
+void create_pipeline(void** pptr, void* executor, int slot_num, int channel,
+                     int height, int width);
+
+extern "C"
+void start_pipeline(void* ptr, int priority);
+
+extern "C"
+uint8_t* pipeline_slot_buffer(void* ptr, int slot);
+
+extern "C"
+int pipeline_acquire_slot(void* ptr);
+
+extern "C"
+int pipeline_acquire_slot_from_isr(void* ptr);
+
+extern "C"
+void pipeline_submit_slot(void* ptr, int slot);
+
+extern "C"
+int pipeline_submit_slot_from_isr(void* ptr, int slot);
+
+extern "C"
+int pipeline_wait_result(void* ptr);
+
+/**
+ * 0 when the inference of a slot succeeded, -1 when the model failed and
+ * the slot output is not valid
+ */
+extern "C"
+int pipeline_slot_status(void* ptr, int slot);
+
+extern "C"
+void pipeline_copy_output(void* ptr, int slot, void* data_ptr, size_t size);
+
+/**
+ * view of the slot output without copying it, valid until the slot is
+ * released
+ */
+extern "C"
+int pipeline_output_view(void* ptr, int slot, tensor_view_t* view);
+
+extern "C"
+void pipeline_release_slot(void* ptr, int slot);
+
+extern "C"
+void destroy_pipeline(void* ptr);
+
+/**
+ * allocate tensor data from a size class pool over region (size bytes,
+ * NULL takes them from the heap once) instead of malloc; tensors created
+ * before keep their allocator. Returns -1 when the region is not usable.
+ */
+extern "C"
+int use_pool_allocator(void* region, size_t size);
+
+extern "C"
+void get_allocator_stats(allocator_stats_t* stats);
+#endif  // INCLUDE_CORE_RVTENSOR_API_H_
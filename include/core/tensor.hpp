@@ -8,32 +8,15 @@
 #ifndef INCLUDE_CORE_TENSOR_HPP_
 #define INCLUDE_CORE_TENSOR_HPP_
 
+#include <cassert>
 #include <memory>
+#include <string>
 #include <string.h> //NOLINT
+#include "include/core/allocator.hpp"
+#include "include/core/types.hpp"
 
 namespace RVTensor {
 
-/**
- * Aligns a buffer size to the specified number of bytes
- */
-static inline size_t alignSize(size_t sz, int n) {
-  return (sz + n-1) & -n;
-}
-
-/**
- * the alignment of all the allocated buffers
- */
-#define MALLOC_ALIGN    16
-
-/**Aligns a pointer to the specified number of bytes
- * @param ptr: Aligned pointer
- * @param n: Alignment size that must be a power of two
- */
-template<typename _Tp> static inline _Tp* alignPtr(
-    _Tp* ptr, int n = sizeof(_Tp)) {
-  return reinterpret_cast<_Tp*>(((size_t)ptr + n - 1) & -n);
-}
-
 /**
  * RVTensor data descriptor
  *
@@ -76,11 +59,13 @@ class Tensor {
      */
     size_t count() const;
     /**
-     * True size of the elements in Tensor
+     * True size of the elements in Tensor, INT4 data is packed two
+     * elements per byte with every batch item padded to whole bytes
      */
     size_t trueSize() const;
     /**
-     * Total size of elements in Tensor
+     * Total size of elements in Tensor, the bytes from data_ptr to the
+     * last element for views
      */
     size_t totalSize() const;
 
@@ -98,6 +83,13 @@ class Tensor {
      */
     size_t element_size;
 
+    /**
+     * element type, derived from element_size unless set explicitly
+     * (e.g. int8 symmetric quantized data)
+     */
+    DataType data_type;
+    void setDataType(DataType type);
+
     /**
      * dimension of the Tensor
      */
@@ -111,16 +103,66 @@ class Tensor {
      */
     size_t cstep;
 
+    /**
+     * data layout: block channels are interleaved per pixel and the
+     * groups() channel groups are stored as planes cstep elements apart
+     *
+     *   LAYOUT_NCHW    block 1        groups channel
+     *   LAYOUT_NHWC    block channel  groups 1
+     *   LAYOUT_NCXHWX  block x        groups ceil(channel / x), channels
+     *                                 past channel are padding holding 0
+     *                                 (the zero point when quantized)
+     */
+    TensorLayout layout;
+    int block;
+    int groups() const;
+
+    /**
+     * elements between rows and between batch items of views, 0 when the
+     * rows (width * block) and items (cstep * groups()) are packed
+     */
+    size_t hstep;
+    size_t nstep;
+    size_t rowStep() const;
+    size_t batchStep() const;
+    /**
+     * rows and batch items are packed, see hstep and nstep
+     */
+    bool isContiguous() const;
+
+    /**
+     * element offset of (n, c, h, w) from data_ptr
+     */
+    size_t offset(int n, int c, int h, int w) const;
+
+    /**
+     * alignment in bytes of data_ptr and of every channel plane of
+     * allocated tensors: MALLOC_ALIGN, VECTOR_ALIGN, CACHE_LINE_ALIGN or
+     * KPU_ROW_ALIGN
+     */
+    size_t alignment;
+    /**
+     * data_ptr and every channel plane start at an alignment boundary,
+     * so kernels may use aligned loads
+     */
+    bool isAligned() const;
+
     /**
      * quantize params and method
      */
     float min_range;
     float max_range;
-    int64_t scale;
-    float zero_point;
-    void setQuantizeParams(float min, float max, int64_t sc, float zero);
+    float scale;
+    int32_t zero_point;
+    void setQuantizeParams(float min, float max, float sc, int32_t zero);
     void setQuantizeRange(float min, float max);
-    void setQuantizer(int64_t sc, float zero);
+    void setQuantizer(float sc, int32_t zero);
+
+    /**
+     * name of the tensor in the model, used to match calibration results
+     */
+    std::string name;
+    void setName(const std::string& tensor_name);
 };
 
 class FlashTensor : public Tensor {
@@ -141,12 +183,40 @@ class FlashTensor : public Tensor {
     FlashTensor& operator=(const FlashTensor& m);
 
     /**
-     * bind model data to the Tensor
+     * bind model data to the Tensor, set data_type first for INT4 data
      */
     void bindData(void* data, size_t size);
 
     /**
-     * get const data reference
+     * bind a compressed weight container (include/core/weight_codec.hpp)
+     * of size bytes in place of the data: data_ptr stays nullptr and the
+     * blocks are decoded by a WeightStream while they are used; set
+     * data_type first for INT4 data
+     */
+    void bindCompressedData(const void* data, size_t size);
+    bool isCompressed() const;
+
+    /// compressed weight container and its size, nullptr for plain data
+    const uint8_t* compressed_data;
+    size_t compressed_size;
+
+    /**
+     * bind per output channel (n_batch) quantize scales of weights;
+     * the zero_point stays per tensor
+     */
+    void bindChannelScales(const float* scales, size_t num);
+
+    /**
+     * quantize scale of output channel n, falls back to the per tensor
+     * scale when no channel scales are bound
+     */
+    float channelScale(int n) const;
+
+    /// per output channel quantize scales, nullptr for per tensor
+    const float* channel_scales;
+
+    /**
+     * get const data reference, element offsets follow offset()
      */
     template<typename T> const T* grepBatchData(int n) const;
     template<typename T> const T* grepChannelData(int n, int c) const;
@@ -159,16 +229,22 @@ class RamTensor : public Tensor {
  public:
     using sptr = std::shared_ptr<RamTensor>;
     static sptr create();
-    static sptr create(int n, int c, int h, int w, size_t elemsize = 4u);
-    static sptr create(int n, int c, int h, int w,
-                       void* data, size_t elemsize = 4u);
+    /**
+     * alignment applies to data_ptr and to cstep of every channel count;
+     * it must be a power of two and at least elemsize
+     */
+    static sptr create(int n, int c, int h, int w, size_t elemsize = 4u,
+                       size_t alignment = MALLOC_ALIGN);
+    static sptr create(int n, int c, int h, int w, void* data,
+                       size_t elemsize = 4u, size_t alignment = MALLOC_ALIGN);
 
     /**
      * Constructor & Deconstructor
      */
     RamTensor();
-    RamTensor(int n, int c, int h, int w, size_t elemsize);
-    RamTensor(int n, int c, int h, int w, void* data, size_t elemsize);
+    RamTensor(int n, int c, int h, int w, size_t elemsize, size_t alignment);
+    RamTensor(int n, int c, int h, int w, void* data, size_t elemsize,
+              size_t alignment);
     ~RamTensor();
     RamTensor& operator=(const RamTensor& m);
 
@@ -190,7 +266,61 @@ class RamTensor : public Tensor {
     void writeData(void* data, size_t size);
 
     /**
-     * get data reference
+     *  copy data to a dense (cstep == h * w) buffer of trueSize() bytes
+     */
+    void readData(void* data, size_t size) const;
+
+    /**
+     *  copy batch item n from/to a dense buffer of trueSize() / n_batch
+     *  bytes
+     */
+    void writeData(int n, const void* data, size_t size);
+    void readData(int n, void* data, size_t size) const;
+
+    /**
+     *  use caller memory of at least totalSize() bytes (same layout) as
+     *  data, the owned buffer is released
+     */
+    void bindData(void* data);
+
+    /**
+     *  allocate owned data for a tensor created without data (or bound to
+     *  caller memory), e.g. once its layout is settled
+     */
+    void allocateData();
+
+    /**
+     *  view of the region [n0, n0 + n) x [c0, c0 + c) x [h0, h0 + h) x
+     *  [w0, w0 + w) of parent without copying: the view shares the data
+     *  (and keeps it alive), the layout, cstep and quantizer of parent and
+     *  steps over the rest with hstep/nstep. c0 must be a multiple of the
+     *  block of LAYOUT_NCXHWX tensors. The view is stale once parent is
+     *  rebound or its layout changes.
+     */
+    static sptr view(sptr parent, int n0, int c0, int h0, int w0,
+                     int n, int c, int h, int w);
+    /**
+     * views of c channels from c0 and of a h x w crop at (h0, w0)
+     */
+    static sptr channels(sptr parent, int c0, int c);
+    static sptr crop(sptr parent, int h0, int w0, int h, int w);
+
+    /**
+     * every block holds channels of this tensor only, so whole rows of
+     * width * block elements may be written; false for channel views of
+     * NHWC and NCxHWx tensors
+     */
+    bool wholeBlocks() const;
+
+    /**
+     *  change the layout of the tensor, x is the block of LAYOUT_NCXHWX
+     *  (VECTOR_ALIGN / element_size when 0); the data is not converted
+     *  (see LayoutOp) and owned data is reallocated when it is too small
+     */
+    void setLayout(TensorLayout layout, int x = 0);
+
+    /**
+     * get data reference, element offsets follow offset()
      */
     template<typename T> T* grepBatchData(int n);
     template<typename T> T* grepChannelData(int n, int c);
@@ -204,12 +334,87 @@ class RamTensor : public Tensor {
      */
     void* tensorDataMalloc(size_t size);
     void tensorDataFree();
+    /**
+     * set alignment and the cstep it gives
+     */
+    void setAlignment(size_t align);
+    /**
+     * copy batch n between dense NCHW data and a non NCHW layout or a view
+     */
+    void copyElements(int n, uint8_t* dense, bool to_tensor) const;
     /**
      * Is data_ptr malloced in Tensor/RamTensor
      */
     bool is_malloced;
+    /// allocator of data_ptr when is_malloced
+    Allocator::sptr allocator_;
+    /// bytes of data_ptr when is_malloced
+    size_t malloced_size;
+    /// tensor owning the data of a view
+    sptr parent_;
 };
 
+////////////////// element access ////////////////////////////////
+template<typename T>
+inline const T* FlashTensor::grepBatchData(int n) const {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<const T*>(data_ptr) + offset(n, 0, 0, 0);
+}
+
+template<typename T>
+inline const T* FlashTensor::grepChannelData(int n, int c) const {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<const T*>(data_ptr) + offset(n, c, 0, 0);
+}
+
+template<typename T>
+inline const T* FlashTensor::grepRowData(int n, int c, int h) const {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<const T*>(data_ptr) + offset(n, c, h, 0);
+}
+
+template<typename T>
+inline const T FlashTensor::grepElement(int n, int c, int h, int w) const {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<const T*>(data_ptr)[offset(n, c, h, w)];
+}
+
+template<typename T>
+inline FlashTensor::operator const T*() const {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<const T*>(data_ptr);
+}
+
+template<typename T>
+inline T* RamTensor::grepBatchData(int n) {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<T*>(data_ptr) + offset(n, 0, 0, 0);
+}
+
+template<typename T>
+inline T* RamTensor::grepChannelData(int n, int c) {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<T*>(data_ptr) + offset(n, c, 0, 0);
+}
+
+template<typename T>
+inline T* RamTensor::grepRowData(int n, int c, int h) {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<T*>(data_ptr) + offset(n, c, h, 0);
+}
+
+template<typename T>
+inline T RamTensor::grepElement(int n, int c, int h, int w) {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<T*>(data_ptr)[offset(n, c, h, w)];
+}
+
+template<typename T>
+inline RamTensor::operator T*() {
+  assert(sizeof(T) == element_size);
+  return reinterpret_cast<T*>(data_ptr);
+}
+
 }  // namespace RVTensor
 
 #endif  // INCLUDE_CORE_TENSOR_HPP_
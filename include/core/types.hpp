@@ -8,8 +8,36 @@
 #ifndef INCLUDE_CORE_TYPES_HPP_
 #define INCLUDE_CORE_TYPES_HPP_
 
+#include <cstddef>
+
 namespace RVTensor {
 
+/// element type of the Tensor data
+enum DataType {
+  FLOAT32 = 0,
+  INT32   = 1,
+  UINT16  = 2,
+  INT16   = 3,
+  UINT8   = 4,
+  INT8    = 5,
+  FLOAT16 = 6,  // IEEE half stored as uint16_t, see include/core/half.hpp
+  INT4    = 7   // symmetric [-7, 7] weights, two per byte (low nibble
+                // first), every batch item padded to whole bytes; see
+                // include/core/int4.hpp
+};
+
+/// default data type for an element size: float32 or unsigned integers
+static inline DataType defaultDataType(size_t elemsize) {
+  return elemsize == 2 ? UINT16 : (elemsize == 1 ? UINT8 : FLOAT32);
+}
+
+/// memory layout of the Tensor data, see Tensor::block
+enum TensorLayout {
+  LAYOUT_NCHW   = 0,
+  LAYOUT_NHWC   = 1,
+  LAYOUT_NCXHWX = 2   // channels blocked by x = Tensor::block
+};
+
 struct ConvParam {
   /// stride
   int sw;
@@ -24,6 +52,22 @@ struct ConvParam {
   bool quantized;
 };
 
+/// CPUConvOp algorithm of a uint8/int8 NCHW convolution
+enum ConvAlgorithm {
+  CONV_ALGO_DEFAULT = 0,  // tuning table entry of the layer, else direct
+  CONV_ALGO_DIRECT  = 1,  // dot product of every output pixel
+  CONV_ALGO_ROWS    = 2,  // whole output rows per weight, tile channels
+                          // at a time
+  CONV_ALGO_GEMM    = 3   // pointwise, contiguous planes: GEMM of the
+                          // weights and panels of tile pixels
+};
+
+struct ConvTuning {
+  ConvAlgorithm algorithm;
+  /// blocking of the algorithm, 0 for none
+  int tile;
+};
+
 /// Quantizing deep convolutional networks for efficient inference: A whitepaper
 /// https://arxiv.org/abs/1806.08342
 enum QuantizeStrategy {
@@ -35,13 +79,73 @@ enum QuantizeStrategy {
   AFFINE_DEQUANTIZE_UINT16TOFLOAT32   = 5,
   SYMMETRIC_DEQUANTIZE_INT8TOFLOAT32  = 6,
   SYMMETRIC_DEQUANTIZE_INT16TOFLOAT32 = 7,
-  NONE                                = 8
+  NONE                                = 8,
+  // float16 storage, casts keep the quantizer of the input
+  CAST_FLOAT32TOFLOAT16               = 9,
+  CAST_FLOAT16TOFLOAT32               = 10,
+  AFFINE_QUANTIZE_FLOAT16TOUINT8      = 11,
+  AFFINE_DEQUANTIZE_UINT8TOFLOAT16    = 12
 };
 
 struct QuantizeParam {
   int input_elemsize;
   int output_elemsize;
   QuantizeStrategy quant_type;
+  /// use the calibrated scale/zero_point already set on the tensors
+  /// instead of scanning the input for its range at runtime
+  bool static_range;
+};
+
+enum ActivationType {
+  ACTIVATION_RELU       = 0,
+  ACTIVATION_RELU6      = 1,
+  ACTIVATION_LEAKY_RELU = 2,  // alpha * x below 0
+  ACTIVATION_SIGMOID    = 3,
+  ACTIVATION_TANH       = 4
+};
+
+struct ActivationParam {
+  ActivationType type;
+  /// slope of ACTIVATION_LEAKY_RELU below 0
+  float alpha;
+};
+
+enum PoolType {
+  POOL_MAX     = 0,
+  POOL_AVERAGE = 1   // of the window taps inside the input
+};
+
+struct PoolParam {
+  PoolType type;
+  /// window
+  int kw;
+  int kh;
+  /// stride
+  int sw;
+  int sh;
+  /// add pad, pw / 2 columns left and ph / 2 rows above like ConvParam
+  int pw;
+  int ph;
+};
+
+enum FrameFormat {
+  FRAME_RGB565       = 0,
+  FRAME_RGB24_PLANAR = 1
+};
+
+enum ResizeMethod {
+  RESIZE_NEAREST  = 0,
+  RESIZE_BILINEAR = 1
+};
+
+struct PreprocessParam {
+  ResizeMethod resize;
+  /// output channel c is read from source channel channel_order[c]
+  /// (RGB: 0 1 2, BGR: 2 1 0)
+  int channel_order[3];
+  /// output = ((pixel - mean) / std) quantized with the output quantizer
+  float mean[3];
+  float std[3];
 };
 
 }  // namespace RVTensor
@@ -0,0 +1,197 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_WEIGHT_CODEC_HPP_
+#define INCLUDE_CORE_WEIGHT_CODEC_HPP_
+
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace RVTensor {
+
+/**
+ * Compressed weight container, referenced in place by
+ * FlashTensor::bindCompressedData and decoded by WeightStream:
+ *
+ *   +------------------------+  0
+ *   | WeightCodecHeader      |
+ *   +------------------------+  sizeof(WeightCodecHeader)
+ *   | uint32_t offsets[n+1]  |  block b is [offsets[b], offsets[b + 1])
+ *   +------------------------+
+ *   | blocks                 |  block b decodes to the raw data of the
+ *   |                        |  batch items (output channels) from
+ *   |                        |  b * block_channels, at most block_channels
+ *   +------------------------+
+ *
+ * WEIGHT_CODEC_RLE blocks are PackBits style runs: a control byte h < 128
+ * is followed by h + 1 literal bytes, h >= 128 by one byte repeated
+ * h - 125 times. Quantized weights of pruned or low bit models are mostly
+ * repeated zero points, which the runs take at 2 bytes per 130.
+ */
+
+/// "RVWC"
+#define WEIGHT_CODEC_MAGIC  0x43575652u
+
+enum WeightCodec {
+  WEIGHT_CODEC_RAW = 0,  // blocks are stored as is
+  WEIGHT_CODEC_RLE = 1
+};
+
+struct WeightCodecHeader {
+  uint32_t magic;
+  uint32_t codec;           // WeightCodec of every block
+  uint32_t block_num;
+  uint32_t block_channels;  // batch items per block, the last has the rest
+  uint32_t item_size;       // raw bytes of one batch item
+  uint32_t raw_size;        // raw bytes of all blocks
+  uint32_t reserved[2];
+};
+
+/**
+ * header of a container of size bytes holding raw_size bytes of batch
+ * items, nullptr when it is broken
+ */
+static inline const WeightCodecHeader* weightCodecHeader(const void* data,
+                                                         size_t size,
+                                                         size_t raw_size) {
+  const WeightCodecHeader* header =
+      reinterpret_cast<const WeightCodecHeader*>(data);
+  if (data == nullptr || size < sizeof(WeightCodecHeader) ||
+      header->magic != WEIGHT_CODEC_MAGIC ||
+      header->codec > WEIGHT_CODEC_RLE || header->block_channels == 0 ||
+      header->item_size == 0 || header->raw_size != raw_size ||
+      raw_size % header->item_size != 0)
+    return nullptr;
+  const size_t items = raw_size / header->item_size;
+  if (header->block_num != (items + header->block_channels - 1) /
+                           header->block_channels ||
+      size < sizeof(WeightCodecHeader) +
+             (header->block_num + 1) * sizeof(uint32_t))
+    return nullptr;
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(header + 1);
+  if (offsets[0] != sizeof(WeightCodecHeader) +
+                    (header->block_num + 1) * sizeof(uint32_t))
+    return nullptr;
+  for (uint32_t b = 0; b < header->block_num; b++) {
+    if (offsets[b + 1] < offsets[b] || offsets[b + 1] > size)
+      return nullptr;
+  }
+  return header;
+}
+
+/**
+ * decode src_size bytes of RLE runs into exactly dst_size bytes, false
+ * when the runs are broken or decode to another size
+ */
+static inline bool decodeRle(const uint8_t* src, size_t src_size,
+                             uint8_t* dst, size_t dst_size) {
+  size_t i = 0, o = 0;
+  while (i < src_size) {
+    const uint8_t h = src[i++];
+    if (h < 128) {
+      const size_t num = h + 1u;
+      if (i + num > src_size || o + num > dst_size)
+        return false;
+      memcpy(dst + o, src + i, num);
+      i += num;
+      o += num;
+    } else {
+      const size_t num = h - 125u;
+      if (i >= src_size || o + num > dst_size)
+        return false;
+      memset(dst + o, src[i++], num);
+      o += num;
+    }
+  }
+  return o == dst_size;
+}
+
+/**
+ * append the RLE runs of num bytes to out
+ */
+static inline void encodeRle(const uint8_t* src, size_t num,
+                             std::vector<uint8_t>* out) {
+  size_t i = 0;
+  while (i < num) {
+    size_t run = 1;
+    while (i + run < num && run < 130 && src[i + run] == src[i])
+      run++;
+    if (run >= 3) {
+      out->push_back(static_cast<uint8_t>(run + 125));
+      out->push_back(src[i]);
+      i += run;
+      continue;
+    }
+    // literals up to the next run of 3
+    size_t end = i;
+    while (end < num && end - i < 128 &&
+           !(end + 2 < num && src[end] == src[end + 1] &&
+             src[end] == src[end + 2]))
+      end++;
+    out->push_back(static_cast<uint8_t>(end - i - 1));
+    out->insert(out->end(), src + i, src + end);
+    i = end;
+  }
+}
+
+/**
+ * container of items batch items of item_size raw bytes in blocks of
+ * block_channels items, RLE coded unless the runs are not smaller than
+ * the raw data
+ */
+static inline std::vector<uint8_t> encodeWeights(const uint8_t* raw,
+                                                 size_t item_size,
+                                                 size_t items,
+                                                 size_t block_channels) {
+  WeightCodecHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = WEIGHT_CODEC_MAGIC;
+  header.block_num = static_cast<uint32_t>(
+      (items + block_channels - 1) / block_channels);
+  header.block_channels = static_cast<uint32_t>(block_channels);
+  header.item_size = static_cast<uint32_t>(item_size);
+  header.raw_size = static_cast<uint32_t>(items * item_size);
+
+  std::vector<std::vector<uint8_t>> blocks(header.block_num);
+  size_t rle_size = 0;
+  for (uint32_t b = 0; b < header.block_num; b++) {
+    const size_t first = b * block_channels;
+    const size_t num = (items - first < block_channels ? items - first
+                        : block_channels) * item_size;
+    encodeRle(raw + first * item_size, num, &blocks[b]);
+    rle_size += blocks[b].size();
+  }
+  header.codec = rle_size < header.raw_size ? WEIGHT_CODEC_RLE
+                 : WEIGHT_CODEC_RAW;
+
+  std::vector<uint8_t> out(sizeof(header) +
+                           (header.block_num + 1) * sizeof(uint32_t));
+  std::vector<uint32_t> offsets(header.block_num + 1);
+  offsets[0] = static_cast<uint32_t>(out.size());
+  for (uint32_t b = 0; b < header.block_num; b++) {
+    const size_t first = b * block_channels;
+    if (header.codec == WEIGHT_CODEC_RLE) {
+      out.insert(out.end(), blocks[b].begin(), blocks[b].end());
+    } else {
+      const size_t num = (items - first < block_channels ? items - first
+                          : block_channels) * item_size;
+      out.insert(out.end(), raw + first * item_size,
+                 raw + first * item_size + num);
+    }
+    offsets[b + 1] = static_cast<uint32_t>(out.size());
+  }
+  memcpy(out.data(), &header, sizeof(header));
+  memcpy(out.data() + sizeof(header), offsets.data(),
+         offsets.size() * sizeof(uint32_t));
+  return out;
+}
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_WEIGHT_CODEC_HPP_
@@ -0,0 +1,101 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_CORE_WEIGHT_STREAM_HPP_
+#define INCLUDE_CORE_WEIGHT_STREAM_HPP_
+
+#include <vector>
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/os.hpp"
+
+namespace RVTensor {
+
+/**
+ * WeightStream decodes the blocks of a compressed FlashTensor into a ring
+ * of slot buffers, in order, once per pass over the weights.
+ *
+ *   decode task ---> ready ---> acquire ... release ---> free ---+
+ *        ^                                                      |
+ *        +------------------------------------------------------+
+ *
+ * While the op works on block b, the decode task fills block b + 1 into
+ * the next slot, so the RAM taken by the weights is slot_num blocks
+ * instead of the whole tensor. A tensor of a single block is decoded once
+ * when the stream is created and stays decoded.
+ */
+class WeightStream {
+ public:
+    using sptr = std::shared_ptr<WeightStream>;
+    static sptr create(FlashTensor::sptr weight, int slot_num = 2,
+                       int priority = 3, size_t stack_size = 4096);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    WeightStream(FlashTensor::sptr weight, int slot_num, int priority,
+                 size_t stack_size);
+    ~WeightStream();
+
+    /**
+     * number of blocks and batch items (output channels) of a full block
+     */
+    int blockNum() const;
+    int blockChannels() const;
+
+    /**
+     * begin a pass over all blocks, the rest of an unfinished pass is
+     * skipped
+     */
+    void start();
+
+    /**
+     * wait for the next block of the pass: its raw data of num batch items
+     * from batch item c0, valid until release()
+     */
+    const uint8_t* acquire(int* c0, int* num);
+    void release();
+
+ private:
+    WeightStream(const WeightStream&);
+    WeightStream& operator=(const WeightStream&);
+
+    /**
+     * decode block into slot, false when the data is broken
+     */
+    bool decode(int block, int slot);
+    /**
+     * next decoded slot, -slot - 1 when the block is broken
+     */
+    int receiveBlock();
+    /**
+     * acquire and release the rest of the pass
+     */
+    void finish();
+    static void decodeEntry(void* arg);
+
+    FlashTensor::sptr weight_;
+    /// raw bytes of one batch item
+    size_t item_size_;
+    int block_num_;
+    int block_channels_;
+    /// decoded blocks
+    std::vector<RamTensor::sptr> slots_;
+    /// pass requests and stop (-1) for the decode task
+    Queue::sptr request_;
+    Queue::sptr free_;
+    Queue::sptr ready_;
+    Task::sptr task_;
+    /// next block of the pass, -1 out of a pass
+    int next_;
+    /// slot of the acquired block, -1 for none
+    int held_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_CORE_WEIGHT_STREAM_HPP_
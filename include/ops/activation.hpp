@@ -0,0 +1,84 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_ACTIVATION_HPP_
+#define INCLUDE_OPS_ACTIVATION_HPP_
+
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/operation.hpp"
+#include "include/core/types.hpp"
+
+namespace RVTensor {
+
+/**
+ * Element wise activation of a float32 or uint8 tensor into a tensor of
+ * the same shape, layout and element size.
+ *
+ * uint8 tensors go through a table of the 256 input levels, built from the
+ * quantizers of the input and output: any activation costs one lookup per
+ * element. An output without a quantizer (scale 0) gets the range of the
+ * activation applied to the input range.
+ */
+class ActivationOp: public Operation {
+ public:
+    using sptr = std::shared_ptr<ActivationOp>;
+    static sptr create();
+    static sptr create(ActivationParam param, RamTensor::sptr input,
+                       RamTensor::sptr output);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    ActivationOp();
+    ActivationOp(ActivationParam param, RamTensor::sptr input,
+                 RamTensor::sptr output);
+    ~ActivationOp();
+
+    /**
+     * check output dims
+     */
+    void checkOutputDims() override;
+
+    /**
+     * inference
+     */
+    void forward_compute() override;
+
+    /**
+     * band execution, output row h reads input row h
+     */
+    bool supportsRows() override;
+    void inputRows(int h0, int h1, int* begin, int* end) override;
+    void forwardRows(int h0, int h1) override;
+
+ private:
+    /**
+     * activation of a real value
+     */
+    float apply(float x) const;
+
+    /**
+     * real range of the output over [in_min, in_max], covering 0
+     */
+    void range(float in_min, float in_max, float* min, float* max) const;
+
+    /**
+     * rebuild lut_ when the quantizers changed since the last build
+     */
+    void updateLut();
+
+    ActivationParam param_;
+    uint8_t lut_[256];
+    /// input scale, zero point and output scale, zero point of lut_, NaN
+    /// before the first build
+    float lut_key_[4];
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_ACTIVATION_HPP_
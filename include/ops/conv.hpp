@@ -8,11 +8,13 @@
 #ifndef INCLUDE_OPS_CONV_HPP_
 #define INCLUDE_OPS_CONV_HPP_
 
+#include <string>
 #include <vector>
 #include <memory>
 #include "include/core/tensor.hpp"
 #include "include/core/operation.hpp"
 #include "include/core/types.hpp"
+#include "include/core/weight_stream.hpp"
 
 namespace RVTensor {
 
@@ -48,13 +50,162 @@ class CPUConvOp: public Operation {
      */
     void forward_compute() override;
 
+    /**
+     * band execution of uint8/int8 weights that are not compressed
+     */
+    bool supportsRows() override;
+    void inputRows(int h0, int h1, int* begin, int* end) override;
+    void forwardRows(int h0, int h1) override;
+
+    /**
+     * algorithm and tile of the layer, checked and looked up in the
+     * ConvTuner table (include/ops/conv_tuner.hpp) by the first forward;
+     * CONV_ALGO_DEFAULT uses the table entry of the layer
+     */
+    void setTuning(ConvTuning tuning);
+    ConvTuning getTuning() const;
+
+    /**
+     * algorithms and tiles that can run the layer, empty unless the
+     * layer has a choice (uint8/int8 weights, NCHW, not compressed)
+     */
+    std::vector<ConvTuning> tunings();
+
+    /**
+     * key of the layer in the ConvTuner table
+     */
+    std::string tuningKey();
+
  private:
+    /**
+     * settle tuning_: an applicable setTuning(), else the table entry of
+     * the layer, else benchmark the tunings() in tuning mode over output
+     * rows [h0, h1)
+     */
+    void resolveTuning(int h0, int h1);
+
+    /**
+     * fastest of the candidates over repeat forwards of rows [h0, h1)
+     */
+    ConvTuning benchmark(const std::vector<ConvTuning>& candidates,
+                         int repeat, int h0, int h1);
+
+    /**
+     * uint8/int8 weights and NCHW tensors: run the algorithm of tuning_;
+     * these and pointwise() compute output rows [h0, h1)
+     */
+    template<typename WT> void convolveTuned(int h0, int h1);
+
+    /**
+     * compressed weights: every block of output channels from the
+     * WeightStream runs as a convolution of the block into a channel
+     * view of the output, the convolutions are kept between forwards
+     */
+    void forwardBlocks();
+
+    /**
+     * direct convolution with weights of type WT (uint8 affine or int8
+     * symmetric)
+     */
+    template<typename WT> void convolve(int h0, int h1);
+
+    /**
+     * direct convolution by output rows: tile output channels at a time,
+     * every weight tap accumulates the input row segment it reads into
+     * the whole output rows of the channels
+     */
+    template<typename WT> void convolveRows(int tile, int h0, int h1);
+
+    /**
+     * pointwise convolution of contiguous NCHW planes as a GEMM of the
+     * weights and panels of tile pixels, two input channels per pass over
+     * a panel
+     */
+    template<typename WT> void convolveGemm(int tile, int h0, int h1);
+
+    /**
+     * 1x1 convolution of NHWC tensors: every output pixel is the dot
+     * products of the contiguous input channels of the pixel and the
+     * weight rows, written as contiguous output channels
+     */
+    template<typename WT> void pointwise(int h0, int h1);
+
+    /**
+     * direct convolution of NCxHWx tensors: the weights of a block of
+     * output channels are packed once as block lanes per tap, every input
+     * element is multiplied into the lanes of one output pixel
+     */
+    template<typename WT> void convolveBlocked(int h0, int h1);
+
+    /**
+     * float16 input and weights, float32 accumulation and a float16 or
+     * float32 output; pointwise convolutions of packed planes run as a
+     * GEMM of the weights and the input planes
+     */
+    template<typename TO> void convolveHalf();
+
+    /**
+     * packed INT4 weights with per channel scales and a uint8 input:
+     * pointwise convolutions of packed planes run as a GEMM that unpacks
+     * the weights in registers, the others unpack one output channel of
+     * weights at a time and accumulate whole output rows per weight
+     */
+    void convolveInt4();
+
+    /**
+     * float32 bias of every output channel for float16 convolutions
+     */
+    std::vector<float> biasFloat() const;
+
+    /**
+     * 1x1 kernel, stride 1, no dilation and no padding
+     */
+    bool isPointwise() const;
+
+    /**
+     * pointwise with planes of contiguous rows in the input and output
+     */
+    bool isGemm();
+
+    /**
+     * bias of output channel c in accumulator units
+     */
+    int32_t biasValue(int c) const;
+
+    /**
+     * write num int32 accumulators of one output channel to the output at
+     * element offset, requantizing them when the output tensor is 8-bit
+     *
+     * @param acc_scale: real value of one accumulator step of the channel
+     */
+    void epilogue(const int32_t* acc, float acc_scale, size_t offset, int num);
+
     /// conv paramter
     ConvParam param_;
     /// model data: weight
     FlashTensor::sptr weight_;
     /// model data: bias
     FlashTensor::sptr bias_;
+    /// decoder of compressed weights, created by the first forward
+    WeightStream::sptr stream_;
+    /// convolutions of the blocks into channel views of the output data
+    /// block_output_, built by the first forward; their weights are
+    /// rebound to the decoded blocks on every pass
+    std::vector<std::shared_ptr<CPUConvOp>> block_ops_;
+    std::vector<FlashTensor::sptr> block_weights_;
+    void* block_output_;
+    /// algorithm of uint8/int8 NCHW layers, settled by the first forward
+    ConvTuning tuning_;
+    bool tuning_resolved_;
+    /// weights minus their zero point as [co / block][ci][kh][kw][block],
+    /// packed by the first NCxHWx forward
+    std::vector<int16_t> blocked_weight_;
+    /// dilated uint8/int8 weights with zero point taps in between, expanded
+    /// by the first forward (a block decodes to the same weights every pass)
+    std::vector<uint8_t> dilated_weight_;
+    /// float16 convolutions that are not a GEMM: widened input rows of one
+    /// output row, weights of one output channel and the output row
+    std::vector<float> half_scratch_;
 };
 
 }  // namespace RVTensor
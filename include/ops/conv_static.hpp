@@ -0,0 +1,228 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_CONV_STATIC_HPP_
+#define INCLUDE_OPS_CONV_STATIC_HPP_
+
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/operation.hpp"
+#include "include/ops/quantize_kernel.hpp"
+
+namespace RVTensor {
+
+/**
+ * Shape specialized convolution emitted by RVTensor_compiler.
+ *
+ * All dimensions, strides, paddings and dilations are template parameters,
+ * so the loops below have compile time trip counts the compiler can unroll.
+ * Output positions whose window lies fully inside the input are computed
+ * without any bounds check; only the border uses the checked path.
+ * Semantics (padding, zero points, fused requantize epilogue) are the same
+ * as CPUConvOp.
+ */
+template<int N, int CI, int HI, int WI, int CO, int KH, int KW,
+         int SH = 1, int SW = 1, int PH = 0, int PW = 0,
+         int DH = 1, int DW = 1, typename WT = uint8_t>
+class StaticConvOp: public Operation {
+ public:
+    using sptr = std::shared_ptr<StaticConvOp>;
+
+    enum {
+      /// dilated kernel size
+      EKH = (KH - 1) * DH + 1,
+      EKW = (KW - 1) * DW + 1,
+      /// output size
+      HO = (HI + PH - EKH) / SH + 1,
+      WO = (WI + PW - EKW) / SW + 1,
+      /// output rows/cols [BEGIN, END) whose window is inside the input
+      H_BEGIN = (PH / 2 + SH - 1) / SH,
+      W_BEGIN = (PW / 2 + SW - 1) / SW,
+      H_LAST = HI - EKH + PH / 2 < 0 ? 0 : (HI - EKH + PH / 2) / SH + 1,
+      W_LAST = WI - EKW + PW / 2 < 0 ? 0 : (WI - EKW + PW / 2) / SW + 1,
+      H_END = H_LAST < HO ? (H_LAST > H_BEGIN ? H_LAST : H_BEGIN) : HO,
+      W_END = W_LAST < WO ? (W_LAST > W_BEGIN ? W_LAST : W_BEGIN) : WO,
+      /// elements of one output channel kernel
+      KSIZE = CI * KH * KW
+    };
+
+    static sptr create(RamTensor::sptr input, RamTensor::sptr output,
+                       FlashTensor::sptr weight,
+                       FlashTensor::sptr bias = nullptr) {
+      sptr ptr = std::make_shared<StaticConvOp>(input, output, weight, bias);
+      ptr->checkOutputDims();
+      return ptr;
+    }
+
+    /**
+     * Constructor & Deconstructor
+     */
+    StaticConvOp(RamTensor::sptr input, RamTensor::sptr output,
+                 FlashTensor::sptr weight, FlashTensor::sptr bias = nullptr)
+      : Operation({input}, {output}), weight_(weight), bias_(bias) {}
+    ~StaticConvOp() {}
+
+    /**
+     * check the tensors match the compiled shape
+     */
+    void checkOutputDims() override {
+      auto input = getInputs()[0];
+      auto output = getOutputs()[0];
+      if (input->n_batch != N || input->channel != CI ||
+          input->height != HI || input->width != WI ||
+          input->element_size != 1 || input->data_type != DataType::UINT8) {
+        throw std::runtime_error("StaticConvOp input shape is wrong!");
+      }
+      if (input->layout != LAYOUT_NCHW || output->layout != LAYOUT_NCHW ||
+          !input->isContiguous() || !output->isContiguous()) {
+        throw std::runtime_error("StaticConvOp layout is wrong!");
+      }
+      if (output->n_batch != N || output->channel != CO ||
+          output->height != HO || output->width != WO) {
+        throw std::runtime_error("StaticConvOp output shape is wrong!");
+      }
+      if (output->element_size != 1 && output->element_size != 4) {
+        throw std::runtime_error(
+            "StaticConvOp unsupport output element size!");
+      }
+      if (weight_->n_batch != CO || weight_->channel != CI ||
+          weight_->height != KH || weight_->width != KW ||
+          weight_->element_size != sizeof(WT) ||
+          weight_->data_type == DataType::INT4 || weight_->isCompressed()) {
+        throw std::runtime_error("StaticConvOp weight shape is wrong!");
+      }
+    }
+
+    /**
+     * inference
+     */
+    void forward_compute() override {
+      auto input_tensor = getInputs()[0];
+      auto output_tensor = getOutputs()[0];
+      const uint8_t* input = reinterpret_cast<const uint8_t*>(
+                               input_tensor->data_ptr);
+      const WT* weight = reinterpret_cast<const WT*>(weight_->data_ptr);
+      const int stepi = input_tensor->cstep;
+      const int stepo = output_tensor->cstep;
+      const int32_t input_offset = input_tensor->zero_point;
+      const int32_t weight_offset = std::is_signed<WT>::value ? 0
+                                    : weight_->zero_point;
+
+      // interior windows: sum((x - xo) * w') = sum(x * w') - xo * sum(w')
+      int32_t weight_sum[CO];
+      float acc_scales[CO];
+      for (int co = 0; co < CO; co++) {
+        int32_t sum = 0;
+        for (int k = 0; k < KSIZE; k++)
+          sum += weight[co * KSIZE + k] - weight_offset;
+        weight_sum[co] = sum;
+        acc_scales[co] = input_tensor->scale * weight_->channelScale(co);
+      }
+
+      int32_t acc_row[WO];
+      for (int n = 0; n < N; n++) {
+        const uint8_t* in = input + n * CI * stepi;
+        for (int co = 0; co < CO; co++) {
+          const WT* w = weight + co * KSIZE;
+          const int32_t bias = biasValue(co);
+          const int32_t interior_offset = bias - input_offset * weight_sum[co];
+          for (int ho = 0; ho < HO; ho++) {
+            const bool row_inside = ho >= H_BEGIN && ho < H_END;
+            for (int wo = 0; wo < WO; wo++) {
+              if (row_inside && wo >= W_BEGIN && wo < W_END) {
+                acc_row[wo] = interior_offset +
+                              dotInside(in, w, stepi, ho, wo, weight_offset);
+              } else {
+                acc_row[wo] = bias + dotBorder(in, w, stepi, ho, wo,
+                                               input_offset, weight_offset);
+              }
+            }
+            epilogue(acc_row, acc_scales[co],
+                     n * CO * stepo + co * stepo + ho * WO);
+          }
+        }
+      }
+    }
+
+ private:
+    static inline int32_t dotInside(const uint8_t* in, const WT* w, int stepi,
+                                    int ho, int wo, int32_t weight_offset) {
+      const int hs = SH * ho - PH / 2;
+      const int ws = SW * wo - PW / 2;
+      int32_t acc = 0;
+      for (int ci = 0; ci < CI; ci++) {
+        const uint8_t* plane = in + ci * stepi;
+        for (int kh = 0; kh < KH; kh++) {
+          const uint8_t* row = plane + (hs + kh * DH) * WI + ws;
+          for (int kw = 0; kw < KW; kw++) {
+            acc += row[kw * DW] *
+                   (w[(ci * KH + kh) * KW + kw] - weight_offset);
+          }
+        }
+      }
+      return acc;
+    }
+
+    static inline int32_t dotBorder(const uint8_t* in, const WT* w, int stepi,
+                                    int ho, int wo, int32_t input_offset,
+                                    int32_t weight_offset) {
+      const int hs = SH * ho - PH / 2;
+      const int ws = SW * wo - PW / 2;
+      int32_t acc = 0;
+      for (int ci = 0; ci < CI; ci++) {
+        const uint8_t* plane = in + ci * stepi;
+        for (int kh = 0; kh < KH; kh++) {
+          const int h = hs + kh * DH;
+          if (h < 0 || h >= HI)
+            continue;
+          for (int kw = 0; kw < KW; kw++) {
+            const int x = ws + kw * DW;
+            if (x < 0 || x >= WI)
+              continue;
+            acc += (plane[h * WI + x] - input_offset) *
+                   (w[(ci * KH + kh) * KW + kw] - weight_offset);
+          }
+        }
+      }
+      return acc;
+    }
+
+    int32_t biasValue(int c) const {
+      if (!bias_)
+        return 0;
+      if (bias_->element_size == 4)
+        return reinterpret_cast<const int32_t*>(bias_->data_ptr)[c];
+      return reinterpret_cast<const uint8_t*>(bias_->data_ptr)[c];
+    }
+
+    void epilogue(const int32_t* acc, float acc_scale, size_t offset) {
+      auto output_tensor = getOutputs()[0];
+      if (output_tensor->element_size == 1) {
+        uint8_t* output = reinterpret_cast<uint8_t*>(output_tensor->data_ptr);
+        const float multiplier = output_tensor->scale == 0.f ? 0.f
+                                 : acc_scale / output_tensor->scale;
+        requantizeKernel<uint8_t>(acc, output + offset, WO, multiplier,
+            static_cast<float>(output_tensor->zero_point));
+      } else {
+        float* output = reinterpret_cast<float*>(output_tensor->data_ptr);
+        for (int i = 0; i < WO; i++)
+          output[offset + i] = static_cast<float>(acc[i]) * acc_scale;
+      }
+    }
+
+    /// model data: weight
+    FlashTensor::sptr weight_;
+    /// model data: bias
+    FlashTensor::sptr bias_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_CONV_STATIC_HPP_
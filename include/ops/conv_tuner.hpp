@@ -0,0 +1,110 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_CONV_TUNER_HPP_
+#define INCLUDE_OPS_CONV_TUNER_HPP_
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include "include/core/os.hpp"
+#include "include/core/types.hpp"
+
+namespace RVTensor {
+
+/**
+ * layer key of the tuning table: weight type and the conv shape, e.g.
+ * uint8_16x60x80_32x3x3_s1x1_d1x1_p2x2
+ */
+static inline std::string convTuningKey(DataType weight_type, int ci,
+                                        int hi, int wi, int co, int kh,
+                                        int kw, const ConvParam& param) {
+  char key[128];
+  snprintf(key, sizeof(key), "%s_%dx%dx%d_%dx%dx%d_s%dx%d_d%dx%d_p%dx%d",
+           weight_type == INT8 ? "int8" : "uint8", ci, hi, wi, co, kh, kw,
+           param.sw, param.sh, param.dw, param.dh, param.pw, param.ph);
+  return key;
+}
+
+/**
+ * ConvTuning in one int32 of a serialized conv op: algorithm | tile << 8
+ */
+static inline int32_t packConvTuning(ConvTuning tuning) {
+  return static_cast<int32_t>(tuning.algorithm) | tuning.tile << 8;
+}
+
+static inline ConvTuning unpackConvTuning(int32_t packed) {
+  ConvTuning tuning = {static_cast<ConvAlgorithm>(packed & 0xff),
+                       packed >> 8};
+  return tuning;
+}
+
+/**
+ * Per layer choice of the CPUConvOp algorithm and tile.
+ *
+ * The table maps a layer key (convTuningKey) to the ConvTuning that ran
+ * fastest for the layer. A CPUConvOp looks its layer up once, on its first
+ * forward, and from then on runs the entry (the direct algorithm without
+ * one) with no search. In tuning mode a layer missing from the table is
+ * benchmarked by that first forward: every applicable algorithm and tile
+ * runs repeat times and the fastest one is added.
+ *
+ * The table is read from and written to a tuning cache file of one layer
+ * per line, "<key> <algorithm> <tile>" with the algorithm direct, rows or
+ * gemm; RVTensor_compiler --tuning emits the entries into the compiled
+ * and serialized models instead, for targets without files.
+ */
+class ConvTuner {
+ public:
+    /**
+     * the table used by all CPUConvOps
+     */
+    static ConvTuner& instance();
+
+    /**
+     * tuning mode: benchmark the layers missing from the table
+     */
+    void setTuning(bool tuning, int repeat = 5);
+    bool isTuning();
+    int repeat();
+
+    /**
+     * entry of a layer, false if there is none
+     */
+    bool find(const std::string& key, ConvTuning* tuning);
+    void insert(const std::string& key, ConvTuning tuning);
+    void clear();
+    std::map<std::string, ConvTuning> entries();
+
+    /**
+     * add the entries of a tuning cache file / write all entries to one,
+     * throws std::runtime_error
+     */
+    void load(const std::string& path);
+    void save(const std::string& path);
+
+    /**
+     * name of an algorithm in the cache file, nullptr for
+     * CONV_ALGO_DEFAULT
+     */
+    static const char* algorithmName(ConvAlgorithm algorithm);
+
+ private:
+    ConvTuner();
+    ConvTuner(const ConvTuner&);
+    ConvTuner& operator=(const ConvTuner&);
+
+    Mutex mutex_;
+    std::map<std::string, ConvTuning> table_;
+    bool tuning_;
+    int repeat_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_CONV_TUNER_HPP_
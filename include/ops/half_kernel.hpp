@@ -0,0 +1,86 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_HALF_KERNEL_HPP_
+#define INCLUDE_OPS_HALF_KERNEL_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "include/core/half.hpp"
+#include "include/ops/vector_kernel.hpp"
+
+namespace RVTensor {
+
+/**
+ * float16 storage kernels: data is stored and moved as float16 and widened
+ * to float32 in registers, every sum is accumulated in float32.
+ */
+
+static inline void floatToHalfKernel(const float* src, uint16_t* dst,
+                                     size_t n) {
+  for (size_t i = 0; i < n; i++)
+    dst[i] = floatToHalf(src[i]);
+}
+
+static inline void halfToFloatKernel(const uint16_t* src, float* dst,
+                                     size_t n) {
+  for (size_t i = 0; i < n; i++)
+    dst[i] = halfToFloat(src[i]);
+}
+
+/**
+ * store a float32 accumulator as float32 or float16
+ */
+static inline void storeFloat(float v, float* dst) {
+  *dst = v;
+}
+
+static inline void storeFloat(float v, uint16_t* dst) {
+  *dst = floatToHalf(v);
+}
+
+/// columns of B widened at once by gemmHalfKernel
+static const int kGemmHalfPanel = 32;
+
+/**
+ * C[m][n] = bias[m] + sum_k A[m][k] * B[k][n] with float16 A and B, float32
+ * accumulation and C of TO (float or float16); ld* are the row steps in
+ * elements and bias may be nullptr.
+ *
+ * B is widened one panel of kGemmHalfPanel columns at a time (K * 32
+ * floats) and every row of A is widened once per panel, so the conversion
+ * cost is 1 / kGemmHalfPanel of the multiply-adds.
+ */
+template<typename TO>
+static void gemmHalfKernel(int M, int N, int K,
+                           const uint16_t* A, size_t lda,
+                           const uint16_t* B, size_t ldb,
+                           TO* C, size_t ldc, const float* bias) {
+  std::vector<float> panel(static_cast<size_t>(K) * kGemmHalfPanel);
+  std::vector<float> a_row(K);
+  for (int n0 = 0; n0 < N; n0 += kGemmHalfPanel) {
+    const int nb = N - n0 < kGemmHalfPanel ? N - n0 : kGemmHalfPanel;
+    for (int k = 0; k < K; k++)
+      halfToFloatKernel(B + k * ldb + n0, &panel[k * kGemmHalfPanel], nb);
+    for (int m = 0; m < M; m++) {
+      halfToFloatKernel(A + m * lda, a_row.data(), K);
+      float acc[kGemmHalfPanel];
+      const float b = bias ? bias[m] : 0.f;
+      for (int j = 0; j < nb; j++)
+        acc[j] = b;
+      for (int k = 0; k < K; k++)
+        axpyKernel(a_row[k], &panel[k * kGemmHalfPanel], acc, nb);
+      for (int j = 0; j < nb; j++)
+        storeFloat(acc[j], C + m * ldc + n0 + j);
+    }
+  }
+}
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_HALF_KERNEL_HPP_
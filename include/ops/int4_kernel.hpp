@@ -0,0 +1,77 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_INT4_KERNEL_HPP_
+#define INCLUDE_OPS_INT4_KERNEL_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include "include/core/int4.hpp"
+#include "include/ops/vector_kernel.hpp"
+
+namespace RVTensor {
+
+/**
+ * INT4 weight kernels: the weights stay packed in flash and are unpacked
+ * while they are used, every sum is accumulated in int32.
+ */
+
+static inline void unpackInt4Kernel(const uint8_t* src, int8_t* dst,
+                                    size_t num) {
+  for (size_t i = 0; i + 1 < num; i += 2) {
+    dst[i] = static_cast<int8_t>(int4Low(src[i / 2]));
+    dst[i + 1] = static_cast<int8_t>(int4High(src[i / 2]));
+  }
+  if (num % 2)
+    dst[num - 1] = static_cast<int8_t>(int4Low(src[num / 2]));
+}
+
+/// columns of B a gemmInt4Kernel call should cover at most
+static const int kGemmInt4Panel = 256;
+
+/**
+ * C[m][n] = base[m] + sum_k A[m][k] * (B[k][n] - b_offset) with packed INT4
+ * rows of A (lda bytes apart), uint8 B (ldb elements apart) and int32 C;
+ * base may be nullptr.
+ *
+ * The two elements of every byte of A are unpacked into registers and
+ * applied to two rows of B, so A is read from flash once per call at half
+ * the bytes of int8 weights. The b_offset term is folded into the base as
+ * b_offset * sum_k A[m][k].
+ */
+static inline void gemmInt4Kernel(int M, int N, int K,
+                                  const uint8_t* A, size_t lda,
+                                  const uint8_t* B, size_t ldb,
+                                  int32_t b_offset,
+                                  int32_t* C, size_t ldc,
+                                  const int32_t* base) {
+  for (int m = 0; m < M; m++) {
+    const uint8_t* a = A + m * lda;
+    int32_t* c = C + m * ldc;
+    int32_t a_sum = 0;
+    for (int k = 0; k + 1 < K; k += 2)
+      a_sum += int4Low(a[k / 2]) + int4High(a[k / 2]);
+    if (K % 2)
+      a_sum += int4Low(a[K / 2]);
+    const int32_t c0 = (base ? base[m] : 0) - b_offset * a_sum;
+    for (int j = 0; j < N; j++)
+      c[j] = c0;
+    int k = 0;
+    for (; k + 1 < K; k += 2) {
+      const int32_t w0 = int4Low(a[k / 2]);
+      const int32_t w1 = int4High(a[k / 2]);
+      const uint8_t* b0 = B + k * ldb;
+      macRow2Kernel(c, b0, w0, b0 + ldb, w1, N);
+    }
+    if (k < K)
+      macRowKernel(c, B + k * ldb, 1, int4Low(a[k / 2]), 0, N);
+  }
+}
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_INT4_KERNEL_HPP_
@@ -17,6 +17,27 @@
 
 namespace RVTensor {
 
+/**
+ * row layout of the KPU input RAM for a given width: channels are packed
+ * group per 64 byte row, wider images take row_length 64 byte rows
+ */
+static inline void kpuRowLayout(int width, int* padding, int* group,
+                                int* row_length) {
+  if (width <= 16) {
+    *padding = 16;
+    *group = 4;
+    *row_length = 1;
+  } else if (width <= 32) {
+    *padding = 32;
+    *group = 2;
+    *row_length = 1;
+  } else {
+    *padding = 64;
+    *group = 1;
+    *row_length = (width + 63) / 64;
+  }
+}
+
 class KPUConvOp: public Operation {
  public:
     using sptr = std::shared_ptr<KPUConvOp>;
@@ -49,6 +70,12 @@ class KPUConvOp: public Operation {
      */
     void forward_compute() override;
 
+    /**
+     * weights of the KPU layer that runs after this one: they are moved
+     * into the KPUWeightStage while this layer computes
+     */
+    void prefetchNext(FlashTensor::sptr weight);
+
  private:
     /// conv paramter
     ConvParam param_;
@@ -56,6 +83,8 @@ class KPUConvOp: public Operation {
     FlashTensor::sptr weight_;
     /// model data: bias
     FlashTensor::sptr bias_;
+    /// weights of the next KPU layer, nullptr for none
+    FlashTensor::sptr next_weight_;
     /// kpu active table
     kpu_activate_table_t kpu_act_table __attribute__((aligned(256)));
 };
@@ -13,5 +13,11 @@ extern void dma_transmit(handle_t file, const volatile void *src,
                          volatile void *dest, bool src_inc, bool dest_inc,
                          size_t element_size, size_t count, size_t burst_size);
 
+extern void dma_transmit_async(handle_t file, const volatile void *src,
+                               volatile void *dest, bool src_inc,
+                               bool dest_inc, size_t element_size,
+                               size_t count, size_t burst_size,
+                               SemaphoreHandle_t completion_event);
+
 extern void dma_close(handle_t file);
 
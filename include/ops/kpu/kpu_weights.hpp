@@ -0,0 +1,92 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_KPU_KPU_WEIGHTS_HPP_
+#define INCLUDE_OPS_KPU_KPU_WEIGHTS_HPP_
+
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/ops/kpu/kpu.h"
+
+namespace RVTensor {
+
+/**
+ * Double buffered staging of KPU layer coefficients.
+ *
+ * The KPU reads the coefficients of a layer from RAM, load_time chunks of
+ * at most 16 KB per pass over the layer. The stage keeps two RAM buffers:
+ * while the KPU computes a layer out of one buffer, the coefficients of
+ * the next layer are moved from flash into the other by DMA, so a layer
+ * starts on staged coefficients instead of waiting for a copy of them.
+ *
+ *   layer k:   acquire(w_k) -> KPU computes from buffer A
+ *                              DMA w_k+1 -> buffer B     (prefetch)
+ *   layer k+1: acquire(w_k+1) -> waits for the DMA if still running
+ *
+ * The KPU is a single device, the stage is used under the KPU lock.
+ */
+class KPUWeightStage {
+ public:
+    /**
+     * the stage of the KPU
+     */
+    static KPUWeightStage& instance();
+
+    /**
+     * Constructor & Deconstructor
+     */
+    KPUWeightStage();
+    ~KPUWeightStage();
+
+    /**
+     * start moving the coefficients of weight into the buffer the current
+     * layer does not use, nothing when they are staged already
+     */
+    void prefetch(FlashTensor::sptr weight);
+
+    /**
+     * coefficients of weight in RAM for the current layer: waits for their
+     * prefetch or moves them now; valid until the next acquire
+     */
+    const uint8_t* acquire(FlashTensor::sptr weight);
+
+ private:
+    KPUWeightStage(const KPUWeightStage&);
+    KPUWeightStage& operator=(const KPUWeightStage&);
+
+    struct Buffer {
+      RamTensor::sptr data;
+      /// staged weight, expired when none
+      std::weak_ptr<FlashTensor> weight;
+      /// given by the DMA when the move is done
+      SemaphoreHandle_t done;
+      bool pending;
+    };
+
+    /**
+     * move the coefficients of weight into buffer, asynchronously or not
+     */
+    void load(Buffer* buffer, FlashTensor::sptr weight, bool async);
+    /**
+     * wait for the DMA move into buffer
+     */
+    void wait(Buffer* buffer);
+    /**
+     * buffer staging (or holding) weight, nullptr for none
+     */
+    Buffer* find(const FlashTensor::sptr& weight);
+
+    Buffer buffers_[2];
+    /// buffer of the current layer
+    int current_;
+    /// DMA channel of the moves, opened by the first move
+    handle_t dma_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_KPU_KPU_WEIGHTS_HPP_
@@ -0,0 +1,56 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_LAYOUT_HPP_
+#define INCLUDE_OPS_LAYOUT_HPP_
+
+#include <vector>
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/operation.hpp"
+#include "include/core/types.hpp"
+
+namespace RVTensor {
+
+/**
+ * copy the input into the layout of the output (NCHW, NHWC or NCxHWx),
+ * both of the same shape and element size; the quantizer is kept
+ */
+class LayoutOp: public Operation {
+ public:
+    using sptr = std::shared_ptr<LayoutOp>;
+    static sptr create();
+    static sptr create(RamTensor::sptr input, RamTensor::sptr output);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    LayoutOp();
+    LayoutOp(RamTensor::sptr input, RamTensor::sptr output);
+    ~LayoutOp();
+
+    /**
+     * check output dims
+     */
+    void checkOutputDims() override;
+
+    /**
+     * inference
+     */
+    void forward_compute() override;
+
+ private:
+    /**
+     * element by element copy, every channel is a strided sequence of h * w
+     * elements block apart in both layouts
+     */
+    template<typename T> void convert();
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_LAYOUT_HPP_
@@ -0,0 +1,69 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_POOL_HPP_
+#define INCLUDE_OPS_POOL_HPP_
+
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/operation.hpp"
+#include "include/core/types.hpp"
+
+namespace RVTensor {
+
+/**
+ * Max or average pooling of a float32 or uint8 tensor into a tensor of
+ * the same layout and element size.
+ *
+ * The windows are placed like CPUConvOp kernels and only the taps inside
+ * the input count, so padding never enters a maximum or an average. uint8
+ * values are pooled as they are and requantized to the output quantizer;
+ * an output without a quantizer (scale 0) takes the input one.
+ */
+class PoolOp: public Operation {
+ public:
+    using sptr = std::shared_ptr<PoolOp>;
+    static sptr create();
+    static sptr create(PoolParam param, RamTensor::sptr input,
+                       RamTensor::sptr output);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    PoolOp();
+    PoolOp(PoolParam param, RamTensor::sptr input, RamTensor::sptr output);
+    ~PoolOp();
+
+    /**
+     * check output dims
+     */
+    void checkOutputDims() override;
+
+    /**
+     * inference
+     */
+    void forward_compute() override;
+
+    /**
+     * band execution, output rows read the input rows of their windows
+     */
+    bool supportsRows() override;
+    void inputRows(int h0, int h1, int* begin, int* end) override;
+    void forwardRows(int h0, int h1) override;
+
+ private:
+    /**
+     * output rows [h0, h1) of T elements
+     */
+    template<typename T> void pool(int h0, int h1);
+
+    PoolParam param_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_POOL_HPP_
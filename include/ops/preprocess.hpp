@@ -0,0 +1,67 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_PREPROCESS_HPP_
+#define INCLUDE_OPS_PREPROCESS_HPP_
+
+#include <vector>
+#include <memory>
+#include "include/core/tensor.hpp"
+#include "include/core/operation.hpp"
+#include "include/core/types.hpp"
+
+namespace RVTensor {
+
+/**
+ * PreprocessOp turns a camera frame into the model input in one pass:
+ * resize, channel reorder, normalization and quantization.
+ *
+ * The input is the camera buffer, either RGB565 (1 channel of 2 bytes) or
+ * planar RGB24 (3 channels of 1 byte); the output is the model input,
+ * quantized with its scale/zero point (1 byte) or normalized float
+ * (4 bytes). Normalization and quantization of a channel are one 256
+ * entry table lookup per pixel.
+ */
+class PreprocessOp: public Operation {
+ public:
+    using sptr = std::shared_ptr<PreprocessOp>;
+    static sptr create(PreprocessParam param, RamTensor::sptr input,
+                       RamTensor::sptr output);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    PreprocessOp(PreprocessParam param, RamTensor::sptr input,
+                 RamTensor::sptr output);
+    ~PreprocessOp();
+
+    /**
+     * check output dims
+     */
+    void checkOutputDims() override;
+
+    /**
+     * inference
+     */
+    void forward_compute() override;
+
+ private:
+    template<typename Reader, typename T>
+    void process(const Reader& reader, const T* lut);
+
+    /// source coordinate and 11 bit weight of every output column/row
+    void buildAxis(int src, int dst, std::vector<int>* index,
+                   std::vector<int>* weight);
+
+    PreprocessParam param_;
+    std::vector<int> x_index_, x_weight_;
+    std::vector<int> y_index_, y_weight_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_PREPROCESS_HPP_
@@ -43,6 +43,23 @@ class QuantizeOp: public Operation {
     void forward_compute() override;
 
  private:
+    /**
+     * TI (float32, or float16 as uint16_t) -> T, affine ([min(T), max(T)]
+     * with zero point) or symmetric ([-max(T), max(T)], zero point 0)
+     */
+    template<typename TI, typename T> void quantize(bool symmetric);
+
+    /**
+     * T -> TO (float32, or float16 as uint16_t) with the quantizer of the
+     * input tensor
+     */
+    template<typename T, typename TO> void dequantize();
+
+    /**
+     * float32 <-> float16, the quantizer is passed on
+     */
+    template<typename TI, typename TO> void cast();
+
     /// quantize paramter
     QuantizeParam param_;
 };
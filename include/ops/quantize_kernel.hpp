@@ -0,0 +1,139 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_QUANTIZE_KERNEL_HPP_
+#define INCLUDE_OPS_QUANTIZE_KERNEL_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include "include/ops/vector_kernel.hpp"
+
+namespace RVTensor {
+
+/**
+ * Streaming quantize kernels shared by QuantizeOp and the epilogue of the
+ * producer ops. All arithmetic is float32 with fused multiply-add, the
+ * loops are unrolled by 4 so the compiler can keep them in registers (or
+ * vectorize them) and the float -> integer conversion saturates instead of
+ * wrapping around. RVTENSOR_RVV and RVTENSOR_X86 builds run the uint8 and
+ * int8 kernels as vector strips (include/ops/vector_kernel.hpp).
+ */
+
+/**
+ * Quantized range of T. Symmetric quantization drops the most negative
+ * value so that the range is [-max, max] (e.g. [-127, 127] for int8).
+ */
+template<typename T>
+static inline float quantMin(bool symmetric) {
+  return symmetric ? -static_cast<float>(std::numeric_limits<T>::max())
+                   : static_cast<float>(std::numeric_limits<T>::min());
+}
+
+template<typename T>
+static inline float quantMax() {
+  return static_cast<float>(std::numeric_limits<T>::max());
+}
+
+/**
+ * Round v to nearest and clamp it into [lo, hi]
+ */
+template<typename T>
+static inline T saturateCast(float v, float lo, float hi) {
+  v = v < lo ? lo : (v > hi ? hi : v);
+  return static_cast<T>(std::lrint(v));
+}
+
+/**
+ * dst[i] = saturate(round(src[i] * inv_scale + zero))
+ */
+template<typename T>
+static inline void quantizeKernel(const float* src, T* dst, size_t n,
+                                  float inv_scale, float zero,
+                                  float lo = quantMin<T>(false),
+                                  float hi = quantMax<T>()) {
+  size_t i = quantizeVector(src, dst, n, inv_scale, zero, lo, hi);
+  for (; i + 4 <= n; i += 4) {
+    float v0 = std::fma(src[i],     inv_scale, zero);
+    float v1 = std::fma(src[i + 1], inv_scale, zero);
+    float v2 = std::fma(src[i + 2], inv_scale, zero);
+    float v3 = std::fma(src[i + 3], inv_scale, zero);
+    dst[i]     = saturateCast<T>(v0, lo, hi);
+    dst[i + 1] = saturateCast<T>(v1, lo, hi);
+    dst[i + 2] = saturateCast<T>(v2, lo, hi);
+    dst[i + 3] = saturateCast<T>(v3, lo, hi);
+  }
+  for (; i < n; i++)
+    dst[i] = saturateCast<T>(std::fma(src[i], inv_scale, zero), lo, hi);
+}
+
+/**
+ * dst[i] = (src[i] - zero) * scale
+ */
+template<typename T>
+static inline void dequantizeKernel(const T* src, float* dst, size_t n,
+                                    float scale, float zero) {
+  const float offset = -zero * scale;
+  size_t i = dequantizeVector(src, dst, n, scale, zero);
+  for (; i + 4 <= n; i += 4) {
+    dst[i]     = std::fma(static_cast<float>(src[i]),     scale, offset);
+    dst[i + 1] = std::fma(static_cast<float>(src[i + 1]), scale, offset);
+    dst[i + 2] = std::fma(static_cast<float>(src[i + 2]), scale, offset);
+    dst[i + 3] = std::fma(static_cast<float>(src[i + 3]), scale, offset);
+  }
+  for (; i < n; i++)
+    dst[i] = std::fma(static_cast<float>(src[i]), scale, offset);
+}
+
+/**
+ * Requantize int32 accumulators of a producer op:
+ * dst[i] = saturate(round(acc[i] * multiplier + zero))
+ */
+template<typename T>
+static inline void requantizeKernel(const int32_t* acc, T* dst, size_t n,
+                                    float multiplier, float zero,
+                                    float lo = quantMin<T>(false),
+                                    float hi = quantMax<T>()) {
+  size_t i = requantizeVector(acc, dst, n, multiplier, zero, lo, hi);
+  for (; i + 4 <= n; i += 4) {
+    float v0 = std::fma(static_cast<float>(acc[i]),     multiplier, zero);
+    float v1 = std::fma(static_cast<float>(acc[i + 1]), multiplier, zero);
+    float v2 = std::fma(static_cast<float>(acc[i + 2]), multiplier, zero);
+    float v3 = std::fma(static_cast<float>(acc[i + 3]), multiplier, zero);
+    dst[i]     = saturateCast<T>(v0, lo, hi);
+    dst[i + 1] = saturateCast<T>(v1, lo, hi);
+    dst[i + 2] = saturateCast<T>(v2, lo, hi);
+    dst[i + 3] = saturateCast<T>(v3, lo, hi);
+  }
+  for (; i < n; i++)
+    dst[i] = saturateCast<T>(
+               std::fma(static_cast<float>(acc[i]), multiplier, zero), lo, hi);
+}
+
+/**
+ * min and max of src in a single pass
+ */
+static inline void rangeKernel(const float* src, size_t n,
+                               float* min, float* max) {
+#if RVTENSOR_X86
+  if (x86Range(src, n, min, max))
+    return;
+#endif
+  float lo = *min;
+  float hi = *max;
+  for (size_t i = 0; i < n; i++) {
+    lo = src[i] < lo ? src[i] : lo;
+    hi = src[i] > hi ? src[i] : hi;
+  }
+  *min = lo;
+  *max = hi;
+}
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_QUANTIZE_KERNEL_HPP_
@@ -0,0 +1,107 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_TILED_HPP_
+#define INCLUDE_OPS_TILED_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "include/core/allocator.hpp"
+#include "include/core/tensor.hpp"
+#include "include/core/operation.hpp"
+
+namespace RVTensor {
+
+/**
+ * Chain of ops run band by band (layer fusion by row strips).
+ *
+ * Every op of the chain reads the output of the op before it and supports
+ * band execution (Operation::supportsRows). The output of the chain is
+ * computed in bands of rows output rows. For every band the rows each
+ * intermediate tensor must hold are worked out backwards from the output
+ * band through Operation::inputRows, then the ops compute just those rows
+ * front to back, so a band of every intermediate is written and read
+ * while it is still in cache. Bands of an intermediate overlap by the
+ * halo of the windows that read it (kernel rows minus stride): the halo
+ * rows of a band are moved to the start of the band buffer and only the
+ * rows after them are computed for the next band.
+ *
+ * The intermediates only hold the rows of one band: their data is bound
+ * to slices of one scratch buffer with planes of the largest band instead
+ * of the whole map, and data_ptr is moved for every band so that the band
+ * rows keep their row numbers of the whole map. The input and output of
+ * the chain are whole tensors. No op outside of the chain may read the
+ * intermediates, after a forward they hold the last band only.
+ */
+class TiledOp: public Operation {
+ public:
+    using sptr = std::shared_ptr<TiledOp>;
+    static sptr create();
+    /**
+     * binds the intermediates of chain to the scratch buffer
+     */
+    static sptr create(std::vector<Operation::sptr> chain, int rows);
+
+    /**
+     * Constructor & Deconstructor
+     */
+    TiledOp();
+    TiledOp(std::vector<Operation::sptr> chain, int rows);
+    ~TiledOp();
+
+    /**
+     * check the chain
+     */
+    void checkOutputDims() override;
+
+    /**
+     * inference
+     */
+    void forward_compute() override;
+
+    /**
+     * bytes of the scratch buffer that holds the intermediates
+     */
+    size_t scratchSize() const;
+
+ private:
+    /**
+     * rows [(*begin)[t], (*end)[t]) of every tensor t of the chain that
+     * output rows [h0, h1) depend on
+     */
+    void bandRows(int h0, int h1, std::vector<int>* begin,
+                  std::vector<int>* end);
+
+    /**
+     * size the planes of the intermediates to the largest band and bind
+     * them to the scratch buffer
+     */
+    void bindScratch();
+
+    /**
+     * start the slice of intermediate t at row begin, keeping the rows
+     * from begin of the held rows [held_begin, held_end)
+     */
+    void moveBand(size_t t, int begin, int held_begin, int held_end);
+
+    std::vector<Operation::sptr> chain_;
+    /// output rows per band
+    int rows_;
+    /// input, intermediates and output of the chain
+    std::vector<RamTensor::sptr> tensors_;
+    /// byte offset of every intermediate in the scratch buffer
+    std::vector<size_t> offsets_;
+    /// scratch buffer from the default allocator
+    Allocator::sptr allocator_;
+    uint8_t* scratch_;
+    size_t scratch_size_;
+};
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_TILED_HPP_
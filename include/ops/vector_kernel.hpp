@@ -0,0 +1,395 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_VECTOR_KERNEL_HPP_
+#define INCLUDE_OPS_VECTOR_KERNEL_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#if RVTENSOR_RVV
+#include <riscv_vector.h>
+#endif
+#include "include/ops/x86_kernel.hpp"
+
+namespace RVTensor {
+
+/**
+ * Inner loops of the conv, GEMM, quantize and activation kernels.
+ *
+ * Builds with RVTENSOR_RVV (environments/riscv64-linux.toolchain.cmake)
+ * run them as RISC-V vector intrinsics: vector length agnostic strips of
+ * vsetvl elements, uint8/int8 data widened to int16 and multiplied into
+ * int32 lanes, float32 math fused like the std::fma of the scalar loops.
+ * x86 builds (RVTENSOR_X86) pick SSE4.1 or AVX2 strips at runtime
+ * (include/ops/x86_kernel.hpp). Other builds run the scalar loops.
+ * Integer results are equal in all builds; RVV float sums may differ in
+ * the last bit, as the scalar loops are only fused where the compiler
+ * contracts them.
+ */
+
+#if RVTENSOR_RVV
+/**
+ * strip of vl uint8 or int8 elements, stride elements apart, as int16
+ */
+static inline vint16m2_t rvvLoadWiden(const uint8_t* p, ptrdiff_t stride,
+                                      size_t vl) {
+  vuint8m1_t v = stride == 1 ? __riscv_vle8_v_u8m1(p, vl)
+                 : __riscv_vlse8_v_u8m1(p, stride, vl);
+  return __riscv_vreinterpret_v_u16m2_i16m2(__riscv_vzext_vf2_u16m2(v, vl));
+}
+
+static inline vint16m2_t rvvLoadWiden(const int8_t* p, ptrdiff_t stride,
+                                      size_t vl) {
+  vint8m1_t v = stride == 1 ? __riscv_vle8_v_i8m1(p, vl)
+                : __riscv_vlse8_v_i8m1(p, stride, vl);
+  return __riscv_vsext_vf2_i16m2(v, vl);
+}
+
+/**
+ * clamp into [lo, hi] and round to nearest even (the default frm, as
+ * std::lrint), then narrow to uint8 or int8
+ */
+static inline vint32m4_t rvvSaturate(vfloat32m4_t v, float lo, float hi,
+                                     size_t vl) {
+  v = __riscv_vfmin_vf_f32m4(__riscv_vfmax_vf_f32m4(v, lo, vl), hi, vl);
+  return __riscv_vfcvt_x_f_v_i32m4(v, vl);
+}
+
+static inline void rvvStore(uint8_t* dst, vint32m4_t v, size_t vl) {
+  vuint16m2_t h = __riscv_vreinterpret_v_i16m2_u16m2(
+                    __riscv_vncvt_x_x_w_i16m2(v, vl));
+  __riscv_vse8_v_u8m1(dst, __riscv_vncvt_x_x_w_u8m1(h, vl), vl);
+}
+
+static inline void rvvStore(int8_t* dst, vint32m4_t v, size_t vl) {
+  __riscv_vse8_v_i8m1(dst, __riscv_vncvt_x_x_w_i8m1(
+                             __riscv_vncvt_x_x_w_i16m2(v, vl), vl), vl);
+}
+
+static inline vfloat32m4_t rvvLoadFloat(const uint8_t* src, size_t vl) {
+  return __riscv_vfcvt_f_xu_v_f32m4(
+           __riscv_vzext_vf4_u32m4(__riscv_vle8_v_u8m1(src, vl), vl), vl);
+}
+
+static inline vfloat32m4_t rvvLoadFloat(const int8_t* src, size_t vl) {
+  return __riscv_vfcvt_f_x_v_f32m4(
+           __riscv_vsext_vf4_i32m4(__riscv_vle8_v_i8m1(src, vl), vl), vl);
+}
+#endif  // RVTENSOR_RVV
+
+/**
+ * sum_j (x[j * stride] - x_offset) * (w[j * stride] - w_offset) for
+ * j < num, uint8 x and uint8 or int8 w; the offsets are 8 bit values
+ */
+template<typename WT>
+static inline int32_t dotKernel(const uint8_t* x, const WT* w, int num,
+                                int stride, int32_t x_offset,
+                                int32_t w_offset) {
+#if RVTENSOR_RVV
+  const size_t vlmax = __riscv_vsetvlmax_e32m4();
+  vint32m4_t acc = __riscv_vmv_v_x_i32m4(0, vlmax);
+  for (int j = 0; j < num;) {
+    const size_t vl = __riscv_vsetvl_e16m2(num - j);
+    vint16m2_t xv = __riscv_vsub_vx_i16m2(
+        rvvLoadWiden(x + j * stride, stride, vl),
+        static_cast<int16_t>(x_offset), vl);
+    vint16m2_t wv = __riscv_vsub_vx_i16m2(
+        rvvLoadWiden(w + j * stride, stride, vl),
+        static_cast<int16_t>(w_offset), vl);
+    // tail undisturbed: lanes past a short last strip keep their sums
+    acc = __riscv_vwmacc_vv_i32m4_tu(acc, xv, wv, vl);
+    j += static_cast<int>(vl);
+  }
+  return __riscv_vmv_x_s_i32m1_i32(__riscv_vredsum_vs_i32m4_i32m1(
+           acc, __riscv_vmv_s_x_i32m1(0, 1), vlmax));
+#else
+  int32_t acc = 0;
+#if RVTENSOR_X86
+  if (x86Dot(x, w, num, stride, x_offset, w_offset, &acc))
+    return acc;
+#endif
+  for (int j = 0; j < num; j++)
+    acc += (static_cast<int32_t>(x[j * stride]) - x_offset) *
+           (static_cast<int32_t>(w[j * stride]) - w_offset);
+  return acc;
+#endif
+}
+
+/**
+ * acc[j] += w * (x[j * stride] - x_offset) for j < num; w is an 8 bit
+ * weight, less its zero point for uint8 ones, x_offset an 8 bit value
+ */
+static inline void macRowKernel(int32_t* acc, const uint8_t* x, int stride,
+                                int32_t w, int32_t x_offset, int num) {
+  if (w == 0)
+    return;
+#if RVTENSOR_RVV
+  for (int j = 0; j < num;) {
+    const size_t vl = __riscv_vsetvl_e32m4(num - j);
+    vint16m2_t xv = __riscv_vsub_vx_i16m2(
+        rvvLoadWiden(x + j * stride, stride, vl),
+        static_cast<int16_t>(x_offset), vl);
+    vint32m4_t a = __riscv_vle32_v_i32m4(acc + j, vl);
+    a = __riscv_vwmacc_vx_i32m4(a, static_cast<int16_t>(w), xv, vl);
+    __riscv_vse32_v_i32m4(acc + j, a, vl);
+    j += static_cast<int>(vl);
+  }
+#else
+#if RVTENSOR_X86
+  if (x86MacRow(acc, x, stride, w, x_offset, num))
+    return;
+#endif
+  if (stride == 1) {
+    for (int j = 0; j < num; j++)
+      acc[j] += w * (static_cast<int32_t>(x[j]) - x_offset);
+  } else {
+    for (int j = 0; j < num; j++)
+      acc[j] += w * (static_cast<int32_t>(x[j * stride]) - x_offset);
+  }
+#endif
+}
+
+/**
+ * acc[j] += w0 * x0[j] + w1 * x1[j] for j < num, the GEMM micro-kernel of
+ * two rows of B; w0 and w1 are 8 bit weights, less their zero point for
+ * uint8 ones
+ */
+static inline void macRow2Kernel(int32_t* acc, const uint8_t* x0, int32_t w0,
+                                 const uint8_t* x1, int32_t w1, int num) {
+#if RVTENSOR_RVV
+  for (int j = 0; j < num;) {
+    const size_t vl = __riscv_vsetvl_e32m4(num - j);
+    vint32m4_t a = __riscv_vle32_v_i32m4(acc + j, vl);
+    a = __riscv_vwmacc_vx_i32m4(a, static_cast<int16_t>(w0),
+                                rvvLoadWiden(x0 + j, 1, vl), vl);
+    a = __riscv_vwmacc_vx_i32m4(a, static_cast<int16_t>(w1),
+                                rvvLoadWiden(x1 + j, 1, vl), vl);
+    __riscv_vse32_v_i32m4(acc + j, a, vl);
+    j += static_cast<int>(vl);
+  }
+#else
+#if RVTENSOR_X86
+  if (x86MacRow2(acc, x0, w0, x1, w1, num))
+    return;
+#endif
+  for (int j = 0; j < num; j++)
+    acc[j] += w0 * x0[j] + w1 * x1[j];
+#endif
+}
+
+/**
+ * y[j] += a * x[j] for j < num, the float32 GEMM micro-kernel
+ */
+static inline void axpyKernel(float a, const float* x, float* y, int num) {
+#if RVTENSOR_RVV
+  for (int j = 0; j < num;) {
+    const size_t vl = __riscv_vsetvl_e32m8(num - j);
+    vfloat32m8_t yv = __riscv_vle32_v_f32m8(y + j, vl);
+    yv = __riscv_vfmacc_vf_f32m8(yv, a, __riscv_vle32_v_f32m8(x + j, vl),
+                                 vl);
+    __riscv_vse32_v_f32m8(y + j, yv, vl);
+    j += static_cast<int>(vl);
+  }
+#else
+#if RVTENSOR_X86
+  if (x86Axpy(a, x, y, num))
+    return;
+#endif
+  for (int j = 0; j < num; j++)
+    y[j] += a * x[j];
+#endif
+}
+
+/**
+ * dst[i] = lut[src[i]], a 256 entry table of an 8 bit function
+ */
+static inline void lutKernel(const uint8_t* lut, const uint8_t* src,
+                             uint8_t* dst, size_t n) {
+#if RVTENSOR_RVV
+  for (size_t i = 0; i < n;) {
+    const size_t vl = __riscv_vsetvl_e8m8(n - i);
+    // byte indices are the offsets into the table
+    vuint8m8_t index = __riscv_vle8_v_u8m8(src + i, vl);
+    __riscv_vse8_v_u8m8(dst + i, __riscv_vluxei8_v_u8m8(lut, index, vl), vl);
+    i += vl;
+  }
+#else
+  for (size_t i = 0; i < n; i++)
+    dst[i] = lut[src[i]];
+#endif
+}
+
+/**
+ * dst[i] = min(max(src[i], lo), hi)
+ */
+static inline void clampKernel(const float* src, float* dst, size_t n,
+                               float lo, float hi) {
+#if RVTENSOR_RVV
+  for (size_t i = 0; i < n;) {
+    const size_t vl = __riscv_vsetvl_e32m8(n - i);
+    vfloat32m8_t v = __riscv_vle32_v_f32m8(src + i, vl);
+    v = __riscv_vfmin_vf_f32m8(__riscv_vfmax_vf_f32m8(v, lo, vl), hi, vl);
+    __riscv_vse32_v_f32m8(dst + i, v, vl);
+    i += vl;
+  }
+#else
+#if RVTENSOR_X86
+  if (x86Clamp(src, dst, n, lo, hi))
+    return;
+#endif
+  for (size_t i = 0; i < n; i++)
+    dst[i] = src[i] < lo ? lo : (src[i] > hi ? hi : src[i]);
+#endif
+}
+
+/**
+ * Vector strips of the quantize kernels (include/ops/quantize_kernel.hpp)
+ * for uint8 and int8: the number of leading elements done, the scalar
+ * loop runs the rest (all of them for T without strips).
+ */
+template<typename T>
+static inline size_t quantizeVector(const float*, T*, size_t, float, float,
+                                    float, float) {
+  return 0;
+}
+
+template<typename T>
+static inline size_t dequantizeVector(const T*, float*, size_t, float,
+                                      float) {
+  return 0;
+}
+
+template<typename T>
+static inline size_t requantizeVector(const int32_t*, T*, size_t, float,
+                                      float, float, float) {
+  return 0;
+}
+
+#if RVTENSOR_RVV
+template<typename T>
+static inline void rvvQuantize(const float* src, T* dst, size_t n,
+                               float inv_scale, float zero, float lo,
+                               float hi) {
+  for (size_t i = 0; i < n;) {
+    const size_t vl = __riscv_vsetvl_e32m4(n - i);
+    vfloat32m4_t v = __riscv_vfmacc_vf_f32m4(
+        __riscv_vfmv_v_f_f32m4(zero, vl), inv_scale,
+        __riscv_vle32_v_f32m4(src + i, vl), vl);
+    rvvStore(dst + i, rvvSaturate(v, lo, hi, vl), vl);
+    i += vl;
+  }
+}
+
+template<typename T>
+static inline void rvvDequantize(const T* src, float* dst, size_t n,
+                                 float scale, float zero) {
+  const float offset = -zero * scale;
+  for (size_t i = 0; i < n;) {
+    const size_t vl = __riscv_vsetvl_e32m4(n - i);
+    vfloat32m4_t v = __riscv_vfmacc_vf_f32m4(
+        __riscv_vfmv_v_f_f32m4(offset, vl), scale,
+        rvvLoadFloat(src + i, vl), vl);
+    __riscv_vse32_v_f32m4(dst + i, v, vl);
+    i += vl;
+  }
+}
+
+template<typename T>
+static inline void rvvRequantize(const int32_t* acc, T* dst, size_t n,
+                                 float multiplier, float zero, float lo,
+                                 float hi) {
+  for (size_t i = 0; i < n;) {
+    const size_t vl = __riscv_vsetvl_e32m4(n - i);
+    vfloat32m4_t v = __riscv_vfmacc_vf_f32m4(
+        __riscv_vfmv_v_f_f32m4(zero, vl), multiplier,
+        __riscv_vfcvt_f_x_v_f32m4(__riscv_vle32_v_i32m4(acc + i, vl), vl),
+        vl);
+    rvvStore(dst + i, rvvSaturate(v, lo, hi, vl), vl);
+    i += vl;
+  }
+}
+
+#endif  // RVTENSOR_RVV
+
+#if RVTENSOR_RVV || RVTENSOR_X86
+/**
+ * strips of the build for uint8 and int8; RVV strips cover all n elements,
+ * the x86 ones stop at the last whole strip
+ */
+template<typename T>
+static inline size_t quantizeStrips(const float* src, T* dst, size_t n,
+                                    float inv_scale, float zero, float lo,
+                                    float hi) {
+#if RVTENSOR_RVV
+  rvvQuantize(src, dst, n, inv_scale, zero, lo, hi);
+  return n;
+#else
+  return x86Quantize(src, dst, n, inv_scale, zero, lo, hi);
+#endif
+}
+
+template<typename T>
+static inline size_t dequantizeStrips(const T* src, float* dst, size_t n,
+                                      float scale, float zero) {
+#if RVTENSOR_RVV
+  rvvDequantize(src, dst, n, scale, zero);
+  return n;
+#else
+  return x86Dequantize(src, dst, n, scale, -zero * scale);
+#endif
+}
+
+template<typename T>
+static inline size_t requantizeStrips(const int32_t* acc, T* dst, size_t n,
+                                      float multiplier, float zero, float lo,
+                                      float hi) {
+#if RVTENSOR_RVV
+  rvvRequantize(acc, dst, n, multiplier, zero, lo, hi);
+  return n;
+#else
+  return x86Requantize(acc, dst, n, multiplier, zero, lo, hi);
+#endif
+}
+
+static inline size_t quantizeVector(const float* src, uint8_t* dst, size_t n,
+                                    float inv_scale, float zero, float lo,
+                                    float hi) {
+  return quantizeStrips(src, dst, n, inv_scale, zero, lo, hi);
+}
+
+static inline size_t quantizeVector(const float* src, int8_t* dst, size_t n,
+                                    float inv_scale, float zero, float lo,
+                                    float hi) {
+  return quantizeStrips(src, dst, n, inv_scale, zero, lo, hi);
+}
+
+static inline size_t dequantizeVector(const uint8_t* src, float* dst,
+                                      size_t n, float scale, float zero) {
+  return dequantizeStrips(src, dst, n, scale, zero);
+}
+
+static inline size_t dequantizeVector(const int8_t* src, float* dst,
+                                      size_t n, float scale, float zero) {
+  return dequantizeStrips(src, dst, n, scale, zero);
+}
+
+static inline size_t requantizeVector(const int32_t* acc, uint8_t* dst,
+                                      size_t n, float multiplier, float zero,
+                                      float lo, float hi) {
+  return requantizeStrips(acc, dst, n, multiplier, zero, lo, hi);
+}
+
+static inline size_t requantizeVector(const int32_t* acc, int8_t* dst,
+                                      size_t n, float multiplier, float zero,
+                                      float lo, float hi) {
+  return requantizeStrips(acc, dst, n, multiplier, zero, lo, hi);
+}
+#endif  // RVTENSOR_RVV || RVTENSOR_X86
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_VECTOR_KERNEL_HPP_
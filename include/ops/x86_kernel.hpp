@@ -0,0 +1,549 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_OPS_X86_KERNEL_HPP_
+#define INCLUDE_OPS_X86_KERNEL_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#if RVTENSOR_X86
+#include <immintrin.h>
+#endif
+
+namespace RVTensor {
+
+/**
+ * SSE4.1 and AVX2 strips of the inner loops in
+ * include/ops/vector_kernel.hpp for x86 hosts (RVTENSOR_X86).
+ *
+ * The functions are compiled for their instruction set with target
+ * attributes and picked by the CPU features found at runtime, so one
+ * binary runs on any x86 CPU; RVTENSOR_X86_LEVEL=0|1 in the environment
+ * caps the level to scalar or SSE4.1. Every x86*() returns false when the
+ * CPU or the arguments (strided data, short rows) have no strip and the
+ * scalar loop has to run. Results are equal to the scalar loops: the
+ * quantize strips need AVX2 with FMA to fuse like std::fma, float sums
+ * are not fused like the scalar loops built without FMA.
+ */
+
+#if RVTENSOR_X86
+
+#define RVTENSOR_SSE41 __attribute__((target("sse4.1")))
+#define RVTENSOR_AVX2  __attribute__((target("avx2")))
+/// only the quantize strips, the compiler contracts a * b + c with FMA on
+#define RVTENSOR_AVX2_FMA __attribute__((target("avx2,fma")))
+
+enum X86Level {
+  X86_SCALAR = 0,
+  X86_SSE41  = 1,
+  X86_AVX2   = 2   // with FMA
+};
+
+static inline int detectX86Level() {
+  __builtin_cpu_init();
+  int level = X86_SCALAR;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    level = X86_AVX2;
+  else if (__builtin_cpu_supports("sse4.1"))
+    level = X86_SSE41;
+  const char* cap = getenv("RVTENSOR_X86_LEVEL");
+  if (cap && *cap && atoi(cap) < level)
+    level = atoi(cap);
+  return level;
+}
+
+static inline int x86Level() {
+  static const int level = detectX86Level();
+  return level;
+}
+
+/// rows shorter than this stay on the scalar loops
+static const int kX86MinStrip = 16;
+
+RVTENSOR_SSE41 static inline int32_t hsumSse41(__m128i v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+RVTENSOR_AVX2 static inline int32_t hsumAvx2(__m256i v) {
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s);
+}
+
+/**
+ * 8 (SSE4.1) or 16 (AVX2) uint8 or int8 elements as int16
+ */
+RVTENSOR_SSE41 static inline __m128i widenSse41(const uint8_t* p) {
+  return _mm_cvtepu8_epi16(_mm_loadl_epi64(
+           reinterpret_cast<const __m128i*>(p)));
+}
+
+RVTENSOR_SSE41 static inline __m128i widenSse41(const int8_t* p) {
+  return _mm_cvtepi8_epi16(_mm_loadl_epi64(
+           reinterpret_cast<const __m128i*>(p)));
+}
+
+RVTENSOR_AVX2 static inline __m256i widenAvx2(const uint8_t* p) {
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128(
+           reinterpret_cast<const __m128i*>(p)));
+}
+
+RVTENSOR_AVX2 static inline __m256i widenAvx2(const int8_t* p) {
+  return _mm256_cvtepi8_epi16(_mm_loadu_si128(
+           reinterpret_cast<const __m128i*>(p)));
+}
+
+/**
+ * dot products of contiguous rows, *j is the first element left for the
+ * scalar tail
+ */
+template<typename WT>
+RVTENSOR_SSE41 static inline int32_t dotSse41(const uint8_t* x, const WT* w,
+                                              int num, int32_t x_offset,
+                                              int32_t w_offset, int* j) {
+  const __m128i xo = _mm_set1_epi16(static_cast<int16_t>(x_offset));
+  const __m128i wo = _mm_set1_epi16(static_cast<int16_t>(w_offset));
+  __m128i acc = _mm_setzero_si128();
+  for (; *j + 8 <= num; *j += 8) {
+    // (x - xo) * (w - wo) fits int16 operands, madd sums pairs in int32
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(
+        _mm_sub_epi16(widenSse41(x + *j), xo),
+        _mm_sub_epi16(widenSse41(w + *j), wo)));
+  }
+  return hsumSse41(acc);
+}
+
+template<typename WT>
+RVTENSOR_AVX2 static inline int32_t dotAvx2(const uint8_t* x, const WT* w,
+                                            int num, int32_t x_offset,
+                                            int32_t w_offset, int* j) {
+  const __m256i xo = _mm256_set1_epi16(static_cast<int16_t>(x_offset));
+  const __m256i wo = _mm256_set1_epi16(static_cast<int16_t>(w_offset));
+  __m256i acc = _mm256_setzero_si256();
+  for (; *j + 16 <= num; *j += 16) {
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(
+        _mm256_sub_epi16(widenAvx2(x + *j), xo),
+        _mm256_sub_epi16(widenAvx2(w + *j), wo)));
+  }
+  return hsumAvx2(acc);
+}
+
+/**
+ * uint8 x int8 without offsets on maddubs: x is split into its nibbles so
+ * the int16 pair sums (at most 2 * 15 * 128) can not saturate, the high
+ * nibble sums are weighted by 16 in int32
+ */
+RVTENSOR_AVX2 static inline int32_t dotU8S8Avx2(const uint8_t* x,
+                                                const int8_t* w, int num,
+                                                int* j) {
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i low = _mm256_setzero_si256();
+  __m256i high = _mm256_setzero_si256();
+  for (; *j + 32 <= num; *j += 32) {
+    const __m256i xv = _mm256_loadu_si256(
+                         reinterpret_cast<const __m256i*>(x + *j));
+    const __m256i wv = _mm256_loadu_si256(
+                         reinterpret_cast<const __m256i*>(w + *j));
+    low = _mm256_add_epi32(low, _mm256_madd_epi16(
+        _mm256_maddubs_epi16(_mm256_and_si256(xv, nibble), wv), ones));
+    high = _mm256_add_epi32(high, _mm256_madd_epi16(
+        _mm256_maddubs_epi16(
+            _mm256_and_si256(_mm256_srli_epi16(xv, 4), nibble), wv), ones));
+  }
+  return hsumAvx2(low) + 16 * hsumAvx2(high);
+}
+
+template<typename WT>
+static inline bool x86Dot(const uint8_t* x, const WT* w, int num, int stride,
+                          int32_t x_offset, int32_t w_offset,
+                          int32_t* sum) {
+  if (stride != 1 || num < kX86MinStrip)
+    return false;
+  const int level = x86Level();
+  if (level == X86_SCALAR)
+    return false;
+  int j = 0;
+  int32_t acc;
+  if (level == X86_SSE41)
+    acc = dotSse41(x, w, num, x_offset, w_offset, &j);
+  else if (std::is_signed<WT>::value && x_offset == 0 && w_offset == 0)
+    acc = dotU8S8Avx2(x, reinterpret_cast<const int8_t*>(w), num, &j);
+  else
+    acc = dotAvx2(x, w, num, x_offset, w_offset, &j);
+  for (; j < num; j++)
+    acc += (static_cast<int32_t>(x[j]) - x_offset) *
+           (static_cast<int32_t>(w[j]) - w_offset);
+  *sum = acc;
+  return true;
+}
+
+RVTENSOR_SSE41 static inline void macRowSse41(int32_t* acc, const uint8_t* x,
+                                              int32_t w, int32_t x_offset,
+                                              int num, int* j) {
+  const __m128i wv = _mm_set1_epi32(w);
+  const __m128i xo = _mm_set1_epi32(x_offset);
+  for (; *j + 4 <= num; *j += 4) {
+    __m128i* a = reinterpret_cast<__m128i*>(acc + *j);
+    int32_t bytes;
+    memcpy(&bytes, x + *j, sizeof(bytes));
+    const __m128i xv = _mm_sub_epi32(
+        _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)), xo);
+    _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a),
+                                      _mm_mullo_epi32(xv, wv)));
+  }
+}
+
+RVTENSOR_AVX2 static inline void macRowAvx2(int32_t* acc, const uint8_t* x,
+                                            int32_t w, int32_t x_offset,
+                                            int num, int* j) {
+  const __m256i wv = _mm256_set1_epi32(w);
+  const __m256i xo = _mm256_set1_epi32(x_offset);
+  for (; *j + 8 <= num; *j += 8) {
+    __m256i* a = reinterpret_cast<__m256i*>(acc + *j);
+    const __m256i xv = _mm256_sub_epi32(_mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + *j))), xo);
+    _mm256_storeu_si256(a, _mm256_add_epi32(_mm256_loadu_si256(a),
+                                            _mm256_mullo_epi32(xv, wv)));
+  }
+}
+
+static inline bool x86MacRow(int32_t* acc, const uint8_t* x, int stride,
+                             int32_t w, int32_t x_offset, int num) {
+  if (stride != 1 || num < kX86MinStrip)
+    return false;
+  const int level = x86Level();
+  if (level == X86_SCALAR)
+    return false;
+  int j = 0;
+  if (level == X86_SSE41)
+    macRowSse41(acc, x, w, x_offset, num, &j);
+  else
+    macRowAvx2(acc, x, w, x_offset, num, &j);
+  for (; j < num; j++)
+    acc[j] += w * (static_cast<int32_t>(x[j]) - x_offset);
+  return true;
+}
+
+/**
+ * acc += w0 * x0 + w1 * x1: x0 and x1 are interleaved into int16 pairs
+ * and madd with the (w0, w1) pair
+ */
+RVTENSOR_SSE41 static inline void macRow2Sse41(int32_t* acc,
+                                               const uint8_t* x0, int32_t w0,
+                                               const uint8_t* x1, int32_t w1,
+                                               int num, int* j) {
+  const __m128i wv = _mm_set1_epi32(static_cast<int32_t>(
+      (static_cast<uint32_t>(w1) << 16) | (w0 & 0xffff)));
+  for (; *j + 8 <= num; *j += 8) {
+    const __m128i a0 = widenSse41(x0 + *j);
+    const __m128i a1 = widenSse41(x1 + *j);
+    __m128i* lo = reinterpret_cast<__m128i*>(acc + *j);
+    __m128i* hi = reinterpret_cast<__m128i*>(acc + *j + 4);
+    _mm_storeu_si128(lo, _mm_add_epi32(_mm_loadu_si128(lo),
+        _mm_madd_epi16(_mm_unpacklo_epi16(a0, a1), wv)));
+    _mm_storeu_si128(hi, _mm_add_epi32(_mm_loadu_si128(hi),
+        _mm_madd_epi16(_mm_unpackhi_epi16(a0, a1), wv)));
+  }
+}
+
+RVTENSOR_AVX2 static inline void macRow2Avx2(int32_t* acc, const uint8_t* x0,
+                                             int32_t w0, const uint8_t* x1,
+                                             int32_t w1, int num, int* j) {
+  const __m256i wv = _mm256_set1_epi32(static_cast<int32_t>(
+      (static_cast<uint32_t>(w1) << 16) | (w0 & 0xffff)));
+  for (; *j + 16 <= num; *j += 16) {
+    const __m256i a0 = widenAvx2(x0 + *j);
+    const __m256i a1 = widenAvx2(x1 + *j);
+    // unpack works in 128 bit lanes: lo holds columns 0-3 and 8-11, hi
+    // holds 4-7 and 12-15
+    const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(a0, a1), wv);
+    const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(a0, a1), wv);
+    __m256i* c0 = reinterpret_cast<__m256i*>(acc + *j);
+    __m256i* c1 = reinterpret_cast<__m256i*>(acc + *j + 8);
+    _mm256_storeu_si256(c0, _mm256_add_epi32(_mm256_loadu_si256(c0),
+        _mm256_permute2x128_si256(lo, hi, 0x20)));
+    _mm256_storeu_si256(c1, _mm256_add_epi32(_mm256_loadu_si256(c1),
+        _mm256_permute2x128_si256(lo, hi, 0x31)));
+  }
+}
+
+static inline bool x86MacRow2(int32_t* acc, const uint8_t* x0, int32_t w0,
+                              const uint8_t* x1, int32_t w1, int num) {
+  if (num < kX86MinStrip)
+    return false;
+  const int level = x86Level();
+  if (level == X86_SCALAR)
+    return false;
+  int j = 0;
+  if (level == X86_SSE41)
+    macRow2Sse41(acc, x0, w0, x1, w1, num, &j);
+  else
+    macRow2Avx2(acc, x0, w0, x1, w1, num, &j);
+  for (; j < num; j++)
+    acc[j] += w0 * x0[j] + w1 * x1[j];
+  return true;
+}
+
+RVTENSOR_SSE41 static inline void axpySse41(float a, const float* x, float* y,
+                                            int num, int* j) {
+  const __m128 av = _mm_set1_ps(a);
+  for (; *j + 4 <= num; *j += 4) {
+    _mm_storeu_ps(y + *j, _mm_add_ps(_mm_loadu_ps(y + *j),
+                                     _mm_mul_ps(av, _mm_loadu_ps(x + *j))));
+  }
+}
+
+RVTENSOR_AVX2 static inline void axpyAvx2(float a, const float* x, float* y,
+                                          int num, int* j) {
+  const __m256 av = _mm256_set1_ps(a);
+  for (; *j + 8 <= num; *j += 8) {
+    _mm256_storeu_ps(y + *j, _mm256_add_ps(_mm256_loadu_ps(y + *j),
+        _mm256_mul_ps(av, _mm256_loadu_ps(x + *j))));
+  }
+}
+
+static inline bool x86Axpy(float a, const float* x, float* y, int num) {
+  if (num < kX86MinStrip)
+    return false;
+  const int level = x86Level();
+  if (level == X86_SCALAR)
+    return false;
+  int j = 0;
+  if (level == X86_SSE41)
+    axpySse41(a, x, y, num, &j);
+  else
+    axpyAvx2(a, x, y, num, &j);
+  for (; j < num; j++)
+    y[j] += a * x[j];
+  return true;
+}
+
+/**
+ * max_ps(a, b) is a > b ? a : b and min_ps(a, b) a < b ? a : b, the
+ * operand order keeps the NaN and signed zero results of the scalar loops
+ */
+RVTENSOR_SSE41 static inline void clampSse41(const float* src, float* dst,
+                                             size_t n, float lo, float hi,
+                                             size_t* i) {
+  const __m128 lov = _mm_set1_ps(lo);
+  const __m128 hiv = _mm_set1_ps(hi);
+  for (; *i + 4 <= n; *i += 4) {
+    _mm_storeu_ps(dst + *i, _mm_min_ps(hiv, _mm_max_ps(lov,
+                                       _mm_loadu_ps(src + *i))));
+  }
+}
+
+RVTENSOR_AVX2 static inline void clampAvx2(const float* src, float* dst,
+                                           size_t n, float lo, float hi,
+                                           size_t* i) {
+  const __m256 lov = _mm256_set1_ps(lo);
+  const __m256 hiv = _mm256_set1_ps(hi);
+  for (; *i + 8 <= n; *i += 8) {
+    _mm256_storeu_ps(dst + *i, _mm256_min_ps(hiv, _mm256_max_ps(lov,
+                                             _mm256_loadu_ps(src + *i))));
+  }
+}
+
+static inline bool x86Clamp(const float* src, float* dst, size_t n, float lo,
+                            float hi) {
+  if (n < static_cast<size_t>(kX86MinStrip))
+    return false;
+  const int level = x86Level();
+  if (level == X86_SCALAR)
+    return false;
+  size_t i = 0;
+  if (level == X86_SSE41)
+    clampSse41(src, dst, n, lo, hi, &i);
+  else
+    clampAvx2(src, dst, n, lo, hi, &i);
+  for (; i < n; i++)
+    dst[i] = src[i] < lo ? lo : (src[i] > hi ? hi : src[i]);
+  return true;
+}
+
+RVTENSOR_SSE41 static inline void rangeSse41(const float* src, size_t n,
+                                             float* min, float* max,
+                                             size_t* i) {
+  __m128 lo = _mm_set1_ps(*min);
+  __m128 hi = _mm_set1_ps(*max);
+  for (; *i + 4 <= n; *i += 4) {
+    const __m128 v = _mm_loadu_ps(src + *i);
+    lo = _mm_min_ps(v, lo);
+    hi = _mm_max_ps(v, hi);
+  }
+  float l[4], h[4];
+  _mm_storeu_ps(l, lo);
+  _mm_storeu_ps(h, hi);
+  for (int k = 0; k < 4; k++) {
+    *min = l[k] < *min ? l[k] : *min;
+    *max = h[k] > *max ? h[k] : *max;
+  }
+}
+
+RVTENSOR_AVX2 static inline void rangeAvx2(const float* src, size_t n,
+                                           float* min, float* max,
+                                           size_t* i) {
+  __m256 lo = _mm256_set1_ps(*min);
+  __m256 hi = _mm256_set1_ps(*max);
+  for (; *i + 8 <= n; *i += 8) {
+    const __m256 v = _mm256_loadu_ps(src + *i);
+    lo = _mm256_min_ps(v, lo);
+    hi = _mm256_max_ps(v, hi);
+  }
+  float l[8], h[8];
+  _mm256_storeu_ps(l, lo);
+  _mm256_storeu_ps(h, hi);
+  for (int k = 0; k < 8; k++) {
+    *min = l[k] < *min ? l[k] : *min;
+    *max = h[k] > *max ? h[k] : *max;
+  }
+}
+
+static inline bool x86Range(const float* src, size_t n, float* min,
+                            float* max) {
+  if (n < static_cast<size_t>(kX86MinStrip))
+    return false;
+  const int level = x86Level();
+  if (level == X86_SCALAR)
+    return false;
+  size_t i = 0;
+  if (level == X86_SSE41)
+    rangeSse41(src, n, min, max, &i);
+  else
+    rangeAvx2(src, n, min, max, &i);
+  for (; i < n; i++) {
+    *min = src[i] < *min ? src[i] : *min;
+    *max = src[i] > *max ? src[i] : *max;
+  }
+  return true;
+}
+
+/**
+ * saturate 8 floats into [lo, hi], round to nearest even (the MXCSR
+ * default, as std::lrint) and store them as uint8 or int8
+ */
+RVTENSOR_AVX2 static inline void storeAvx2(uint8_t* dst, __m256 v, __m256 lo,
+                                           __m256 hi) {
+  const __m256i q = _mm256_cvtps_epi32(_mm256_min_ps(hi, _mm256_max_ps(lo,
+                                                                       v)));
+  const __m128i h = _mm_packs_epi32(_mm256_castsi256_si128(q),
+                                    _mm256_extracti128_si256(q, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(h, h));
+}
+
+RVTENSOR_AVX2 static inline void storeAvx2(int8_t* dst, __m256 v, __m256 lo,
+                                           __m256 hi) {
+  const __m256i q = _mm256_cvtps_epi32(_mm256_min_ps(hi, _mm256_max_ps(lo,
+                                                                       v)));
+  const __m128i h = _mm_packs_epi32(_mm256_castsi256_si128(q),
+                                    _mm256_extracti128_si256(q, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packs_epi16(h, h));
+}
+
+RVTENSOR_AVX2 static inline __m256 loadFloatAvx2(const uint8_t* src) {
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+           _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))));
+}
+
+RVTENSOR_AVX2 static inline __m256 loadFloatAvx2(const int8_t* src) {
+  return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+           _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))));
+}
+
+/**
+ * quantize strips of 8 elements, *i is the first element left for the
+ * scalar tail
+ */
+template<typename T>
+RVTENSOR_AVX2_FMA static inline void quantizeAvx2(const float* src, T* dst,
+                                                  size_t n, float inv_scale,
+                                                  float zero, float lo,
+                                                  float hi, size_t* i) {
+  const __m256 sv = _mm256_set1_ps(inv_scale);
+  const __m256 zv = _mm256_set1_ps(zero);
+  const __m256 lov = _mm256_set1_ps(lo);
+  const __m256 hiv = _mm256_set1_ps(hi);
+  for (; *i + 8 <= n; *i += 8) {
+    storeAvx2(dst + *i, _mm256_fmadd_ps(_mm256_loadu_ps(src + *i), sv, zv),
+              lov, hiv);
+  }
+}
+
+template<typename T>
+RVTENSOR_AVX2_FMA static inline void dequantizeAvx2(const T* src, float* dst,
+                                                    size_t n, float scale,
+                                                    float offset, size_t* i) {
+  const __m256 sv = _mm256_set1_ps(scale);
+  const __m256 ov = _mm256_set1_ps(offset);
+  for (; *i + 8 <= n; *i += 8) {
+    _mm256_storeu_ps(dst + *i, _mm256_fmadd_ps(loadFloatAvx2(src + *i), sv,
+                                               ov));
+  }
+}
+
+template<typename T>
+RVTENSOR_AVX2_FMA static inline void requantizeAvx2(const int32_t* acc, T* dst,
+                                                    size_t n, float multiplier,
+                                                    float zero, float lo,
+                                                    float hi, size_t* i) {
+  const __m256 mv = _mm256_set1_ps(multiplier);
+  const __m256 zv = _mm256_set1_ps(zero);
+  const __m256 lov = _mm256_set1_ps(lo);
+  const __m256 hiv = _mm256_set1_ps(hi);
+  for (; *i + 8 <= n; *i += 8) {
+    const __m256 v = _mm256_cvtepi32_ps(_mm256_loadu_si256(
+                       reinterpret_cast<const __m256i*>(acc + *i)));
+    storeAvx2(dst + *i, _mm256_fmadd_ps(v, mv, zv), lov, hiv);
+  }
+}
+
+/**
+ * first element of the scalar tail after the AVX2 strips, 0 when the CPU
+ * or n leave everything to the scalar loop
+ */
+template<typename T>
+static inline size_t x86Quantize(const float* src, T* dst, size_t n,
+                                 float inv_scale, float zero, float lo,
+                                 float hi) {
+  size_t i = 0;
+  if (n >= static_cast<size_t>(kX86MinStrip) && x86Level() == X86_AVX2)
+    quantizeAvx2(src, dst, n, inv_scale, zero, lo, hi, &i);
+  return i;
+}
+
+template<typename T>
+static inline size_t x86Dequantize(const T* src, float* dst, size_t n,
+                                   float scale, float offset) {
+  size_t i = 0;
+  if (n >= static_cast<size_t>(kX86MinStrip) && x86Level() == X86_AVX2)
+    dequantizeAvx2(src, dst, n, scale, offset, &i);
+  return i;
+}
+
+template<typename T>
+static inline size_t x86Requantize(const int32_t* acc, T* dst, size_t n,
+                                   float multiplier, float zero, float lo,
+                                   float hi) {
+  size_t i = 0;
+  if (n >= static_cast<size_t>(kX86MinStrip) && x86Level() == X86_AVX2)
+    requantizeAvx2(acc, dst, n, multiplier, zero, lo, hi, &i);
+  return i;
+}
+
+#endif  // RVTENSOR_X86
+
+}  // namespace RVTensor
+
+#endif  // INCLUDE_OPS_X86_KERNEL_HPP_
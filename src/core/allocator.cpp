@@ -0,0 +1,215 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cstdlib>
+#include <stdexcept>
+#include "include/core/allocator.hpp"
+
+namespace RVTensor {
+
+////////////////////// Allocator ////////////////////////////////
+Allocator::Allocator() {
+  stats_.live_bytes = 0;
+  stats_.peak_bytes = 0;
+  stats_.alloc_count = 0;
+}
+
+AllocatorStats Allocator::stats() {
+  LockGuard lock(&mutex_);
+  return stats_;
+}
+
+void Allocator::recordAllocate(size_t size) {
+  stats_.live_bytes += size;
+  stats_.alloc_count++;
+  if (stats_.live_bytes > stats_.peak_bytes)
+    stats_.peak_bytes = stats_.live_bytes;
+}
+
+void Allocator::recordDeallocate(size_t size) {
+  stats_.live_bytes -= size;
+}
+
+/**
+ * alignment of an allocate call, 0 when it is not a power of two
+ */
+static size_t checkAlignment(size_t alignment) {
+  if (alignment & (alignment - 1))
+    return 0;
+  return alignment < MALLOC_ALIGN ? MALLOC_ALIGN : alignment;
+}
+
+static Allocator::sptr& defaultAllocator() {
+  static Allocator::sptr allocator = MallocAllocator::create();
+  return allocator;
+}
+
+Allocator::sptr Allocator::getDefault() {
+  return defaultAllocator();
+}
+
+void Allocator::setDefault(Allocator::sptr allocator) {
+  if (!allocator)
+    throw std::runtime_error("Allocator default is empty!");
+  defaultAllocator() = allocator;
+}
+
+/////////////////// MallocAllocator /////////////////////////////
+/**
+ * header right before every buffer
+ */
+struct MallocHeader {
+  void* base;
+  size_t size;
+};
+
+MallocAllocator::sptr MallocAllocator::create() {
+  return std::make_shared<MallocAllocator>();
+}
+
+void* MallocAllocator::allocate(size_t size, size_t alignment) {
+  alignment = checkAlignment(alignment);
+  if (alignment == 0)
+    return nullptr;
+  uint8_t* udata = reinterpret_cast<uint8_t*>(malloc(size +
+                   sizeof(MallocHeader) + alignment));
+  if (!udata)
+    return nullptr;
+  uint8_t* adata = alignPtr(udata + sizeof(MallocHeader),
+                            static_cast<int>(alignment));
+  MallocHeader* header = reinterpret_cast<MallocHeader*>(adata) - 1;
+  header->base = udata;
+  header->size = size;
+
+  LockGuard lock(&mutex_);
+  recordAllocate(size);
+  return adata;
+}
+
+void MallocAllocator::deallocate(void* ptr) {
+  if (!ptr)
+    return;
+  MallocHeader* header = reinterpret_cast<MallocHeader*>(ptr) - 1;
+  {
+    LockGuard lock(&mutex_);
+    recordDeallocate(header->size);
+  }
+  free(header->base);
+}
+
+////////////////// PoolAllocator ////////////////////////////////
+/**
+ * header right before every buffer, MALLOC_ALIGN bytes so the buffers
+ * stay aligned; offset is the distance of the buffer from the start of
+ * its block data
+ */
+union PoolHeader {
+  struct {
+    uint16_t index;
+    uint16_t offset;
+    size_t size;
+  } block;
+  uint8_t pad[MALLOC_ALIGN];
+};
+
+/// smallest class
+static const int kPoolMinShift = 6;
+
+PoolAllocator::sptr PoolAllocator::create(void* region, size_t size) {
+  if (!region)
+    throw std::runtime_error("PoolAllocator region is empty!");
+  return std::make_shared<PoolAllocator>(region, size, false);
+}
+
+PoolAllocator::sptr PoolAllocator::create(size_t size) {
+  void* region = malloc(size + MALLOC_ALIGN);
+  if (!region)
+    throw std::runtime_error("PoolAllocator region is out of memory!");
+  return std::make_shared<PoolAllocator>(region, size + MALLOC_ALIGN, true);
+}
+
+PoolAllocator::PoolAllocator(void* region, size_t size, bool owned)
+  : region_(reinterpret_cast<uint8_t*>(region)), size_(size), used_(0),
+    owned_(owned) {
+  // carve from the first aligned byte
+  used_ = alignPtr(region_, MALLOC_ALIGN) - region_;
+  if (used_ > size_)
+    used_ = size_;
+  free_lists_.resize(classIndex(size_) + 1, nullptr);
+}
+
+PoolAllocator::~PoolAllocator() {
+  if (owned_)
+    free(region_);
+}
+
+int PoolAllocator::classIndex(size_t size) {
+  if (size <= (1u << kPoolMinShift))
+    return 0;
+  // size - 1 = 2^k * (1 + sub / 4 + ...), class size 2^k * (1 + (sub + 1) / 4)
+  const size_t v = size - 1;
+  int k = kPoolMinShift;
+  while ((v >> (k + 1)) != 0)
+    k++;
+  const int sub = static_cast<int>(v >> (k - 2)) - 4;
+  return 1 + (k - kPoolMinShift) * 4 + sub;
+}
+
+size_t PoolAllocator::classSize(int index) {
+  if (index == 0)
+    return 1u << kPoolMinShift;
+  const int k = kPoolMinShift + (index - 1) / 4;
+  const int sub = (index - 1) % 4;
+  return static_cast<size_t>(5 + sub) << (k - 2);
+}
+
+void* PoolAllocator::allocate(size_t size, size_t alignment) {
+  alignment = checkAlignment(alignment);
+  if (alignment == 0 || alignment > UINT16_MAX)
+    return nullptr;
+  // room to move the buffer to the next alignment boundary
+  const int index = classIndex(size + alignment - MALLOC_ALIGN);
+  LockGuard lock(&mutex_);
+  if (index >= static_cast<int>(free_lists_.size()))
+    return nullptr;
+
+  uint8_t* data;
+  if (free_lists_[index]) {
+    data = reinterpret_cast<uint8_t*>(free_lists_[index]);
+    free_lists_[index] = *reinterpret_cast<void**>(data);
+  } else {
+    const size_t block_size = sizeof(PoolHeader) + classSize(index);
+    if (block_size > size_ - used_)
+      return nullptr;
+    data = region_ + used_ + sizeof(PoolHeader);
+    used_ += block_size;
+  }
+  uint8_t* aligned = alignPtr(data, static_cast<int>(alignment));
+  PoolHeader* header = reinterpret_cast<PoolHeader*>(aligned) - 1;
+  header->block.index = static_cast<uint16_t>(index);
+  header->block.offset = static_cast<uint16_t>(aligned - data);
+  header->block.size = size;
+  recordAllocate(size);
+  return aligned;
+}
+
+void PoolAllocator::deallocate(void* ptr) {
+  if (!ptr)
+    return;
+  PoolHeader* header = reinterpret_cast<PoolHeader*>(ptr) - 1;
+  void* data = reinterpret_cast<uint8_t*>(ptr) - header->block.offset;
+  LockGuard lock(&mutex_);
+  recordDeallocate(header->block.size);
+  *reinterpret_cast<void**>(data) = free_lists_[header->block.index];
+  free_lists_[header->block.index] = data;
+}
+
+size_t PoolAllocator::used() const {
+  return used_;
+}
+
+}  // namespace RVTensor
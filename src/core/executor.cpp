@@ -5,14 +5,43 @@
  *
  */
 
+#include <cstring>
+#include <stdexcept>
 #include "include/core/executor.hpp"
 #include "include/core/tensor.hpp"
 #include "compiled/model_execute.hpp"
 
 namespace RVTensor {
 
-#define MODEL_EXECUTE(model_name, ...) \
-  model_name##_model_execute(__VA_ARGS__)
+/// models compiled into the library (compiled/model_execute.hpp)
+static const struct CompiledModel {
+  const char* name;
+  RamTensor::sptr (*execute)(RamTensor::sptr input, RamTensor::sptr output);
+  /// n c h w element_size
+  int input[5];
+  int output[5];
+} kCompiledModels[] = {
+  {"yolov3", yolov3_model_execute, {1, 3, 240, 320, 1}, {1, 16, 240, 320, 1}},
+};
+
+static const CompiledModel* findCompiledModel(const std::string& name) {
+  for (auto& model : kCompiledModels) {
+    if (name.compare(model.name) == 0)
+      return &model;
+  }
+  return nullptr;
+}
+
+/**
+ * one computeAsync call; a request with a fence is signalled once all
+ * earlier ones are done, a nullptr request stops the task
+ */
+struct Executor::AsyncRequest {
+  RamTensor::sptr image;
+  callback_compute call;
+  void* userdata;
+  Queue* fence;
+};
 
 Executor::sptr Executor::create() {
   return std::make_shared<Executor>();
@@ -22,47 +51,282 @@ Executor::sptr Executor::create(std::string model_name, int thread_num) {
   return std::make_shared<Executor>(model_name, thread_num);
 }
 
-Executor::Executor() {}
+/// bilinear, RGB, no normalization
+static const PreprocessParam kDefaultPreprocess = {
+  RESIZE_BILINEAR, {0, 1, 2}, {0.f, 0.f, 0.f}, {1.f, 1.f, 1.f}
+};
+
+Executor::Executor() : input_buf_(nullptr), input_cstep_(0), tile_rows_(0),
+                       async_pending_(0), output_buf_(nullptr),
+                       output_buf_size_(0),
+                       preprocess_param_(kDefaultPreprocess) {}
 
 Executor::Executor(std::string model_name, int thread_num)
-                  : thread_num_(thread_num), model_name_(model_name),
-                  image_ptr(nullptr), output_ptr(nullptr) {}
+                  : thread_num_(thread_num), image_ptr(nullptr),
+                  input_buf_(nullptr), input_cstep_(0),
+                  output_ptr(nullptr), model_name_(model_name),
+                  model_(nullptr), tile_rows_(0), async_task_(nullptr),
+                  async_queue_(nullptr), async_pending_(0),
+                  output_buf_(nullptr), output_buf_size_(0),
+                  bound_output_(nullptr), preprocess_param_(kDefaultPreprocess),
+                  preprocess_op_(nullptr), frame_ptr_(nullptr),
+                  preprocessed_ptr_(nullptr) {}
 
 void Executor::loadImage(uint8_t* ai_buf, int channel, int height, int width) {
-  image_ptr = RamTensor::create(1, channel, height, width,
-                                reinterpret_cast<void*>(ai_buf), 1u);
+  bindInput(ai_buf, channel, height, width, 0);
+}
+
+void Executor::bindInput(uint8_t* data, int channel, int height, int width,
+                         size_t cstep) {
+  if (cstep == 0)
+    cstep = height * width;
+  if (data == nullptr || cstep < static_cast<size_t>(height * width))
+    throw std::runtime_error("Executor input layout is wrong!");
+  // planes with the cstep of the input tensor are read in place, other
+  // strides are copied into planes owned by image_ptr
+  const bool in_place = channel <= 1 || cstep == alignSize(
+      static_cast<size_t>(height) * width, inputAlignment());
+  // a tensor still queued by computeAsync keeps its data, use a new one
+  const bool reuse = image_ptr && image_ptr.use_count() == 1 &&
+      image_ptr->n_batch == 1 && image_ptr->channel == channel &&
+      image_ptr->height == height && image_ptr->width == width &&
+      image_ptr->element_size == 1 && (in_place || input_buf_);
+  if (!reuse) {
+    image_ptr = in_place ?
+        RamTensor::create(1, channel, height, width, nullptr, 1u,
+                          inputAlignment()) :
+        RamTensor::create(1, channel, height, width, 1u, inputAlignment());
+  }
+  if (in_place) {
+    image_ptr->bindData(data);
+    input_buf_ = nullptr;
+    return;
+  }
+  input_buf_ = data;
+  input_cstep_ = cstep;
+}
+
+void Executor::stageInput() {
+  if (!input_buf_)
+    return;
+  if (image_ptr.use_count() > 1)
+    image_ptr = RamTensor::create(1, image_ptr->channel, image_ptr->height,
+                                  image_ptr->width, 1u, image_ptr->alignment);
+  const size_t surface_size = image_ptr->height * image_ptr->width;
+  for (int c = 0; c < image_ptr->channel; c++) {
+    memcpy(reinterpret_cast<uint8_t*>(image_ptr->data_ptr) +
+           c * image_ptr->cstep, input_buf_ + c * input_cstep_, surface_size);
+  }
+}
+
+size_t Executor::inputAlignment() const {
+  return model_ ? model_->getInput()->alignment : MALLOC_ALIGN;
+}
+
+void Executor::setPreprocess(const PreprocessParam& param) {
+  preprocess_param_ = param;
+  preprocess_op_ = nullptr;
+}
+
+void Executor::loadFrame(const void* frame, FrameFormat format, int height,
+                         int width) {
+  const int channel = format == FRAME_RGB565 ? 1 : 3;
+  if (image_ptr == preprocessed_ptr_)
+    image_ptr = nullptr;
+  // a preprocessed input still queued by computeAsync keeps its data, use a
+  // new one (the other reference is the output of preprocess_op_)
+  if (!preprocess_op_ || preprocessed_ptr_.use_count() > 2 ||
+      frame_ptr_->channel != channel ||
+      frame_ptr_->height != height || frame_ptr_->width != width) {
+    frame_ptr_ = RamTensor::create(1, channel, height, width,
+                                   const_cast<void*>(frame),
+                                   format == FRAME_RGB565 ? 2u : 1u);
+    // the planes of a planar frame are dense, not aligned
+    frame_ptr_->cstep = height * width;
+    if (model_) {
+      RamTensor::sptr input = model_->getInput();
+      preprocessed_ptr_ = RamTensor::create(1, input->channel,
+          input->height, input->width, input->element_size,
+          input->alignment);
+      preprocessed_ptr_->setQuantizeParams(input->min_range,
+          input->max_range, input->scale, input->zero_point);
+    } else if (const CompiledModel* compiled =
+               findCompiledModel(model_name_)) {
+      preprocessed_ptr_ = RamTensor::create(1, compiled->input[1],
+          compiled->input[2], compiled->input[3], compiled->input[4]);
+    } else {
+      throw std::runtime_error("loadFrame model input is unknown!");
+    }
+    preprocess_op_ = PreprocessOp::create(preprocess_param_, frame_ptr_,
+                                          preprocessed_ptr_);
+  }
+  frame_ptr_->data_ptr = const_cast<void*>(frame);
+  preprocess_op_->run();
+  image_ptr = preprocessed_ptr_;
+  input_buf_ = nullptr;
+}
+
+void Executor::loadImages(uint8_t* const* ai_bufs, int batch, int channel,
+                          int height, int width) {
+  image_ptr = RamTensor::create(batch, channel, height, width, 1u,
+                                inputAlignment());
+  input_buf_ = nullptr;
+  for (int n = 0; n < batch; n++)
+    image_ptr->writeData(n, ai_bufs[n], channel * height * width);
 }
 
 // void Executor::loadImage(std::string image_path, int channel,
 //                                                  int height, int width) {
 // }
 
+void Executor::loadModel(const void* data, size_t size) {
+  model_ = Model::load(data, size, tile_rows_);
+  preprocess_op_ = nullptr;
+}
+
+void Executor::loadModel(std::string model_path) {
+  model_ = Model::loadFile(model_path, tile_rows_);
+  preprocess_op_ = nullptr;
+}
+
+void Executor::shareModel(Executor::sptr other) {
+  if (!other || !other->model_)
+    throw std::runtime_error("Executor has no model to share!");
+  model_ = other->model_->share();
+  tile_rows_ = model_->getTiling();
+  preprocess_op_ = nullptr;
+}
+
+void Executor::setTiling(int rows) {
+  LockGuard lock(&compute_mutex_);
+  if (rows < 0)
+    throw std::runtime_error("Executor tiling rows is wrong!");
+  tile_rows_ = rows;
+  if (model_)
+    model_->setTiling(rows);
+}
+
 int Executor::compute() {
-  if (model_name_.compare("yolov3") == 0) {
-    // fill image_ptr with test data
-    RamTensor::sptr test_ptr = RamTensor::create(1, 3, 240, 320, 1u);
-    uint8_t v = 1;
-    test_ptr->fill(v);
-    output_ptr = MODEL_EXECUTE(yolov3, test_ptr);
+  // computes run in submission order, finish the queued ones first
+  wait();
+  stageInput();
+  return compute(image_ptr);
+}
+
+int Executor::compute(RamTensor::sptr image) {
+  LockGuard lock(&compute_mutex_);
+  if (model_) {
+    if (!image)
+      return -1;
+    model_->setBatch(image->n_batch);
+    model_->bindInput(image);
+    if (output_buf_ && model_->getOutput()->data_ptr != output_buf_)
+      model_->bindOutput(output_buf_, output_buf_size_);
+    model_->compute();
+    output_ptr = model_->getOutput();
+  } else if (const CompiledModel* compiled =
+             findCompiledModel(model_name_)) {
+    // compiled models are generated for batch 1
+    if (!image || image->n_batch != 1 ||
+        image->channel != compiled->input[1] ||
+        image->height != compiled->input[2] ||
+        image->width != compiled->input[3])
+      return -1;
+    if (output_buf_ && !bound_output_) {
+      bound_output_ = RamTensor::create(1, compiled->output[1],
+          compiled->output[2], compiled->output[3], output_buf_,
+          compiled->output[4]);
+      if (output_buf_size_ < bound_output_->totalSize()) {
+        bound_output_ = nullptr;
+        throw std::runtime_error("Executor output buffer is too small!");
+      }
+    }
+    output_ptr = compiled->execute(image, bound_output_);
   } else {
     return -1;
   }
   return 0;
 }
 
+void Executor::computeAsync(callback_compute call, void* userdata) {
+  stageInput();
+  if (!async_task_) {
+    async_queue_ = Queue::create(ASYNC_QUEUE_DEPTH, sizeof(AsyncRequest*));
+    async_task_ = Task::create("rvtensor_async", asyncEntry, this, 3, 8192);
+  }
+  AsyncRequest* request = new AsyncRequest{image_ptr, call, userdata,
+                                           nullptr};
+  async_pending_++;
+  async_queue_->send(&request);
+}
+
+void Executor::wait() {
+  if (!async_task_)
+    return;
+  Queue fence(1, sizeof(int));
+  AsyncRequest* request = new AsyncRequest{nullptr, nullptr, nullptr,
+                                           &fence};
+  async_queue_->send(&request);
+  int done;
+  fence.receive(&done);
+}
+
+int Executor::poll() {
+  return async_pending_;
+}
+
+void Executor::asyncEntry(void* arg) {
+  Executor* executor = reinterpret_cast<Executor*>(arg);
+  while (true) {
+    AsyncRequest* request;
+    executor->async_queue_->receive(&request);
+    if (request == nullptr)
+      break;
+    if (request->fence) {
+      int done = 0;
+      request->fence->send(&done);
+      delete request;
+      continue;
+    }
+
+    int status;
+    try {
+      status = executor->compute(request->image);
+    } catch (const std::exception& e) {
+      status = -1;
+    }
+    if (request->call)
+      request->call(status, request->userdata);
+    executor->async_pending_--;
+    delete request;
+  }
+}
+
+void Executor::bindOutput(void* data_ptr, size_t size) {
+  LockGuard lock(&compute_mutex_);
+  output_buf_ = data_ptr;
+  output_buf_size_ = size;
+  bound_output_ = nullptr;
+  if (model_)
+    model_->bindOutput(data_ptr, size);
+}
+
 void Executor::copyOutputData(void* data_ptr, size_t size) {
   if (output_ptr->trueSize() != size) {
     throw std::runtime_error("copyOutputData data size is wrong!");
   }
-  size_t surface_size = size / output_ptr->channel;
-  for (int c = 0; c < output_ptr->channel; c++) {
-    void* src_ptr = reinterpret_cast<void*>(
-                    reinterpret_cast<uint8_t*>(output_ptr->data_ptr) +
-                    c * output_ptr->cstep * output_ptr->element_size);
-    void* dst_ptr = reinterpret_cast<void*>(
-                    reinterpret_cast<uint8_t*>(data_ptr) + c * surface_size);
-    memcpy(dst_ptr, src_ptr, surface_size);
+  output_ptr->readData(data_ptr, size);
+}
+
+void Executor::copyOutputData(int index, void* data_ptr, size_t size) {
+  if (output_ptr->trueSize() != size * output_ptr->n_batch) {
+    throw std::runtime_error("copyOutputData data size is wrong!");
   }
+  output_ptr->readData(index, data_ptr, size);
+}
+
+RamTensor::sptr Executor::getOutput() {
+  return output_ptr;
 }
 
 int Executor::inferenceResult(void* result_buf, uint64_t size,
@@ -70,6 +334,12 @@ int Executor::inferenceResult(void* result_buf, uint64_t size,
   return 0;
 }
 
-Executor::~Executor() {}
+Executor::~Executor() {
+  if (async_task_) {
+    AsyncRequest* request = nullptr;
+    async_queue_->send(&request);
+    async_task_->join();
+  }
+}
 
 }  // namespace RVTensor
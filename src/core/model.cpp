@@ -0,0 +1,533 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#if !RVTENSOR_KENDRYTE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "include/core/model.hpp"
+#include "include/core/types.hpp"
+#include "include/ops/activation.hpp"
+#include "include/ops/conv.hpp"
+#include "include/ops/conv_tuner.hpp"
+#include "include/ops/layout.hpp"
+#include "include/ops/pool.hpp"
+#include "include/ops/quantize.hpp"
+#include "include/ops/tiled.hpp"
+#if RVTENSOR_KENDRYTE
+#include "include/ops/kpu/kpu_conv.hpp"
+#endif
+
+namespace RVTensor {
+
+Model::sptr Model::load(const void* data, size_t size, int tile_rows) {
+  if (tile_rows < 0)
+    throw std::runtime_error("Model tiling rows is wrong!");
+  Model::sptr model = std::make_shared<Model>();
+  model->tile_rows_ = tile_rows;
+  // owned by the caller
+  model->storage_.reset(reinterpret_cast<const uint8_t*>(data),
+                        [](const uint8_t*) {});
+  model->storage_size_ = size;
+  model->parse(model->storage_.get(), size, nullptr);
+  return model;
+}
+
+Model::sptr Model::loadFile(const std::string& path, int tile_rows) {
+#if RVTENSOR_KENDRYTE
+  throw std::runtime_error("Model loadFile is not supported on kendryte!");
+#else
+  if (tile_rows < 0)
+    throw std::runtime_error("Model tiling rows is wrong!");
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Model can not open " + path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Model can not stat " + path);
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Model can not map " + path);
+
+  Model::sptr model = std::make_shared<Model>();
+  model->tile_rows_ = tile_rows;
+  model->storage_.reset(reinterpret_cast<const uint8_t*>(data),
+                        [size](const uint8_t* p) {
+                          munmap(const_cast<uint8_t*>(p), size);
+                        });
+  model->storage_size_ = size;
+  model->parse(model->storage_.get(), size, nullptr);
+  return model;
+#endif
+}
+
+Model::sptr Model::share() const {
+  Model::sptr model = std::make_shared<Model>();
+  model->storage_ = storage_;
+  model->storage_size_ = storage_size_;
+  model->tile_rows_ = tile_rows_;
+  model->parse(storage_.get(), storage_size_, &flash_tensors_);
+  return model;
+}
+
+Model::Model() : input_index_(MODEL_NONE_INDEX),
+                 output_index_(MODEL_NONE_INDEX), tile_rows_(0),
+                 storage_(nullptr), storage_size_(0) {}
+
+Model::~Model() {
+  ops_.clear();
+  ram_tensors_.clear();
+  flash_tensors_.clear();
+}
+
+void Model::parse(const uint8_t* data, size_t size,
+                  const std::vector<FlashTensor::sptr>* shared_weights,
+                  int batch) {
+  if (size < sizeof(ModelFileHeader))
+    throw std::runtime_error("Model data is too small!");
+  const ModelFileHeader* header =
+      reinterpret_cast<const ModelFileHeader*>(data);
+  if (header->magic != MODEL_FILE_MAGIC ||
+      header->version != MODEL_FILE_VERSION)
+    throw std::runtime_error("Model magic or version is wrong!");
+  if (header->tensor_offset + static_cast<uint64_t>(header->tensor_count) *
+      sizeof(ModelFileTensor) > size ||
+      header->op_offset + static_cast<uint64_t>(header->op_count) *
+      sizeof(ModelFileOp) > size ||
+      header->input_tensor >= header->tensor_count ||
+      header->output_tensor >= header->tensor_count)
+    throw std::runtime_error("Model header is broken!");
+  if ((reinterpret_cast<size_t>(data) + header->blob_offset) %
+      MODEL_BLOB_ALIGN != 0)
+    throw std::runtime_error("Model weight blobs are not aligned!");
+
+  const ModelFileTensor* tensors = reinterpret_cast<const ModelFileTensor*>(
+                                     data + header->tensor_offset);
+  ram_tensors_.resize(header->tensor_count);
+  flash_tensors_.resize(header->tensor_count);
+  for (uint32_t i = 0; i < header->tensor_count; i++) {
+    const ModelFileTensor& t = tensors[i];
+    std::string name(t.name, strnlen(t.name, MODEL_NAME_LENGTH));
+    Tensor* tensor = nullptr;
+    if (t.kind > MODEL_TENSOR_CONSTANT || t.data_type > DataType::INT4)
+      throw std::runtime_error("Model tensor " + name + " kind or data type "
+                               "is wrong!");
+    if (t.kind == MODEL_TENSOR_CONSTANT) {
+      if (shared_weights) {
+        flash_tensors_[i] = (*shared_weights)[i];
+        continue;
+      }
+      if (static_cast<uint64_t>(t.data_offset) + t.data_size > size)
+        throw std::runtime_error("Model constant " + name + " out of range!");
+      if ((reinterpret_cast<size_t>(data) + t.data_offset) %
+          MODEL_BLOB_ALIGN != 0)
+        throw std::runtime_error("Model constant " + name +
+                                 " is not aligned!");
+      if (t.channel_scale_offset != 0 &&
+          (static_cast<uint64_t>(t.channel_scale_offset) +
+           static_cast<uint64_t>(static_cast<uint32_t>(t.n)) *
+           sizeof(float) > size ||
+           (reinterpret_cast<size_t>(data) + t.channel_scale_offset) %
+           sizeof(float) != 0))
+        throw std::runtime_error("Model scales of " + name +
+                                 " out of range or not aligned!");
+      FlashTensor::sptr flash = FlashTensor::create(t.n, t.c, t.h, t.w,
+                                                    t.element_size);
+      // the size of packed INT4 data depends on the data type
+      flash->setDataType(static_cast<DataType>(t.data_type));
+      if (t.compressed)
+        flash->bindCompressedData(data + t.data_offset, t.data_size);
+      else
+        flash->bindData(const_cast<uint8_t*>(data + t.data_offset),
+                        t.data_size);
+      if (t.channel_scale_offset != 0) {
+        flash->bindChannelScales(reinterpret_cast<const float*>(
+                                   data + t.channel_scale_offset), t.n);
+      }
+      flash_tensors_[i] = flash;
+      tensor = flash.get();
+    } else if (t.kind == MODEL_TENSOR_INPUT) {
+      ram_tensors_[i] = RamTensor::create(batch > 0 ? batch : t.n, t.c, t.h,
+          t.w, nullptr, t.element_size,
+          t.alignment ? t.alignment : MALLOC_ALIGN);
+      tensor = ram_tensors_[i].get();
+    } else if (tile_rows_ > 0) {
+      // allocated by tileOps unless a TiledOp holds it in band rows
+      ram_tensors_[i] = RamTensor::create(batch > 0 ? batch : t.n, t.c, t.h,
+          t.w, nullptr, t.element_size,
+          t.alignment ? t.alignment : MALLOC_ALIGN);
+      tensor = ram_tensors_[i].get();
+    } else {
+      ram_tensors_[i] = RamTensor::create(batch > 0 ? batch : t.n, t.c, t.h,
+          t.w, t.element_size, t.alignment ? t.alignment : MALLOC_ALIGN);
+      tensor = ram_tensors_[i].get();
+    }
+    tensor->setName(name);
+    tensor->setDataType(static_cast<DataType>(t.data_type));
+    tensor->setQuantizeParams(t.min_range, t.max_range, t.scale,
+                              t.zero_point);
+  }
+  input_index_ = header->input_tensor;
+  output_index_ = header->output_tensor;
+  if (tensors[input_index_].kind != MODEL_TENSOR_INPUT ||
+      !ram_tensors_[output_index_])
+    throw std::runtime_error("Model input/output tensor kind is wrong!");
+
+  const ModelFileOp* ops = reinterpret_cast<const ModelFileOp*>(
+                             data + header->op_offset);
+  std::vector<ModelFileOp> planned(ops, ops + header->op_count);
+  ops_.reserve(header->op_count + 2);
+  Operation::sptr output_layout = planLayouts(&planned);
+  for (uint32_t i = 0; i < header->op_count; i++)
+    ops_.push_back(createOp(planned[i]));
+#if RVTENSOR_KENDRYTE
+  // every KPU layer prefetches the weights of the next one, the last one
+  // those of the first for the next compute
+  std::shared_ptr<KPUConvOp> last_kpu;
+  FlashTensor::sptr first_weight;
+  for (uint32_t i = 0; i < header->op_count; i++) {
+    if (planned[i].type != MODEL_OP_KPU_CONV)
+      continue;
+    FlashTensor::sptr weight = flash_tensors_[planned[i].weight];
+    if (last_kpu)
+      last_kpu->prefetchNext(weight);
+    else
+      first_weight = weight;
+    last_kpu = std::static_pointer_cast<KPUConvOp>(
+                 ops_[ops_.size() - header->op_count + i]);
+  }
+  if (last_kpu)
+    last_kpu->prefetchNext(first_weight);
+#endif
+  if (output_layout)
+    ops_.push_back(output_layout);
+  if (tile_rows_ > 0)
+    tileOps();
+}
+
+void Model::tileOps() {
+  std::map<RamTensor*, int> readers;
+  for (auto& op : ops_) {
+    for (auto& input : op->getInputs())
+      readers[input.get()]++;
+  }
+
+  std::vector<Operation::sptr> ops;
+  std::vector<Operation::sptr> chain;
+  auto flush = [&]() {
+    if (chain.size() > 1)
+      ops.push_back(TiledOp::create(chain, tile_rows_));
+    else
+      ops.insert(ops.end(), chain.begin(), chain.end());
+    chain.clear();
+  };
+  for (auto& op : ops_) {
+    if (!op->supportsRows() || op->getInputs().size() != 1 ||
+        op->getOutputs().size() != 1) {
+      flush();
+      ops.push_back(op);
+      continue;
+    }
+    if (!chain.empty()) {
+      RamTensor::sptr link = chain.back()->getOutputs()[0];
+      if (op->getInputs()[0] != link || readers[link.get()] != 1 ||
+          link == ram_tensors_[output_index_])
+        flush();
+    }
+    chain.push_back(op);
+  }
+  flush();
+  ops_.swap(ops);
+
+  // the activations outside of the chains
+  for (uint32_t i = 0; i < ram_tensors_.size(); i++) {
+    if (ram_tensors_[i] && i != input_index_ && !ram_tensors_[i]->data_ptr)
+      ram_tensors_[i]->allocateData();
+  }
+}
+
+Operation::sptr Model::planLayouts(std::vector<ModelFileOp>* ops) {
+  const uint32_t count = static_cast<uint32_t>(ram_tensors_.size());
+  std::vector<uint32_t> parent(count);
+  for (uint32_t i = 0; i < count; i++)
+    parent[i] = i;
+  auto find = [&parent](uint32_t i) {
+    while (parent[i] != i)
+      i = parent[i] = parent[parent[i]];
+    return i;
+  };
+  auto valid = [&](uint32_t index) {
+    return index < count && ram_tensors_[index];
+  };
+
+  // layouts the convs of a group can run in: bit 0 NHWC (pointwise CPU
+  // convs), bit 1 NCxHWx (uncompressed uint8/int8 CPU convs that are not
+  // tuned: the tunings are NCHW algorithms), -1 for groups without a conv
+  ConvTuner& tuner = ConvTuner::instance();
+  const int kNhwc = 1;
+  const int kBlocked = 2;
+  std::vector<int> state(count, -1);
+  for (const ModelFileOp& op : *ops) {
+    uint32_t first = MODEL_NONE_INDEX;
+    const uint32_t tensor_num = op.input_count + op.output_count;
+    for (uint32_t t = 0; t < tensor_num && t < 2 * MODEL_MAX_OP_TENSORS;
+         t++) {
+      const uint32_t index = t < op.input_count ? op.inputs[t] :
+                             op.outputs[t - op.input_count];
+      if (!valid(index))
+        continue;
+      if (first == MODEL_NONE_INDEX)
+        first = index;
+      else
+        parent[find(index)] = find(first);
+    }
+    if (first == MODEL_NONE_INDEX || op.type == MODEL_OP_QUANTIZE ||
+        op.type == MODEL_OP_ACTIVATION || op.type == MODEL_OP_POOL)
+      continue;
+    const FlashTensor::sptr weight = op.type == MODEL_OP_CONV &&
+        op.weight < flash_tensors_.size() ? flash_tensors_[op.weight]
+        : nullptr;
+    int layouts = 0;
+    if (weight && weight->data_type != FLOAT16 &&
+        weight->data_type != INT4) {
+      const bool pointwise = weight->height == 1 && weight->width == 1 &&
+          op.params[0] == 1 && op.params[1] == 1 && op.params[2] == 1 &&
+          op.params[3] == 1 && op.params[4] == 0 && op.params[5] == 0;
+      if (pointwise)
+        layouts |= kNhwc;
+      ConvTuning tuning = unpackConvTuning(op.params[7]);
+      if (tuning.algorithm == CONV_ALGO_DEFAULT && valid(op.inputs[0])) {
+        const ConvParam param = {op.params[0], op.params[1], op.params[2],
+                                 op.params[3], op.params[4], op.params[5],
+                                 op.params[6] != 0};
+        RamTensor::sptr input = ram_tensors_[op.inputs[0]];
+        if (tuner.isTuning() ||
+            tuner.find(convTuningKey(weight->data_type, input->channel,
+                                     input->height, input->width,
+                                     weight->n_batch, weight->height,
+                                     weight->width, param), &tuning))
+          tuning.algorithm = CONV_ALGO_DIRECT;
+      }
+      if (!weight->isCompressed() && tuning.algorithm == CONV_ALGO_DEFAULT)
+        layouts |= kBlocked;
+    }
+    state[first] &= layouts;
+  }
+  // the marks were put on the first tensor of every op, merge them
+  std::vector<int> group_state(count, -1);
+  for (uint32_t i = 0; i < count; i++)
+    group_state[find(i)] &= state[i];
+  // pointwise groups keep the channels of a pixel contiguous, the others
+  // are blocked by a vector of int32 accumulators
+  auto layoutOf = [&](uint32_t index) {
+    const int layouts = valid(index) ? group_state[find(index)] : 0;
+    if (layouts == -1)
+      return LAYOUT_NCHW;
+    if (layouts & kNhwc)
+      return LAYOUT_NHWC;
+    return (layouts & kBlocked) ? LAYOUT_NCXHWX : LAYOUT_NCHW;
+  };
+  const int block = VECTOR_ALIGN / sizeof(int32_t);
+
+  // copy of the model input/output in the layout of its group, ops are
+  // redirected to it
+  auto redirect = [&](uint32_t from) -> uint32_t {
+    RamTensor::sptr tensor = ram_tensors_[from];
+    RamTensor::sptr copy = RamTensor::create(tensor->n_batch, tensor->channel,
+        tensor->height, tensor->width, tensor->element_size,
+        tensor->alignment);
+    const TensorLayout layout = layoutOf(from);
+    copy->setName(tensor->name + (layout == LAYOUT_NHWC ? "_nhwc"
+                                  : "_ncxhwx"));
+    copy->setDataType(tensor->data_type);
+    copy->setQuantizeParams(tensor->min_range, tensor->max_range,
+                            tensor->scale, tensor->zero_point);
+    copy->setLayout(layout, block);
+    const uint32_t to = static_cast<uint32_t>(ram_tensors_.size());
+    ram_tensors_.push_back(copy);
+    for (ModelFileOp& op : *ops) {
+      for (uint32_t t = 0; t < op.input_count && t < MODEL_MAX_OP_TENSORS;
+           t++)
+        op.inputs[t] = op.inputs[t] == from ? to : op.inputs[t];
+      for (uint32_t t = 0; t < op.output_count && t < MODEL_MAX_OP_TENSORS;
+           t++)
+        op.outputs[t] = op.outputs[t] == from ? to : op.outputs[t];
+    }
+    return to;
+  };
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (layoutOf(i) != LAYOUT_NCHW && i != input_index_ &&
+        i != output_index_)
+      ram_tensors_[i]->setLayout(layoutOf(i), block);
+  }
+  if (layoutOf(input_index_) != LAYOUT_NCHW) {
+    const uint32_t to = redirect(input_index_);
+    ops_.push_back(LayoutOp::create(ram_tensors_[input_index_],
+                                    ram_tensors_[to]));
+  }
+  if (layoutOf(output_index_) != LAYOUT_NCHW &&
+      output_index_ != input_index_) {
+    const uint32_t to = redirect(output_index_);
+    return LayoutOp::create(ram_tensors_[to], ram_tensors_[output_index_]);
+  }
+  return nullptr;
+}
+
+Operation::sptr Model::createOp(const ModelFileOp& op) {
+  auto ram = [&](uint32_t index) -> RamTensor::sptr {
+    if (index >= ram_tensors_.size() || !ram_tensors_[index])
+      throw std::runtime_error("Model op references a wrong ram tensor!");
+    return ram_tensors_[index];
+  };
+  auto flash = [&](uint32_t index) -> FlashTensor::sptr {
+    if (index == MODEL_NONE_INDEX)
+      return nullptr;
+    if (index >= flash_tensors_.size() || !flash_tensors_[index])
+      throw std::runtime_error("Model op references a wrong constant!");
+    return flash_tensors_[index];
+  };
+  if (op.input_count < 1 || op.output_count < 1 ||
+      op.input_count > MODEL_MAX_OP_TENSORS ||
+      op.output_count > MODEL_MAX_OP_TENSORS)
+    throw std::runtime_error("Model op tensor count is wrong!");
+
+  switch (op.type) {
+    case MODEL_OP_CONV:
+    case MODEL_OP_KPU_CONV: {
+      // strides and dilations divide the shapes, the weight is dereferenced
+      if (op.weight == MODEL_NONE_INDEX || op.params[0] < 1 ||
+          op.params[1] < 1 || op.params[2] < 1 || op.params[3] < 1 ||
+          op.params[4] < 0 || op.params[5] < 0)
+        throw std::runtime_error("Model conv weight or params are wrong!");
+      ConvParam param = {op.params[0], op.params[1], op.params[2],
+                         op.params[3], op.params[4], op.params[5],
+                         op.params[6] != 0};
+#if RVTENSOR_KENDRYTE
+      if (op.type == MODEL_OP_KPU_CONV) {
+        return KPUConvOp::create(param, ram(op.inputs[0]), ram(op.outputs[0]),
+                                 flash(op.weight), flash(op.bias));
+      }
+#endif
+      CPUConvOp::sptr conv = CPUConvOp::create(param, ram(op.inputs[0]),
+          ram(op.outputs[0]), flash(op.weight), flash(op.bias));
+      if (op.type == MODEL_OP_CONV)
+        conv->setTuning(unpackConvTuning(op.params[7]));
+      return conv;
+    }
+    case MODEL_OP_QUANTIZE: {
+      QuantizeParam param = {op.params[0], op.params[1],
+                             static_cast<QuantizeStrategy>(op.params[2]),
+                             op.params[3] != 0};
+      return QuantizeOp::create(param, ram(op.inputs[0]), ram(op.outputs[0]));
+    }
+    case MODEL_OP_POOL: {
+      if (op.params[0] < POOL_MAX || op.params[0] > POOL_AVERAGE ||
+          op.params[1] < 1 || op.params[2] < 1 || op.params[3] < 1 ||
+          op.params[4] < 1 || op.params[5] < 0 || op.params[6] < 0)
+        throw std::runtime_error("Model pool params are wrong!");
+      PoolParam param = {static_cast<PoolType>(op.params[0]), op.params[1],
+                         op.params[2], op.params[3], op.params[4],
+                         op.params[5], op.params[6]};
+      return PoolOp::create(param, ram(op.inputs[0]), ram(op.outputs[0]));
+    }
+    case MODEL_OP_ACTIVATION: {
+      ActivationParam param = {static_cast<ActivationType>(op.params[0]),
+                               0.f};
+      memcpy(&param.alpha, &op.params[1], sizeof(param.alpha));
+      return ActivationOp::create(param, ram(op.inputs[0]),
+                                  ram(op.outputs[0]));
+    }
+    default:
+      throw std::runtime_error("Model unsupport op type!");
+  }
+}
+
+void Model::setBatch(int n) {
+  if (n < 1)
+    throw std::runtime_error("Model batch is wrong!");
+  if (n != getBatch())
+    rebuild(n);
+}
+
+void Model::setTiling(int rows) {
+  if (rows < 0)
+    throw std::runtime_error("Model tiling rows is wrong!");
+  if (rows != tile_rows_) {
+    tile_rows_ = rows;
+    rebuild(getBatch());
+  }
+}
+
+int Model::getTiling() {
+  return tile_rows_;
+}
+
+void Model::rebuild(int batch) {
+  std::vector<FlashTensor::sptr> weights = flash_tensors_;
+  ops_.clear();
+  ram_tensors_.clear();
+  flash_tensors_.clear();
+  parse(storage_.get(), storage_size_, &weights, batch);
+}
+
+int Model::getBatch() {
+  return ram_tensors_[input_index_]->n_batch;
+}
+
+void Model::bindInput(RamTensor::sptr image) {
+  RamTensor::sptr input = ram_tensors_[input_index_];
+  if (image->n_batch != input->n_batch || image->channel != input->channel ||
+      image->height != input->height || image->width != input->width ||
+      image->element_size != input->element_size ||
+      image->cstep != input->cstep || !image->isContiguous() ||
+      image->layout != input->layout)
+    throw std::runtime_error("Model input layout is wrong!");
+  input->data_ptr = image->data_ptr;
+}
+
+void Model::bindOutput(void* data, size_t size) {
+  if (data == nullptr) {
+    // back to an owned output buffer
+    rebuild(getBatch());
+    return;
+  }
+  RamTensor::sptr output = ram_tensors_[output_index_];
+  if (size < output->totalSize())
+    throw std::runtime_error("Model output buffer is too small!");
+  output->bindData(data);
+}
+
+void Model::compute() {
+  if (ram_tensors_[input_index_]->data_ptr == nullptr)
+    throw std::runtime_error("Model input is not bound!");
+  for (auto& op : ops_)
+    op->run();
+}
+
+RamTensor::sptr Model::getInput() {
+  return ram_tensors_[input_index_];
+}
+
+RamTensor::sptr Model::getOutput() {
+  return ram_tensors_[output_index_];
+}
+
+std::vector<Operation::sptr>& Model::getOps() {
+  return ops_;
+}
+
+}  // namespace RVTensor
@@ -9,6 +9,9 @@
 
 namespace RVTensor {
 
+static tensor_observer observer_ = nullptr;
+static void* observer_userdata_ = nullptr;
+
 Operation::sptr Operation::create() {
     return std::make_shared<Operation>();
 }
@@ -34,4 +37,22 @@ std::vector<RamTensor::sptr> Operation::getOutputs() {
     return outputs_;
 }
 
+void Operation::inputRows(int /*h0*/, int /*h1*/, int* begin, int* end) {
+    *begin = 0;
+    *end = inputs_.empty() ? 0 : inputs_[0]->height;
+}
+
+void Operation::run() {
+    forward_compute();
+    if (observer_) {
+        for (auto& output : outputs_)
+            observer_(output, observer_userdata_);
+    }
+}
+
+void Operation::setObserver(tensor_observer observer, void* userdata) {
+    observer_ = observer;
+    observer_userdata_ = userdata;
+}
+
 }  // namespace RVTensor
@@ -0,0 +1,272 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cstring>
+#include <stdexcept>
+#if RVTENSOR_KENDRYTE
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <semphr.h>
+#include <task.h>
+#else
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+#endif
+#include "include/core/os.hpp"
+
+namespace RVTensor {
+
+#if RVTENSOR_KENDRYTE
+
+struct QueueImpl {
+  QueueHandle_t queue;
+};
+
+struct TaskImpl {
+  task_entry entry;
+  void* arg;
+  /// given by the task right before it deletes itself
+  SemaphoreHandle_t done;
+  bool joined;
+};
+
+struct MutexImpl {
+  SemaphoreHandle_t mutex;
+};
+
+static void taskTrampoline(void* param) {
+  TaskImpl* impl = reinterpret_cast<TaskImpl*>(param);
+  impl->entry(impl->arg);
+  xSemaphoreGive(impl->done);
+  vTaskDelete(NULL);
+}
+
+Queue::Queue(size_t depth, size_t item_size) : impl_(new QueueImpl) {
+  impl_->queue = xQueueCreate(depth, item_size);
+  if (impl_->queue == NULL) {
+    delete impl_;
+    throw std::runtime_error("Queue create failed!");
+  }
+}
+
+Queue::~Queue() {
+  vQueueDelete(impl_->queue);
+  delete impl_;
+}
+
+void Queue::send(const void* item) {
+  xQueueSend(impl_->queue, item, portMAX_DELAY);
+}
+
+void Queue::receive(void* item) {
+  xQueueReceive(impl_->queue, item, portMAX_DELAY);
+}
+
+bool Queue::trySend(const void* item) {
+  return xQueueSend(impl_->queue, item, 0) == pdTRUE;
+}
+
+bool Queue::tryReceive(void* item) {
+  return xQueueReceive(impl_->queue, item, 0) == pdTRUE;
+}
+
+bool Queue::sendFromISR(const void* item) {
+  BaseType_t woken = pdFALSE;
+  bool ret = xQueueSendFromISR(impl_->queue, item, &woken) == pdTRUE;
+  portYIELD_FROM_ISR(woken);
+  return ret;
+}
+
+bool Queue::receiveFromISR(void* item) {
+  BaseType_t woken = pdFALSE;
+  bool ret = xQueueReceiveFromISR(impl_->queue, item, &woken) == pdTRUE;
+  portYIELD_FROM_ISR(woken);
+  return ret;
+}
+
+size_t Queue::size() {
+  return uxQueueMessagesWaiting(impl_->queue);
+}
+
+Task::Task(const char* name, task_entry entry, void* arg, int priority,
+           size_t stack_size) : impl_(new TaskImpl) {
+  impl_->entry = entry;
+  impl_->arg = arg;
+  impl_->joined = false;
+  impl_->done = xSemaphoreCreateBinary();
+  if (impl_->done == NULL ||
+      xTaskCreate(taskTrampoline, name, stack_size / sizeof(StackType_t),
+                  impl_, priority, NULL) != pdPASS) {
+    if (impl_->done != NULL)
+      vSemaphoreDelete(impl_->done);
+    delete impl_;
+    throw std::runtime_error("Task create failed!");
+  }
+}
+
+void Task::join() {
+  if (impl_->joined)
+    return;
+  xSemaphoreTake(impl_->done, portMAX_DELAY);
+  impl_->joined = true;
+}
+
+Task::~Task() {
+  join();
+  vSemaphoreDelete(impl_->done);
+  delete impl_;
+}
+
+Mutex::Mutex() : impl_(new MutexImpl) {
+  impl_->mutex = xSemaphoreCreateMutex();
+  if (impl_->mutex == NULL) {
+    delete impl_;
+    throw std::runtime_error("Mutex create failed!");
+  }
+}
+
+Mutex::~Mutex() {
+  vSemaphoreDelete(impl_->mutex);
+  delete impl_;
+}
+
+void Mutex::lock() {
+  xSemaphoreTake(impl_->mutex, portMAX_DELAY);
+}
+
+void Mutex::unlock() {
+  xSemaphoreGive(impl_->mutex);
+}
+
+#else
+
+struct QueueImpl {
+  size_t depth;
+  size_t item_size;
+  std::deque<std::vector<uint8_t>> items;
+  std::mutex mutex;
+  std::condition_variable not_full;
+  std::condition_variable not_empty;
+
+  void push(const void* item) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(item);
+    items.emplace_back(bytes, bytes + item_size);
+    not_empty.notify_one();
+  }
+
+  void pop(void* item) {
+    memcpy(item, items.front().data(), item_size);
+    items.pop_front();
+    not_full.notify_one();
+  }
+};
+
+struct TaskImpl {
+  std::thread thread;
+};
+
+struct MutexImpl {
+  std::mutex mutex;
+};
+
+Queue::Queue(size_t depth, size_t item_size) : impl_(new QueueImpl) {
+  impl_->depth = depth;
+  impl_->item_size = item_size;
+}
+
+Queue::~Queue() {
+  delete impl_;
+}
+
+void Queue::send(const void* item) {
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  impl_->not_full.wait(lock, [this] {
+    return impl_->items.size() < impl_->depth;
+  });
+  impl_->push(item);
+}
+
+void Queue::receive(void* item) {
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  impl_->not_empty.wait(lock, [this] { return !impl_->items.empty(); });
+  impl_->pop(item);
+}
+
+bool Queue::trySend(const void* item) {
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  if (impl_->items.size() >= impl_->depth)
+    return false;
+  impl_->push(item);
+  return true;
+}
+
+bool Queue::tryReceive(void* item) {
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  if (impl_->items.empty())
+    return false;
+  impl_->pop(item);
+  return true;
+}
+
+bool Queue::sendFromISR(const void* item) {
+  return trySend(item);
+}
+
+bool Queue::receiveFromISR(void* item) {
+  return tryReceive(item);
+}
+
+size_t Queue::size() {
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  return impl_->items.size();
+}
+
+// the host threads have no name, priority or stack size
+Task::Task(const char*, task_entry entry, void* arg, int, size_t)
+  : impl_(new TaskImpl) {
+  impl_->thread = std::thread(entry, arg);
+}
+
+void Task::join() {
+  if (impl_->thread.joinable())
+    impl_->thread.join();
+}
+
+Task::~Task() {
+  join();
+  delete impl_;
+}
+
+Mutex::Mutex() : impl_(new MutexImpl) {}
+
+Mutex::~Mutex() {
+  delete impl_;
+}
+
+void Mutex::lock() {
+  impl_->mutex.lock();
+}
+
+void Mutex::unlock() {
+  impl_->mutex.unlock();
+}
+
+#endif
+
+Queue::sptr Queue::create(size_t depth, size_t item_size) {
+  return std::make_shared<Queue>(depth, item_size);
+}
+
+Task::sptr Task::create(const char* name, task_entry entry, void* arg,
+                        int priority, size_t stack_size) {
+  return std::make_shared<Task>(name, entry, arg, priority, stack_size);
+}
+
+}  // namespace RVTensor
@@ -0,0 +1,155 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include "include/core/pipeline.hpp"
+
+namespace RVTensor {
+
+Pipeline::sptr Pipeline::create(Executor::sptr executor, int slot_num,
+                                int channel, int height, int width) {
+  return std::make_shared<Pipeline>(executor, slot_num, channel, height,
+                                    width);
+}
+
+Pipeline::Pipeline(Executor::sptr executor, int slot_num,
+                   int channel, int height, int width)
+                  : executor_(executor), task_(nullptr) {
+  if (!executor_ || slot_num < 2)
+    throw std::runtime_error("Pipeline needs an executor and 2 slots!");
+  // one extra entry in ready_ for the stop request
+  free_ = Queue::create(slot_num, sizeof(int));
+  ready_ = Queue::create(slot_num + 1, sizeof(int));
+  done_ = Queue::create(slot_num, sizeof(int));
+  inputs_.resize(slot_num);
+  outputs_.resize(slot_num);
+  status_.resize(slot_num, 0);
+  for (int slot = 0; slot < slot_num; slot++) {
+    inputs_[slot] = RamTensor::create(1, channel, height, width, 1u,
+                                      executor_->inputAlignment());
+    free_->send(&slot);
+  }
+}
+
+Pipeline::~Pipeline() {
+  stop();
+  // the executor may still write into the last slot output
+  executor_->bindOutput(nullptr, 0);
+}
+
+void Pipeline::start(int priority, size_t stack_size) {
+  if (task_)
+    return;
+  task_ = Task::create("rvtensor_infer", inferenceEntry, this, priority,
+                       stack_size);
+}
+
+void Pipeline::stop() {
+  if (!task_)
+    return;
+  int stop_slot = -1;
+  ready_->send(&stop_slot);
+  task_->join();
+  task_ = nullptr;
+}
+
+uint8_t* Pipeline::slotBuffer(int slot) {
+  return reinterpret_cast<uint8_t*>(inputs_.at(slot)->data_ptr);
+}
+
+int Pipeline::slotNum() const {
+  return static_cast<int>(inputs_.size());
+}
+
+int Pipeline::acquireSlot() {
+  int slot;
+  free_->receive(&slot);
+  return slot;
+}
+
+int Pipeline::acquireSlotFromISR() {
+  int slot;
+  return free_->receiveFromISR(&slot) ? slot : -1;
+}
+
+void Pipeline::submitSlot(int slot) {
+  ready_->send(&slot);
+}
+
+bool Pipeline::submitSlotFromISR(int slot) {
+  return ready_->sendFromISR(&slot);
+}
+
+int Pipeline::waitResult() {
+  int slot;
+  done_->receive(&slot);
+  return slot;
+}
+
+RamTensor::sptr Pipeline::slotOutput(int slot) {
+  return outputs_.at(slot);
+}
+
+void Pipeline::releaseSlot(int slot) {
+  free_->send(&slot);
+}
+
+int Pipeline::slotStatus(int slot) {
+  return status_.at(slot);
+}
+
+void Pipeline::inferenceEntry(void* arg) {
+  Pipeline* pipeline = reinterpret_cast<Pipeline*>(arg);
+  while (true) {
+    int slot;
+    pipeline->ready_->receive(&slot);
+    if (slot < 0)
+      break;
+    // a failed slot still goes on to display, which returns it to capture
+    int status = 0;
+    try {
+      pipeline->inference(slot);
+    } catch (const std::exception&) {
+      status = -1;
+    }
+    pipeline->status_[slot] = status;
+    pipeline->done_->send(&slot);
+  }
+}
+
+void Pipeline::inference(int slot) {
+  RamTensor::sptr input = inputs_[slot];
+  executor_->bindInput(reinterpret_cast<uint8_t*>(input->data_ptr),
+                       input->channel, input->height, input->width,
+                       input->cstep);
+  // the executor writes straight into the slot output once it exists, so
+  // the display stage can read it while the next frame is inferred
+  RamTensor::sptr& output = outputs_[slot];
+  if (output)
+    executor_->bindOutput(output->data_ptr, output->totalSize());
+  executor_->compute();
+
+  RamTensor::sptr result = executor_->getOutput();
+  if (!result)
+    return;
+  if (!output || output->n_batch != result->n_batch ||
+      output->channel != result->channel ||
+      output->height != result->height || output->width != result->width ||
+      output->element_size != result->element_size) {
+    output = RamTensor::create(result->n_batch, result->channel,
+                               result->height, result->width,
+                               result->element_size);
+  }
+  if (output->data_ptr != result->data_ptr)
+    memcpy(output->data_ptr, result->data_ptr, result->totalSize());
+  output->setDataType(result->data_type);
+  output->setQuantizeParams(result->min_range, result->max_range,
+                            result->scale, result->zero_point);
+}
+
+}  // namespace RVTensor
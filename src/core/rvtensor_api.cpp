@@ -5,18 +5,37 @@
  *
  */
 
+#include <cstdlib>
 #include <memory>
 #include "include/core/executor.hpp"
+#include "include/core/pipeline.hpp"
 #include "include/core/rvtensor_api.h"
 
-RVTensor::Executor::sptr sp = nullptr;
-
 void create_executor(void** pptr, char* model_name, int thread_num) {
   if (pptr == NULL)
     exit(0);
   std::string st = model_name;
-  sp = RVTensor::Executor::create(st, thread_num);
-  *pptr = reinterpret_cast<void*>(&sp);
+  *pptr = reinterpret_cast<void*>(new RVTensor::Executor::sptr(
+      RVTensor::Executor::create(st, thread_num)));
+}
+
+void load_model_by_buf(void* ptr, const void* model_buf, size_t size) {
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->loadModel(
+                                                       model_buf, size);
+}
+
+void load_model_by_path(void* ptr, char* model_path) {
+  std::string st = model_path;
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->loadModel(st);
+}
+
+void share_model(void* ptr, void* other) {
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->shareModel(
+      *(reinterpret_cast<RVTensor::Executor::sptr*>(other)));
+}
+
+void set_tiling(void* ptr, int rows) {
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->setTiling(rows);
 }
 
 void load_image_by_buf(void* ptr, uint8_t* ai_buf,
@@ -25,6 +44,37 @@ void load_image_by_buf(void* ptr, uint8_t* ai_buf,
                                         ai_buf, channel, height, width);
 }
 
+void bind_input_buf(void* ptr, uint8_t* data, int channel, int height,
+                    int width, size_t cstep) {
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->bindInput(
+                                  data, channel, height, width, cstep);
+}
+
+void set_preprocess(void* ptr, int resize, const int* channel_order,
+                    const float* mean, const float* std) {
+  RVTensor::PreprocessParam param;
+  param.resize = static_cast<RVTensor::ResizeMethod>(resize);
+  for (int c = 0; c < 3; c++) {
+    param.channel_order[c] = channel_order[c];
+    param.mean[c] = mean[c];
+    param.std[c] = std[c];
+  }
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->setPreprocess(
+                                                                 param);
+}
+
+void load_frame_by_buf(void* ptr, const void* frame, int format, int height,
+                       int width) {
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->loadFrame(frame,
+      static_cast<RVTensor::FrameFormat>(format), height, width);
+}
+
+void load_images_by_buf(void* ptr, uint8_t** ai_bufs, int batch,
+                        int channel, int height, int width) {
+  (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->loadImages(
+                                ai_bufs, batch, channel, height, width);
+}
+
 // void load_image_by_path(void* ptr, char* image_path,
 //                         int channel, int height, int width) {
 //   (*(reinterpret_cast<RVTensor::Executor::sptr*>(ptr)))->loadImage(
@@ -35,16 +85,146 @@ void compute_model(void* ptr) {
   (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->compute();
 }
 
+void compute_model_async(void* ptr, void (*callback)(int status,
+                         void* userdata), void* userdata) {
+  (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->computeAsync(callback,
+                                                                 userdata);
+}
+
+void wait_model(void* ptr) {
+  (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->wait();
+}
+
+int poll_model(void* ptr) {
+  return (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->poll();
+}
+
 void copy_output_buf(void* ptr, void* data_ptr, size_t size) {
   (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->copyOutputData(
                                                            data_ptr, size);
 }
 
+void copy_batch_output_buf(void* ptr, int index, void* data_ptr,
+                           size_t size) {
+  (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->copyOutputData(
+                                                    index, data_ptr, size);
+}
+
+static int fill_view(RVTensor::RamTensor::sptr output,
+                     tensor_view_t* view) {
+  if (!output || view == NULL)
+    return -1;
+  view->data = output->data_ptr;
+  view->n = output->n_batch;
+  view->c = output->channel;
+  view->h = output->height;
+  view->w = output->width;
+  view->cstep = output->cstep;
+  view->element_size = output->element_size;
+  view->data_type = output->data_type;
+  view->scale = output->scale;
+  view->zero_point = output->zero_point;
+  return 0;
+}
+
+int get_output_view(void* ptr, tensor_view_t* view) {
+  return fill_view(
+      (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->getOutput(), view);
+}
+
+void bind_output_buf(void* ptr, void* data_ptr, size_t size) {
+  (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->bindOutput(data_ptr,
+                                                                size);
+}
+
 void inference_result(void* ptr, void* result_buf, uint64_t size, void* call) {
   (*(static_cast<RVTensor::Executor::sptr*>(ptr)))->inferenceResult(
       result_buf, size, (RVTensor::callback_draw_box)call);
 }
 
 void destroy_executor(void* ptr) {
-  sp.reset();
+  delete static_cast<RVTensor::Executor::sptr*>(ptr);
+}
+
+void create_pipeline(void** pptr, void* executor, int slot_num, int channel,
+                     int height, int width) {
+  if (pptr == NULL || executor == NULL)
+    exit(0);
+  *pptr = reinterpret_cast<void*>(new RVTensor::Pipeline::sptr(
+      RVTensor::Pipeline::create(
+          *(reinterpret_cast<RVTensor::Executor::sptr*>(executor)),
+          slot_num, channel, height, width)));
+}
+
+void start_pipeline(void* ptr, int priority) {
+  (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->start(priority);
+}
+
+uint8_t* pipeline_slot_buffer(void* ptr, int slot) {
+  return (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->slotBuffer(slot);
+}
+
+int pipeline_acquire_slot(void* ptr) {
+  return (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->acquireSlot();
+}
+
+int pipeline_acquire_slot_from_isr(void* ptr) {
+  return (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->acquireSlotFromISR();
+}
+
+void pipeline_submit_slot(void* ptr, int slot) {
+  (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->submitSlot(slot);
+}
+
+int pipeline_submit_slot_from_isr(void* ptr, int slot) {
+  return (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->submitSlotFromISR(
+                                                                 slot);
+}
+
+int pipeline_wait_result(void* ptr) {
+  return (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->waitResult();
+}
+
+int pipeline_slot_status(void* ptr, int slot) {
+  return (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->slotStatus(slot);
+}
+
+void pipeline_copy_output(void* ptr, int slot, void* data_ptr, size_t size) {
+  RVTensor::RamTensor::sptr output =
+      (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->slotOutput(slot);
+  if (output)
+    output->readData(data_ptr, size);
+}
+
+int pipeline_output_view(void* ptr, int slot, tensor_view_t* view) {
+  return fill_view(
+      (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->slotOutput(slot),
+      view);
+}
+
+void pipeline_release_slot(void* ptr, int slot) {
+  (*(static_cast<RVTensor::Pipeline::sptr*>(ptr)))->releaseSlot(slot);
+}
+
+void destroy_pipeline(void* ptr) {
+  delete static_cast<RVTensor::Pipeline::sptr*>(ptr);
+}
+
+int use_pool_allocator(void* region, size_t size) {
+  try {
+    RVTensor::Allocator::setDefault(region ?
+        RVTensor::PoolAllocator::create(region, size) :
+        RVTensor::PoolAllocator::create(size));
+  } catch (const std::exception& e) {
+    return -1;
+  }
+  return 0;
+}
+
+void get_allocator_stats(allocator_stats_t* stats) {
+  RVTensor::AllocatorStats current =
+      RVTensor::Allocator::getDefault()->stats();
+  stats->live_bytes = current.live_bytes;
+  stats->peak_bytes = current.peak_bytes;
+  stats->alloc_count = current.alloc_count;
 }
@@ -10,7 +10,9 @@
 #include <iostream>
 #include <cstdint>
 #include <memory>
+#include <vector>
 #include "include/core/tensor.hpp"
+#include "include/core/weight_codec.hpp"
 
 namespace RVTensor {
 
@@ -28,19 +30,29 @@ Tensor::sptr Tensor::create(int n, int c, int h, int w,
   return std::make_shared<Tensor>(n, c, h, w, data, elemsize);
 }
 
-inline Tensor::Tensor() : data_ptr(nullptr), element_size(0), n_batch(0),
-                          width(0), height(0), channel(0), cstep(0) {}
+inline Tensor::Tensor() : data_ptr(nullptr), element_size(0),
+                          data_type(FLOAT32), n_batch(0),
+                          width(0), height(0), channel(0), cstep(0),
+                          layout(LAYOUT_NCHW), block(1), hstep(0), nstep(0),
+                          alignment(MALLOC_ALIGN), min_range(0.f),
+                          max_range(0.f), scale(1.f), zero_point(0) {}
 
 inline Tensor::Tensor(int n, int c, int h, int w, size_t elemsize)
-  : data_ptr(nullptr), element_size(elemsize), n_batch(n), width(w),
-                                                  height(h), channel(c) {
+  : data_ptr(nullptr), element_size(elemsize),
+    data_type(defaultDataType(elemsize)), n_batch(n), width(w),
+    height(h), channel(c), layout(LAYOUT_NCHW), block(1), hstep(0), nstep(0),
+    alignment(MALLOC_ALIGN), min_range(0.f),
+    max_range(0.f), scale(1.f), zero_point(0) {
     cstep = (channel <= 1) ? width * height :
          alignSize(width * height * element_size, MALLOC_ALIGN) / element_size;
   }
 
 inline Tensor::Tensor(int n, int c, int h, int w, void* data, size_t elemsize)
-  : data_ptr(data), element_size(elemsize), n_batch(n), width(w),
-                                                  height(h), channel(c) {
+  : data_ptr(data), element_size(elemsize),
+    data_type(defaultDataType(elemsize)), n_batch(n), width(w),
+    height(h), channel(c), layout(LAYOUT_NCHW), block(1), hstep(0), nstep(0),
+    alignment(MALLOC_ALIGN), min_range(0.f),
+    max_range(0.f), scale(1.f), zero_point(0) {
     cstep = (channel <= 1) ? width * height :
          alignSize(width * height * element_size, MALLOC_ALIGN) / element_size;
 }
@@ -54,12 +66,38 @@ inline Tensor::~Tensor() {
   cstep = 0;
 }
 
-inline bool Tensor::empty() const {
+bool Tensor::empty() const {
   return data_ptr == nullptr || totalSize() == 0;
 }
 
 size_t Tensor::totalSize() const {
-  return cstep * channel * n_batch * element_size;
+  if (data_type == DataType::INT4)
+    return trueSize();
+  if (!isContiguous() && count() > 0)
+    return (offset(n_batch - 1, channel - 1, height - 1, width - 1) + 1) *
+           element_size;
+  return cstep * groups() * n_batch * element_size;
+}
+
+size_t Tensor::rowStep() const {
+  return hstep ? hstep : static_cast<size_t>(width) * block;
+}
+
+size_t Tensor::batchStep() const {
+  return nstep ? nstep : cstep * groups();
+}
+
+bool Tensor::isContiguous() const {
+  return hstep == 0 && nstep == 0;
+}
+
+int Tensor::groups() const {
+  return block > 0 ? (channel + block - 1) / block : 0;
+}
+
+size_t Tensor::offset(int n, int c, int h, int w) const {
+  return n * batchStep() + (c / block) * cstep + h * rowStep() +
+         static_cast<size_t>(w) * block + c % block;
 }
 
 size_t Tensor::count() const {
@@ -67,27 +105,41 @@ size_t Tensor::count() const {
 }
 
 size_t Tensor::trueSize() const {
+  if (data_type == DataType::INT4)
+    return n_batch * ((channel * height * width + 1) / 2);
   return n_batch * channel * height * width * element_size;
 }
 
-inline void Tensor::setQuantizeParams(
-             float min, float max, int64_t sc, float zero) {
+bool Tensor::isAligned() const {
+  return reinterpret_cast<size_t>(data_ptr) % alignment == 0 &&
+         (channel * n_batch <= 1 || cstep * element_size % alignment == 0);
+}
+
+void Tensor::setDataType(DataType type) {
+  data_type = type;
+}
+
+void Tensor::setQuantizeParams(float min, float max, float sc, int32_t zero) {
   min_range = min;
   max_range = max;
   scale = sc;
   zero_point = zero;
 }
 
-inline void Tensor::setQuantizeRange(float min, float max) {
+void Tensor::setQuantizeRange(float min, float max) {
   min_range = min;
   max_range = max;
 }
 
-inline void Tensor::setQuantizer(int64_t sc, float zero) {
+void Tensor::setQuantizer(float sc, int32_t zero) {
   scale = sc;
   zero_point = zero;
 }
 
+void Tensor::setName(const std::string& tensor_name) {
+  name = tensor_name;
+}
+
 /////////////////// FlashTensor /////////////////////////////
 FlashTensor::sptr FlashTensor::create() {
   return std::make_shared<FlashTensor>();
@@ -103,90 +155,92 @@ FlashTensor::sptr FlashTensor::create(int n, int c, int h, int w, void* data,
   return std::make_shared<FlashTensor>(n, c, h, w, data, elemsize);
 }
 
-inline FlashTensor::FlashTensor() : Tensor() {}
+inline FlashTensor::FlashTensor() : Tensor(), compressed_data(nullptr),
+                                    compressed_size(0),
+                                    channel_scales(nullptr) {}
 
 inline FlashTensor::FlashTensor(int n, int c, int h, int w, size_t elemsize)
-  : Tensor(n, c, h, w, elemsize) {}
+  : Tensor(n, c, h, w, elemsize), compressed_data(nullptr),
+    compressed_size(0), channel_scales(nullptr) {}
 
 inline FlashTensor::FlashTensor(int n, int c, int h, int w,
                                 void* data, size_t elemsize)
-  : Tensor(n, c, h, w, data, elemsize) {}
+  : Tensor(n, c, h, w, data, elemsize), compressed_data(nullptr),
+    compressed_size(0), channel_scales(nullptr) {}
 
 inline FlashTensor::~FlashTensor() {
   data_ptr = nullptr;
 }
 
-inline void FlashTensor::bindData(void* data, size_t size) {
+void FlashTensor::bindData(void* data, size_t size) {
   if (size == trueSize() && data_ptr == nullptr)
     data_ptr = data;
   else
     throw std::runtime_error("FlashTensor duplicate copy of data_ptr!");
 }
 
-template <typename T>
-  inline const T* FlashTensor::grepBatchData(int n) const {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<const T*>(data_ptr) +
-      n * channel * cstep * element_size;
-  }
-
-template <typename T>
-  inline const T* FlashTensor::grepChannelData(int n, int c) const {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<const T*>(data_ptr) +
-      (n * channel * cstep + c * cstep) * element_size;
-  }
+void FlashTensor::bindCompressedData(const void* data, size_t size) {
+  if (data_ptr != nullptr || compressed_data != nullptr)
+    throw std::runtime_error("FlashTensor duplicate copy of data_ptr!");
+  const WeightCodecHeader* header = weightCodecHeader(data, size,
+                                                      trueSize());
+  if (!header || header->item_size * n_batch != trueSize())
+    throw std::runtime_error("FlashTensor compressed data is broken!");
+  compressed_data = reinterpret_cast<const uint8_t*>(data);
+  compressed_size = size;
+}
 
-template <typename T>
-  inline const T* FlashTensor::grepRowData(int n, int c, int h) const {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<const T*>(data_ptr) +
-      (n * channel * cstep + c * cstep + h * width) * element_size;
-  }
+bool FlashTensor::isCompressed() const {
+  return compressed_data != nullptr;
+}
 
-template <typename T>
-  inline const T FlashTensor::grepElement(int n, int c, int h, int w) const {
-    assert(sizeof(T) == element_size);
-    return *(reinterpret_cast<const T*>(data_ptr) +
-        (n * channel * cstep + c * cstep + h * width + w) * element_size);
-  }
+void FlashTensor::bindChannelScales(const float* scales, size_t num) {
+  if (num == static_cast<size_t>(n_batch) && scales != nullptr)
+    channel_scales = scales;
+  else
+    throw std::runtime_error("FlashTensor channel scales size is wrong!");
+}
 
-template <typename T>
-  inline FlashTensor::operator const T*() const {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<const T*>(data_ptr);
-  }
+float FlashTensor::channelScale(int n) const {
+  return channel_scales ? channel_scales[n] : scale;
+}
 
 ////////////////// RamTensor ////////////////////////////////
 RamTensor::sptr RamTensor::create() {
   return std::make_shared<RamTensor>();
 }
 
-RamTensor::sptr RamTensor::create(int n, int c, int h, int w, size_t elemsize) {
-  return std::make_shared<RamTensor>(n, c, h, w, elemsize);
+RamTensor::sptr RamTensor::create(int n, int c, int h, int w, size_t elemsize,
+                                  size_t alignment) {
+  return std::make_shared<RamTensor>(n, c, h, w, elemsize, alignment);
 }
 
 RamTensor::sptr RamTensor::create(int n, int c, int h, int w,
-    void* data, size_t elemsize) {
-  return std::make_shared<RamTensor>(n, c, h, w, data, elemsize);
+    void* data, size_t elemsize, size_t alignment) {
+  return std::make_shared<RamTensor>(n, c, h, w, data, elemsize, alignment);
 }
 
-inline RamTensor::RamTensor() : Tensor() {}
-
-inline RamTensor::RamTensor(int n, int c, int h, int w, size_t elemsize)
-  : Tensor(n, c, h, w, elemsize), is_malloced(true) {
-    cstep = (c <= 1) ? width * height :
-         alignSize(width * height * element_size, MALLOC_ALIGN) / element_size;
+inline RamTensor::RamTensor() : Tensor(), is_malloced(false),
+                                allocator_(nullptr), malloced_size(0) {}
 
+inline RamTensor::RamTensor(int n, int c, int h, int w, size_t elemsize,
+                            size_t alignment)
+  : Tensor(n, c, h, w, elemsize), is_malloced(false), allocator_(nullptr),
+    malloced_size(0) {
+    setAlignment(alignment);
     if (totalSize() > 0) {
-      size_t total_size = alignSize(totalSize() * elemsize, 4);
-      data_ptr = tensorDataMalloc(total_size);
+      malloced_size = alignSize(totalSize(), 4);
+      data_ptr = tensorDataMalloc(malloced_size);
+      is_malloced = true;
     }
   }
 
 inline RamTensor::RamTensor(int n, int c, int h, int w,
-    void* data, size_t elemsize)
-  : Tensor(n, c, h, w, data, elemsize), is_malloced(false) {}
+    void* data, size_t elemsize, size_t alignment)
+  : Tensor(n, c, h, w, data, elemsize), is_malloced(false),
+    allocator_(nullptr), malloced_size(0) {
+    setAlignment(alignment);
+  }
 
 inline RamTensor::~RamTensor() {
   if (is_malloced)
@@ -195,31 +249,69 @@ inline RamTensor::~RamTensor() {
 
 template <typename T>
 void RamTensor::fill(T _v) {
-  for (int c = 0; c < channel; c++) {
-    T* dst_ptr = reinterpret_cast<T*>(
-                 reinterpret_cast<uint8_t*>(data_ptr) +
-                 c * cstep * element_size);
-    for (int i = 0; i < height * width; i++) {
-      dst_ptr[i] = _v;
+  T* data = reinterpret_cast<T*>(data_ptr);
+  if (!wholeBlocks()) {
+    for (int n = 0; n < n_batch; n++)
+      for (int c = 0; c < channel; c++)
+        for (int h = 0; h < height; h++)
+          for (int w = 0; w < width; w++)
+            data[offset(n, c, h, w)] = _v;
+    return;
+  }
+  // packed planes are filled as a single row
+  const int rows = isContiguous() ? 1 : height;
+  const size_t row_size = width * block * (height / rows);
+  for (int n = 0; n < n_batch; n++) {
+    for (int g = 0; g < groups(); g++) {
+      for (int h = 0; h < rows; h++) {
+        T* dst_ptr = data + offset(n, g * block, h, 0);
+        for (size_t i = 0; i < row_size; i++) {
+          dst_ptr[i] = _v;
+        }
+      }
     }
   }
 }
 
 void RamTensor::fill(uint8_t v) {
-  for (int c = 0; c < channel; c++) {
-    uint8_t* dst_ptr = reinterpret_cast<uint8_t*>(data_ptr) +
-                       c * cstep * element_size;
-    memset(dst_ptr, v, height * width);
+  uint8_t* data = reinterpret_cast<uint8_t*>(data_ptr);
+  if (!wholeBlocks()) {
+    for (int n = 0; n < n_batch; n++)
+      for (int c = 0; c < channel; c++)
+        for (int h = 0; h < height; h++)
+          for (int w = 0; w < width; w++)
+            memset(data + offset(n, c, h, w) * element_size, v,
+                   element_size);
+    return;
+  }
+  const int rows = isContiguous() ? 1 : height;
+  const size_t row_size = width * block * (height / rows) * element_size;
+  for (int n = 0; n < n_batch; n++) {
+    for (int g = 0; g < groups(); g++) {
+      for (int h = 0; h < rows; h++)
+        memset(data + offset(n, g * block, h, 0) * element_size, v, row_size);
+    }
   }
 }
 
-inline RamTensor::sptr RamTensor::clone() const {
+RamTensor::sptr RamTensor::clone() const {
   if (empty())
     return create();
 
   RamTensor::sptr ts = std::make_shared<RamTensor>(
-      n_batch, width, height, channel, element_size);
-
+      n_batch, channel, height, width, element_size, alignment);
+  ts->setLayout(layout, block);
+  ts->data_type = data_type;
+  ts->setQuantizeParams(min_range, max_range, scale, zero_point);
+
+  if (parent_) {
+    // views are cloned packed
+    std::vector<uint8_t> dense(trueSize());
+    readData(dense.data(), dense.size());
+    ts->writeData(dense.data(), dense.size());
+    return ts;
+  }
+  ts->cstep = cstep;
   if (totalSize() > 0) {
     memcpy(ts->data_ptr, data_ptr, totalSize());
   }
@@ -227,62 +319,196 @@ inline RamTensor::sptr RamTensor::clone() const {
   return ts;
 }
 
+RamTensor::sptr RamTensor::view(RamTensor::sptr parent, int n0, int c0,
+                                int h0, int w0, int n, int c, int h, int w) {
+  if (!parent || n0 < 0 || c0 < 0 || h0 < 0 || w0 < 0 ||
+      n < 1 || c < 1 || h < 1 || w < 1 ||
+      n0 + n > parent->n_batch || c0 + c > parent->channel ||
+      h0 + h > parent->height || w0 + w > parent->width ||
+      (parent->layout == LAYOUT_NCXHWX && c0 % parent->block != 0))
+    throw std::runtime_error("RamTensor view region is wrong!");
+  RamTensor::sptr ts = std::make_shared<RamTensor>();
+  ts->n_batch = n;
+  ts->channel = c;
+  ts->height = h;
+  ts->width = w;
+  ts->element_size = parent->element_size;
+  ts->data_type = parent->data_type;
+  ts->cstep = parent->cstep;
+  ts->layout = parent->layout;
+  ts->block = parent->block;
+  ts->alignment = parent->alignment;
+  ts->setQuantizeParams(parent->min_range, parent->max_range, parent->scale,
+                        parent->zero_point);
+  ts->setName(parent->name);
+  // the steps of the parent, left packed where they match the view
+  const size_t row_step = parent->rowStep();
+  const size_t batch_step = parent->batchStep();
+  ts->hstep = row_step == ts->rowStep() ? 0 : row_step;
+  ts->nstep = batch_step == ts->batchStep() ? 0 : batch_step;
+  ts->data_ptr = parent->data_ptr == nullptr ? nullptr :
+      reinterpret_cast<uint8_t*>(parent->data_ptr) +
+      parent->offset(n0, c0, h0, w0) * parent->element_size;
+  ts->parent_ = parent->parent_ ? parent->parent_ : parent;
+  return ts;
+}
+
+RamTensor::sptr RamTensor::channels(RamTensor::sptr parent, int c0, int c) {
+  return view(parent, 0, c0, 0, 0, parent->n_batch, c, parent->height,
+              parent->width);
+}
+
+RamTensor::sptr RamTensor::crop(RamTensor::sptr parent, int h0, int w0,
+                                int h, int w) {
+  return view(parent, 0, 0, h0, w0, parent->n_batch, parent->channel, h, w);
+}
+
+bool RamTensor::wholeBlocks() const {
+  return layout == LAYOUT_NCHW || !parent_ || channel == parent_->channel;
+}
+
 void* RamTensor::tensorDataMalloc(size_t size) {
-  unsigned char* udata = (unsigned char*)malloc(size +
-                          sizeof(void*) + MALLOC_ALIGN);
-  if (!udata)
-    return 0;
-  unsigned char** adata = alignPtr((unsigned char**)udata + 1, MALLOC_ALIGN);
-  adata[-1] = udata;
-  return adata;
+  allocator_ = Allocator::getDefault();
+  void* data = allocator_->allocate(size, alignment);
+  if (!data)
+    throw std::runtime_error("RamTensor out of memory!");
+  return data;
 }
 
 void RamTensor::tensorDataFree() {
-  if (data_ptr) {
-    unsigned char* udata = ((unsigned char**)data_ptr)[-1];
-    free(udata);
-  }
+  if (data_ptr)
+    allocator_->deallocate(data_ptr);
+  allocator_ = nullptr;
 }
 
-void RamTensor::writeData(void* data, size_t size) {
-  if (size == trueSize() && data_ptr != nullptr)
-    memcpy(data_ptr, data, size);
-  else
-    throw std::runtime_error("RamTensor error in write data!");
+void RamTensor::setAlignment(size_t align) {
+  if (align == 0 || (align & (align - 1)) ||
+      (element_size > 0 && align % element_size != 0))
+    throw std::runtime_error("RamTensor alignment is wrong!");
+  alignment = align;
+  // planes of single channel tensors are aligned as well, so a batch of
+  // them and rows fetched by DMA start at an aligned address
+  if (element_size > 0)
+    cstep = alignSize(width * height * block * element_size, alignment) /
+            element_size;
 }
 
-template <typename T>
-  inline T* RamTensor::grepBatchData(int n) {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<T*>(data_ptr) +
-      n * channel * cstep * element_size;
+void RamTensor::setLayout(TensorLayout new_layout, int x) {
+  if (parent_)
+    throw std::runtime_error("RamTensor layout of a view is fixed!");
+  if (new_layout == LAYOUT_NCHW) {
+    x = 1;
+  } else if (new_layout == LAYOUT_NHWC) {
+    x = channel;
+  } else if (x <= 0) {
+    x = element_size > 0 ? static_cast<int>(VECTOR_ALIGN / element_size) : 1;
   }
+  layout = new_layout;
+  block = x;
+  setAlignment(alignment);
+  if (is_malloced && alignSize(totalSize(), 4) > malloced_size) {
+    tensorDataFree();
+    malloced_size = alignSize(totalSize(), 4);
+    data_ptr = tensorDataMalloc(malloced_size);
+  }
+}
 
-template <typename T>
-  inline T* RamTensor::grepChannelData(int n, int c) {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<T*>(data_ptr) +
-      (n * channel * cstep + c * cstep) * element_size;
+void RamTensor::copyElements(int n, uint8_t* dense, bool to_tensor) const {
+  uint8_t* data = reinterpret_cast<uint8_t*>(data_ptr);
+  if (layout == LAYOUT_NCHW) {
+    const size_t row_size = width * element_size;
+    for (int c = 0; c < channel; c++) {
+      for (int h = 0; h < height; h++) {
+        uint8_t* row = data + offset(n, c, h, 0) * element_size;
+        uint8_t* item = dense + (c * height + h) * row_size;
+        if (to_tensor)
+          memcpy(row, item, row_size);
+        else
+          memcpy(item, row, row_size);
+      }
+    }
+    return;
+  }
+  for (int c = 0; c < channel; c++) {
+    for (int h = 0; h < height; h++) {
+      for (int w = 0; w < width; w++) {
+        uint8_t* element = data + offset(n, c, h, w) * element_size;
+        uint8_t* item = dense + ((c * height + h) * width + w) * element_size;
+        if (to_tensor)
+          memcpy(element, item, element_size);
+        else
+          memcpy(item, element, element_size);
+      }
+    }
   }
+}
 
-template <typename T>
-  inline T* RamTensor::grepRowData(int n, int c, int h) {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<T*>(data_ptr) +
-      (n * channel * cstep + c * cstep + h * width) * element_size;
+void RamTensor::bindData(void* data) {
+  if (is_malloced) {
+    tensorDataFree();
+    is_malloced = false;
   }
+  data_ptr = data;
+}
 
-template <typename T>
-  inline T RamTensor::grepElement(int n, int c, int h, int w) {
-    assert(sizeof(T) == element_size);
-    return *(reinterpret_cast<T*>(data_ptr) +
-        (n * channel * cstep + c * cstep + h * width + w) * element_size);
+void RamTensor::allocateData() {
+  if (parent_)
+    throw std::runtime_error("RamTensor data of a view is not owned!");
+  if (is_malloced || totalSize() == 0)
+    return;
+  malloced_size = alignSize(totalSize(), 4);
+  data_ptr = tensorDataMalloc(malloced_size);
+  is_malloced = true;
+}
+
+void RamTensor::writeData(void* data, size_t size) {
+  if (size != trueSize() || data_ptr == nullptr)
+    throw std::runtime_error("RamTensor error in write data!");
+  const size_t item_size = size / n_batch;
+  for (int n = 0; n < n_batch; n++)
+    writeData(n, reinterpret_cast<uint8_t*>(data) + n * item_size, item_size);
+}
+
+void RamTensor::readData(void* data, size_t size) const {
+  if (size != trueSize() || data_ptr == nullptr)
+    throw std::runtime_error("RamTensor error in read data!");
+  const size_t item_size = size / n_batch;
+  for (int n = 0; n < n_batch; n++)
+    readData(n, reinterpret_cast<uint8_t*>(data) + n * item_size, item_size);
+}
+
+void RamTensor::writeData(int n, const void* data, size_t size) {
+  if (n < 0 || n >= n_batch || size * n_batch != trueSize() ||
+      data_ptr == nullptr)
+    throw std::runtime_error("RamTensor error in write data!");
+  const size_t surface_size = height * width * element_size;
+  if (layout != LAYOUT_NCHW || !isContiguous()) {
+    copyElements(n, const_cast<uint8_t*>(
+                 reinterpret_cast<const uint8_t*>(data)), true);
+    return;
+  }
+  for (int c = 0; c < channel; c++) {
+    memcpy(reinterpret_cast<uint8_t*>(data_ptr) +
+           (n * channel + c) * cstep * element_size,
+           reinterpret_cast<const uint8_t*>(data) + c * surface_size,
+           surface_size);
   }
+}
 
-template <typename T>
-  inline RamTensor::operator T*() {
-    assert(sizeof(T) == element_size);
-    return reinterpret_cast<T*>(data_ptr);
+void RamTensor::readData(int n, void* data, size_t size) const {
+  if (n < 0 || n >= n_batch || size * n_batch != trueSize() ||
+      data_ptr == nullptr)
+    throw std::runtime_error("RamTensor error in read data!");
+  const size_t surface_size = height * width * element_size;
+  if (layout != LAYOUT_NCHW || !isContiguous()) {
+    copyElements(n, reinterpret_cast<uint8_t*>(data), false);
+    return;
   }
+  for (int c = 0; c < channel; c++) {
+    memcpy(reinterpret_cast<uint8_t*>(data) + c * surface_size,
+           reinterpret_cast<const uint8_t*>(data_ptr) +
+           (n * channel + c) * cstep * element_size, surface_size);
+  }
+}
 
 }  // namespace RVTensor
@@ -0,0 +1,165 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "include/core/weight_stream.hpp"
+#include "include/core/weight_codec.hpp"
+
+namespace RVTensor {
+
+WeightStream::sptr WeightStream::create(FlashTensor::sptr weight,
+                                        int slot_num, int priority,
+                                        size_t stack_size) {
+  return std::make_shared<WeightStream>(weight, slot_num, priority,
+                                        stack_size);
+}
+
+WeightStream::WeightStream(FlashTensor::sptr weight, int slot_num,
+                           int priority, size_t stack_size)
+                          : weight_(weight), item_size_(0), block_num_(0),
+                            block_channels_(0), task_(nullptr), next_(-1),
+                            held_(-1) {
+  if (!weight_ || !weight_->isCompressed())
+    throw std::runtime_error("WeightStream needs compressed weights!");
+  const WeightCodecHeader* header = reinterpret_cast<const WeightCodecHeader*>(
+                                      weight_->compressed_data);
+  item_size_ = header->item_size;
+  block_num_ = static_cast<int>(header->block_num);
+  block_channels_ = static_cast<int>(header->block_channels);
+
+  if (block_num_ == 1) {
+    slots_.push_back(RamTensor::create(1, 1, 1,
+        static_cast<int>(header->raw_size), 1u, CACHE_LINE_ALIGN));
+    if (!decode(0, 0))
+      throw std::runtime_error("WeightStream block is broken!");
+    return;
+  }
+  if (slot_num < 2)
+    throw std::runtime_error("WeightStream needs 2 slots!");
+  // one extra entry in request_ for the stop request
+  request_ = Queue::create(2, sizeof(int));
+  free_ = Queue::create(slot_num, sizeof(int));
+  ready_ = Queue::create(slot_num, sizeof(int));
+  for (int slot = 0; slot < slot_num; slot++) {
+    slots_.push_back(RamTensor::create(1, 1, 1,
+        static_cast<int>(item_size_ * block_channels_), 1u,
+        CACHE_LINE_ALIGN));
+    free_->send(&slot);
+  }
+  task_ = Task::create("rvtensor_weights", decodeEntry, this, priority,
+                       stack_size);
+}
+
+WeightStream::~WeightStream() {
+  if (!task_)
+    return;
+  finish();
+  int stop = -1;
+  request_->send(&stop);
+  task_->join();
+}
+
+int WeightStream::blockNum() const {
+  return block_num_;
+}
+
+int WeightStream::blockChannels() const {
+  return block_channels_;
+}
+
+void WeightStream::start() {
+  finish();
+  next_ = 0;
+  if (task_) {
+    int pass = 0;
+    request_->send(&pass);
+  }
+}
+
+const uint8_t* WeightStream::acquire(int* c0, int* num) {
+  if (next_ < 0 || next_ >= block_num_ || held_ >= 0)
+    throw std::runtime_error("WeightStream acquire out of a pass!");
+  const int block = next_++;
+  const int slot = task_ ? receiveBlock() : 0;
+  if (slot < 0) {
+    held_ = -slot - 1;
+    release();
+    throw std::runtime_error("WeightStream block is broken!");
+  }
+  held_ = slot;
+  *c0 = block * block_channels_;
+  *num = (std::min)(block_channels_, weight_->n_batch - *c0);
+  return reinterpret_cast<const uint8_t*>(slots_[slot]->data_ptr);
+}
+
+void WeightStream::release() {
+  if (held_ < 0)
+    return;
+  if (task_)
+    free_->send(&held_);
+  held_ = -1;
+}
+
+bool WeightStream::decode(int block, int slot) {
+  const WeightCodecHeader* header = reinterpret_cast<const WeightCodecHeader*>(
+                                      weight_->compressed_data);
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(header + 1);
+  const uint8_t* src = weight_->compressed_data + offsets[block];
+  const size_t src_size = offsets[block + 1] - offsets[block];
+  const int c0 = block * block_channels_;
+  const size_t size = (std::min)(block_channels_, weight_->n_batch - c0) *
+                      item_size_;
+  uint8_t* dst = reinterpret_cast<uint8_t*>(slots_[slot]->data_ptr);
+  if (header->codec == WEIGHT_CODEC_RLE)
+    return decodeRle(src, src_size, dst, size);
+  if (src_size != size)
+    return false;
+  memcpy(dst, src, size);
+  return true;
+}
+
+int WeightStream::receiveBlock() {
+  int slot;
+  ready_->receive(&slot);
+  return slot;
+}
+
+void WeightStream::finish() {
+  release();
+  if (next_ < 0)
+    return;
+  for (; next_ < block_num_; next_++) {
+    if (!task_)
+      continue;
+    int slot = receiveBlock();
+    if (slot < 0)
+      slot = -slot - 1;
+    free_->send(&slot);
+  }
+  next_ = -1;
+}
+
+void WeightStream::decodeEntry(void* arg) {
+  WeightStream* stream = reinterpret_cast<WeightStream*>(arg);
+  while (true) {
+    int request;
+    stream->request_->receive(&request);
+    if (request < 0)
+      return;
+    for (int block = 0; block < stream->block_num_; block++) {
+      int slot;
+      stream->free_->receive(&slot);
+      if (!stream->decode(block, slot))
+        slot = -slot - 1;
+      stream->ready_->send(&slot);
+    }
+  }
+}
+
+}  // namespace RVTensor
@@ -0,0 +1,192 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "include/ops/activation.hpp"
+#include "include/ops/quantize_kernel.hpp"
+#include "include/ops/vector_kernel.hpp"
+
+namespace RVTensor {
+
+ActivationOp::sptr ActivationOp::create() {
+  return std::make_shared<ActivationOp>();
+}
+
+ActivationOp::sptr ActivationOp::create(ActivationParam param,
+                                        RamTensor::sptr input,
+                                        RamTensor::sptr output) {
+  ActivationOp::sptr ptr = std::make_shared<ActivationOp>(param, input,
+                                                          output);
+  ptr->checkOutputDims();
+  return ptr;
+}
+
+inline ActivationOp::ActivationOp() : Operation({}, {}),
+                                      param_({ACTIVATION_RELU, 0.f}) {
+  std::fill(lut_key_, lut_key_ + 4,
+            std::numeric_limits<float>::quiet_NaN());
+}
+
+inline ActivationOp::ActivationOp(ActivationParam param,
+                                  RamTensor::sptr input,
+                                  RamTensor::sptr output)
+  : Operation({input}, {output}), param_(param) {
+  std::fill(lut_key_, lut_key_ + 4,
+            std::numeric_limits<float>::quiet_NaN());
+}
+
+inline ActivationOp::~ActivationOp() {}
+
+inline void ActivationOp::checkOutputDims() {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  if (input->n_batch != output->n_batch ||
+      input->channel != output->channel ||
+      input->height != output->height ||
+      input->width != output->width) {
+    throw std::runtime_error(
+        "ActivationOp shape of input or output is wrong!");
+  }
+
+  if (input->layout != output->layout || input->block != output->block ||
+      !input->wholeBlocks() || !output->wholeBlocks()) {
+    throw std::runtime_error(
+        "ActivationOp layout of input or output is wrong!");
+  }
+
+  if (input->element_size != output->element_size ||
+      (input->element_size != 1 && input->element_size != 4)) {
+    throw std::runtime_error("ActivationOp unsupport element size!");
+  }
+
+  if (param_.type < ACTIVATION_RELU || param_.type > ACTIVATION_TANH) {
+    throw std::runtime_error("ActivationOp unsupport activation type!");
+  }
+
+  const DataType type = input->element_size == 1 ? UINT8 : FLOAT32;
+  input->setDataType(type);
+  output->setDataType(type);
+}
+
+inline float ActivationOp::apply(float x) const {
+  switch (param_.type) {
+    case ACTIVATION_RELU:
+      return x > 0.f ? x : 0.f;
+    case ACTIVATION_RELU6:
+      return x > 0.f ? (x < 6.f ? x : 6.f) : 0.f;
+    case ACTIVATION_LEAKY_RELU:
+      return x < 0.f ? param_.alpha * x : x;
+    case ACTIVATION_SIGMOID:
+      return 1.f / (1.f + std::exp(-x));
+    default:
+      return std::tanh(x);
+  }
+}
+
+inline void ActivationOp::range(float in_min, float in_max, float* min,
+                                float* max) const {
+  // the activations are monotonic on both sides of 0: the ends span the
+  // output, widened to cover 0 like every quantized range
+  *min = (std::min)({apply(in_min), apply(in_max), 0.f});
+  *max = (std::max)({apply(in_min), apply(in_max), 0.f});
+}
+
+void ActivationOp::updateLut() {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  const float lo = quantMin<uint8_t>(false);
+  const float hi = quantMax<uint8_t>();
+
+  if (output->scale == 0.f) {
+    float min, max;
+    range((lo - input->zero_point) * input->scale,
+          (hi - input->zero_point) * input->scale, &min, &max);
+    const float scale = (max - min) / (hi - lo);
+    const int32_t zero_point = scale == 0.f ? 0 :
+        static_cast<int32_t>(std::lrint((std::min)(hi, lo - min / scale)));
+    output->setQuantizeParams(min, max, scale, zero_point);
+  }
+
+  const float key[4] = {input->scale, static_cast<float>(input->zero_point),
+                        output->scale,
+                        static_cast<float>(output->zero_point)};
+  if (std::equal(key, key + 4, lut_key_))
+    return;
+  const float inverse_scale = output->scale == 0.f ? 0.f
+                              : 1.f / output->scale;
+  for (int q = 0; q < 256; q++) {
+    const float x = (q - input->zero_point) * input->scale;
+    lut_[q] = saturateCast<uint8_t>(
+        std::fma(apply(x), inverse_scale,
+                 static_cast<float>(output->zero_point)), lo, hi);
+  }
+  std::copy(key, key + 4, lut_key_);
+}
+
+inline void ActivationOp::forward_compute() {
+  forwardRows(0, getInputs()[0]->height);
+}
+
+bool ActivationOp::supportsRows() {
+  return true;
+}
+
+void ActivationOp::inputRows(int h0, int h1, int* begin, int* end) {
+  *begin = h0;
+  *end = h1;
+}
+
+void ActivationOp::forwardRows(int h0, int h1) {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  const bool quantized = input->element_size == 1;
+  if (quantized) {
+    updateLut();
+  } else {
+    float min, max;
+    range(input->min_range, input->max_range, &min, &max);
+    output->setQuantizeRange(min, max);
+  }
+
+  if (h0 >= h1)
+    return;
+  // the rows of packed planes are a single row
+  const bool packed = input->isContiguous() && output->isContiguous();
+  const int rows = packed ? h1 - h0 : 1;
+  const size_t row_size = input->width * input->block * rows;
+  const float inf = std::numeric_limits<float>::infinity();
+  for (int n = 0; n < input->n_batch; n++) {
+    for (int g = 0; g < input->groups(); g++) {
+      const int c = g * input->block;
+      for (int h = h0; h < h1; h += rows) {
+        const size_t in = input->offset(n, c, h, 0);
+        const size_t out = output->offset(n, c, h, 0);
+        if (quantized) {
+          lutKernel(lut_, reinterpret_cast<uint8_t *>(input->data_ptr) + in,
+                    reinterpret_cast<uint8_t *>(output->data_ptr) + out,
+                    row_size);
+          continue;
+        }
+        const float* src = reinterpret_cast<float *>(input->data_ptr) + in;
+        float* dst = reinterpret_cast<float *>(output->data_ptr) + out;
+        if (param_.type == ACTIVATION_RELU) {
+          clampKernel(src, dst, row_size, 0.f, inf);
+        } else if (param_.type == ACTIVATION_RELU6) {
+          clampKernel(src, dst, row_size, 0.f, 6.f);
+        } else {
+          for (size_t i = 0; i < row_size; i++)
+            dst[i] = apply(src[i]);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace RVTensor
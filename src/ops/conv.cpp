@@ -5,10 +5,27 @@
  *
  */
 
+#include <sys/time.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 #include "include/ops/conv.hpp"
+#include "include/ops/conv_tuner.hpp"
+#include "include/ops/half_kernel.hpp"
+#include "include/ops/int4_kernel.hpp"
+#include "include/ops/quantize_kernel.hpp"
+#include "include/ops/vector_kernel.hpp"
 
 namespace RVTensor {
 
+/// tiles tried by the tuner: output channels of the rows algorithm,
+/// pixels of the GEMM panels
+static const int kConvRowsTiles[] = {1, 4, 8, 16};
+static const int kConvGemmTiles[] = {32, 64, 128, 256};
+
 CPUConvOp::sptr CPUConvOp::create() {
   return std::make_shared<CPUConvOp>();
 }
@@ -24,13 +41,19 @@ CPUConvOp::sptr CPUConvOp::create(ConvParam conv_param, RamTensor::sptr input,
 
 inline CPUConvOp::CPUConvOp() : Operation({}, {}),
                                 param_({0, 0, 1, 1, 0, 0, false}),
-                                weight_(nullptr), bias_(nullptr) {}
+                                weight_(nullptr), bias_(nullptr),
+                                stream_(nullptr), block_output_(nullptr),
+                                tuning_({CONV_ALGO_DEFAULT, 0}),
+                                tuning_resolved_(false) {}
 
 inline CPUConvOp::CPUConvOp(ConvParam conv_param, RamTensor::sptr input,
                             RamTensor::sptr output, FlashTensor::sptr weight,
                             FlashTensor::sptr bias)
                           : Operation({input}, {output}), param_(conv_param),
-                            weight_(weight), bias_(bias) {}
+                            weight_(weight), bias_(bias), stream_(nullptr),
+                            block_output_(nullptr),
+                            tuning_({CONV_ALGO_DEFAULT, 0}),
+                            tuning_resolved_(false) {}
 
 inline CPUConvOp::~CPUConvOp() {}
 
@@ -41,6 +64,31 @@ inline void CPUConvOp::checkOutputDims() {
     throw std::runtime_error("CPUConvOp channel of input is wrong!");
   }
 
+  const bool half = weight_->data_type == DataType::FLOAT16;
+  const bool int4 = weight_->data_type == DataType::INT4;
+  // compressed blocks would be channel views that split the NCxHWx blocks
+  if (input->layout != output->layout ||
+      (input->layout == LAYOUT_NHWC && (!isPointwise() || half || int4)) ||
+      (input->layout == LAYOUT_NCXHWX &&
+       (half || int4 || weight_->isCompressed()))) {
+    throw std::runtime_error("CPUConvOp unsupport layout!");
+  }
+
+  if (half && (input->element_size != 2 ||
+      (output->element_size != 2 && output->element_size != 4))) {
+    throw std::runtime_error("CPUConvOp float16 input or output is wrong!");
+  }
+
+  if (int4 && input->element_size != 1) {
+    throw std::runtime_error("CPUConvOp int4 weight needs uint8 input!");
+  }
+
+  // the integer kernels read the input as asymmetric uint8
+  if (!half && (input->element_size != 1 ||
+      input->data_type != DataType::UINT8)) {
+    throw std::runtime_error("CPUConvOp input needs uint8 data!");
+  }
+
   int input_h = input->height + param_.ph;
   int input_w = input->width + param_.pw;
   int kh = param_.dh > 1 ? (weight_->height - 1) * param_.dh + 1
@@ -65,25 +113,241 @@ inline void CPUConvOp::checkOutputDims() {
   }
 }
 
+inline bool CPUConvOp::isPointwise() const {
+  return weight_->height == 1 && weight_->width == 1 &&
+         param_.sh == 1 && param_.sw == 1 && param_.dh == 1 &&
+         param_.dw == 1 && param_.ph == 0 && param_.pw == 0;
+}
+
+inline bool CPUConvOp::isGemm() {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  return isPointwise() && input->layout == LAYOUT_NCHW &&
+         input->rowStep() == static_cast<size_t>(input->width) &&
+         output->rowStep() == static_cast<size_t>(output->width);
+}
+
 inline void CPUConvOp::forward_compute() {
+  if (weight_->isCompressed()) {
+    forwardBlocks();
+    return;
+  }
+  if (weight_->data_type == DataType::FLOAT16)
+    getOutputs()[0]->element_size == 2 ? convolveHalf<uint16_t>()
+                                       : convolveHalf<float>();
+  else if (weight_->data_type == DataType::INT4)
+    convolveInt4();
+  else
+    forwardRows(0, getOutputs()[0]->height);
+}
+
+bool CPUConvOp::supportsRows() {
+  return !weight_->isCompressed() &&
+         (weight_->data_type == DataType::UINT8 ||
+          weight_->data_type == DataType::INT8);
+}
+
+void CPUConvOp::inputRows(int h0, int h1, int* begin, int* end) {
+  const int hi = getInputs()[0]->height;
+  const int kh = (weight_->height - 1) * param_.dh + 1;
+  *begin = (std::min)((std::max)(h0 * param_.sh - param_.ph / 2, 0), hi);
+  *end = (std::max)((std::min)((h1 - 1) * param_.sh - param_.ph / 2 + kh,
+                               hi), *begin);
+}
+
+void CPUConvOp::forwardRows(int h0, int h1) {
+  if (!tuning_resolved_)
+    resolveTuning(h0, h1);
+  const TensorLayout layout = getInputs()[0]->layout;
+  if (weight_->data_type == DataType::INT8) {
+    if (layout == LAYOUT_NHWC)
+      pointwise<int8_t>(h0, h1);
+    else if (layout == LAYOUT_NCXHWX)
+      convolveBlocked<int8_t>(h0, h1);
+    else
+      convolveTuned<int8_t>(h0, h1);
+  } else if (weight_->data_type == DataType::UINT8) {
+    if (layout == LAYOUT_NHWC)
+      pointwise<uint8_t>(h0, h1);
+    else if (layout == LAYOUT_NCXHWX)
+      convolveBlocked<uint8_t>(h0, h1);
+    else
+      convolveTuned<uint8_t>(h0, h1);
+  } else {
+    throw std::runtime_error("CPUConvOp unsupport weight data type!");
+  }
+}
+
+void CPUConvOp::setTuning(ConvTuning tuning) {
+  tuning_ = tuning;
+  tuning_resolved_ = false;
+}
+
+ConvTuning CPUConvOp::getTuning() const {
+  return tuning_;
+}
+
+std::vector<ConvTuning> CPUConvOp::tunings() {
+  std::vector<ConvTuning> candidates;
+  if (weight_->isCompressed() || getInputs()[0]->layout != LAYOUT_NCHW ||
+      (weight_->data_type != DataType::UINT8 &&
+       weight_->data_type != DataType::INT8)) {
+    return candidates;
+  }
+  const int co = weight_->n_batch;
+  const int pixels = getInputs()[0]->height * getInputs()[0]->width;
+  candidates.push_back({CONV_ALGO_DIRECT, 0});
+  for (int tile : kConvRowsTiles) {
+    // larger tiles than the channels run the same as the last one
+    if (tile == 1 || tile / 2 < co)
+      candidates.push_back({CONV_ALGO_ROWS, tile});
+  }
+  if (isGemm()) {
+    for (int tile : kConvGemmTiles) {
+      if (tile == kConvGemmTiles[0] || tile / 2 < pixels)
+        candidates.push_back({CONV_ALGO_GEMM, tile});
+    }
+  }
+  return candidates;
+}
+
+std::string CPUConvOp::tuningKey() {
+  auto input = getInputs()[0];
+  return convTuningKey(weight_->data_type, input->channel, input->height,
+                       input->width, weight_->n_batch, weight_->height,
+                       weight_->width, param_);
+}
+
+void CPUConvOp::resolveTuning(int h0, int h1) {
+  tuning_resolved_ = true;
+  const std::vector<ConvTuning> candidates = tunings();
+  if (candidates.size() < 2) {
+    tuning_ = {CONV_ALGO_DEFAULT, 0};
+    return;
+  }
+
+  ConvTuner& tuner = ConvTuner::instance();
+  const std::string key = tuningKey();
+  if (tuning_.algorithm == CONV_ALGO_DEFAULT && !tuner.find(key, &tuning_) &&
+      tuner.isTuning()) {
+    tuning_ = benchmark(candidates, tuner.repeat(), h0, h1);
+    tuner.insert(key, tuning_);
+  }
+  // set or cached tunings of other shapes (strided planes) may not fit
+  bool applicable = tuning_.algorithm == CONV_ALGO_DIRECT;
+  if (tuning_.algorithm == CONV_ALGO_ROWS)
+    applicable = tuning_.tile > 0;
+  else if (tuning_.algorithm == CONV_ALGO_GEMM)
+    applicable = tuning_.tile > 0 && isGemm();
+  if (!applicable)
+    tuning_ = {CONV_ALGO_DEFAULT, 0};
+}
+
+/**
+ * wall clock in microseconds
+ */
+static inline uint64_t tunerClock() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000u + tv.tv_usec;
+}
+
+ConvTuning CPUConvOp::benchmark(const std::vector<ConvTuning>& candidates,
+                                int repeat, int h0, int h1) {
+  ConvTuning best = candidates[0];
+  uint64_t best_time = UINT64_MAX;
+  for (const ConvTuning& candidate : candidates) {
+    tuning_ = candidate;
+    // the first run warms up the caches and the weights
+    forwardRows(h0, h1);
+    const uint64_t start = tunerClock();
+    for (int r = 0; r < repeat; r++)
+      forwardRows(h0, h1);
+    const uint64_t time = tunerClock() - start;
+    if (time < best_time) {
+      best = candidate;
+      best_time = time;
+    }
+  }
+  return best;
+}
+
+template<typename WT>
+void CPUConvOp::convolveTuned(int h0, int h1) {
+  switch (tuning_.algorithm) {
+    case CONV_ALGO_ROWS:
+      convolveRows<WT>(tuning_.tile, h0, h1);
+      break;
+    case CONV_ALGO_GEMM:
+      convolveGemm<WT>(tuning_.tile, h0, h1);
+      break;
+    default:
+      convolve<WT>(h0, h1);
+  }
+}
+
+void CPUConvOp::forwardBlocks() {
+  if (!stream_)
+    stream_ = WeightStream::create(weight_);
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  // the channel views of the output are stale once it is rebound
+  if (block_output_ != output->data_ptr) {
+    block_ops_.clear();
+    block_weights_.clear();
+    block_output_ = output->data_ptr;
+  }
+
+  stream_->start();
+  for (int b = 0; b < stream_->blockNum(); b++) {
+    int c0, num;
+    uint8_t* data = const_cast<uint8_t*>(stream_->acquire(&c0, &num));
+    if (block_ops_.size() <= static_cast<size_t>(b)) {
+      FlashTensor::sptr weight = FlashTensor::create(num, weight_->channel,
+          weight_->height, weight_->width, data, weight_->element_size);
+      weight->setDataType(weight_->data_type);
+      weight->setQuantizer(weight_->scale, weight_->zero_point);
+      if (weight_->channel_scales)
+        weight->bindChannelScales(weight_->channel_scales + c0, num);
+      FlashTensor::sptr bias = nullptr;
+      if (bias_) {
+        bias = FlashTensor::create(num, 1, 1, 1,
+            reinterpret_cast<uint8_t*>(bias_->data_ptr) +
+            c0 * bias_->element_size, bias_->element_size);
+        bias->setDataType(bias_->data_type);
+        bias->setQuantizer(bias_->scale, bias_->zero_point);
+      }
+      block_weights_.push_back(weight);
+      block_ops_.push_back(CPUConvOp::create(param_, input,
+          RamTensor::channels(output, c0, num), weight, bias));
+    }
+    // a block is decoded into a different buffer on every pass
+    block_weights_[b]->data_ptr = data;
+    block_ops_[b]->forward_compute();
+    stream_->release();
+  }
+}
+
+template<typename WT>
+void CPUConvOp::convolve(int h0, int h1) {
   auto input_tensor = getInputs()[0];
   auto output_tensor = getOutputs()[0];
 
   uint8_t* input = reinterpret_cast<uint8_t *>(input_tensor->data_ptr);
-  uint8_t* output = reinterpret_cast<uint8_t *>(output_tensor->data_ptr);
-  uint8_t* weight = reinterpret_cast<uint8_t *>(weight_->data_ptr);
-  uint8_t* bias = bias_ ?
-                    reinterpret_cast<uint8_t *>(bias_->data_ptr) : nullptr;
+  WT* weight = reinterpret_cast<WT *>(weight_->data_ptr);
 
   int ni = input_tensor->n_batch;
   int ci = input_tensor->channel;
   int hi = input_tensor->height;
   int wi = input_tensor->width;
   int stepi = input_tensor->cstep;
+  int hstepi = input_tensor->rowStep();
+  int nstepi = input_tensor->batchStep();
   int co = output_tensor->channel;
-  int ho = output_tensor->height;
   int wo = output_tensor->width;
   int stepo = output_tensor->cstep;
+  int hstepo = output_tensor->rowStep();
+  int nstepo = output_tensor->batchStep();
   int sh = param_.sh;
   int sw = param_.sw;
   int kh = weight_->height;
@@ -93,37 +357,53 @@ inline void CPUConvOp::forward_compute() {
   int ph = param_.ph;
   int pw = param_.pw;
 
-  uint8_t* temp_weight = nullptr;
-  int x = 0, y = 0;
+  const int32_t input_offset = input_tensor->zero_point;
+  // symmetric (signed) weights have no zero point, which lets the compiler
+  // drop the weight offset subtraction from the inner loop
+  const int32_t weight_offset = std::is_signed<WT>::value ? 0
+                                : weight_->zero_point;
+
+  const WT* temp_weight = weight;
   if (dh > 1 || dw > 1) {
     kh = (kh - 1) * dh + 1;
     kw = (kw - 1) * dw + 1;
-    temp_weight = reinterpret_cast<uint8_t *>(
-                   malloc(sizeof(uint8_t) * kw * kh * ci * co));
-    x = -1;
-    y = -1;
-    for (int coi = 0; coi < co; coi++) {
-      for (int cii = 0; cii < ci; cii++) {
-        for (int khi = 0; khi < kh; khi++) {
-          for (int kwi = 0; kwi < kw; kwi++) {
-            x++;
-            if (khi % dh != 0 || kwi % dw != 0) {
-              temp_weight[x] = 0;
-            } else {
-              y++;
-              temp_weight[x] = weight[y];
+    // expanded once, not by every band of rows
+    const size_t size = sizeof(WT) * kw * kh * ci * co;
+    if (dilated_weight_.size() != size) {
+      dilated_weight_.resize(size);
+      WT* dilated = reinterpret_cast<WT*>(dilated_weight_.data());
+      int x = -1, y = -1;
+      for (int coi = 0; coi < co; coi++) {
+        for (int cii = 0; cii < ci; cii++) {
+          for (int khi = 0; khi < kh; khi++) {
+            for (int kwi = 0; kwi < kw; kwi++) {
+              x++;
+              if (khi % dh != 0 || kwi % dw != 0) {
+                dilated[x] = weight_offset;
+              } else {
+                y++;
+                dilated[x] = weight[y];
+              }
             }
           }
         }
       }
     }
-  } else {
-    temp_weight = weight;
+    temp_weight = reinterpret_cast<const WT*>(dilated_weight_.data());
   }
 
+  // int32 accumulators of one output row, consumed by the epilogue
+  std::vector<int32_t> acc_row(wo);
+
+  // real value of one accumulator step, per output channel
+  std::vector<float> acc_scales(co);
+  for (int coo = 0; coo < co; coo++)
+    acc_scales[coo] = input_tensor->scale * weight_->channelScale(coo);
+
   for (int n = 0; n < ni; n++) {
     for (int coo = 0; coo < co; coo++) {
-      for (int hoo = 0; hoo < ho; hoo++) {
+      int32_t bias_val = biasValue(coo);
+      for (int hoo = h0; hoo < h1; hoo++) {
         for (int woo = 0; woo < wo; woo++) {
           int start_w = sw * woo - pw / 2;
           int start_h = sh * hoo - ph / 2;
@@ -137,27 +417,551 @@ inline void CPUConvOp::forward_compute() {
           int kernel_shift_dh = (rem_dh > 0) ? dh - rem_dh : 0;
           start_w = (std::max)(start_w, kernel_shift_dw);
           start_h = (std::max)(start_h, kernel_shift_dh);
-          output[n * co * stepo + coo * stepo + hoo * wo + woo] = 0;
+          // taps of a kernel row are dw apart in the input and in the
+          // (dilated) weights
+          const int taps = end_w > start_w ? (end_w - start_w + dw - 1) / dw
+                           : 0;
+          int32_t acc = bias_val;
           for (int cii = 0; cii < ci; cii++) {
             for (int h = start_h; h < end_h; h += dh) {
-              for (int w = start_w; w < end_w; w += dw) {
-                output[n * co * stepo + coo * stepo + hoo * wo + woo] +=
-                  input[n * ci *  stepi + cii *  stepi + h * wi + w] *
-                  temp_weight[coo * ci * kh * kw + cii * kh * kw +
+              acc += dotKernel(
+                  input + n * nstepi + cii * stepi + h * hstepi + start_w,
+                  temp_weight + coo * ci * kh * kw + cii * kh * kw +
                   (kernel_shift_h + kernel_shift_dh + h - start_h) * kw +
-                  (kernel_shift_w + kernel_shift_dw + w - start_w)];
+                  kernel_shift_w + kernel_shift_dw, taps, dw, input_offset,
+                  weight_offset);
+            }
+          }
+          acc_row[woo] = acc;
+        }
+        epilogue(acc_row.data(), acc_scales[coo],
+                 n * nstepo + coo * stepo + hoo * hstepo, wo);
+      }
+    }
+  }
+}
+
+template<typename WT>
+void CPUConvOp::convolveRows(int tile, int h0, int h1) {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+
+  const uint8_t* input = reinterpret_cast<uint8_t *>(input_tensor->data_ptr);
+  const WT* weight = reinterpret_cast<WT *>(weight_->data_ptr);
+
+  const int ni = input_tensor->n_batch;
+  const int ci = input_tensor->channel;
+  const int hi = input_tensor->height;
+  const int wi = input_tensor->width;
+  const int co = output_tensor->channel;
+  const int wo = output_tensor->width;
+  const int kh = weight_->height;
+  const int kw = weight_->width;
+  const int sh = param_.sh;
+  const int sw = param_.sw;
+  const int32_t input_offset = input_tensor->zero_point;
+  const int32_t weight_offset = std::is_signed<WT>::value ? 0
+                                : weight_->zero_point;
+
+  std::vector<float> acc_scales(co);
+  for (int coo = 0; coo < co; coo++)
+    acc_scales[coo] = input_tensor->scale * weight_->channelScale(coo);
+
+  // output rows of tile channels, the input rows are read once per tile
+  std::vector<int32_t> acc(static_cast<size_t>(tile) * wo);
+  for (int n = 0; n < ni; n++) {
+    for (int c0 = 0; c0 < co; c0 += tile) {
+      const int num = (std::min)(tile, co - c0);
+      for (int hoo = h0; hoo < h1; hoo++) {
+        for (int j = 0; j < num; j++)
+          std::fill(&acc[j * wo], &acc[j * wo] + wo, biasValue(c0 + j));
+        const int start_h = sh * hoo - param_.ph / 2;
+        for (int y = 0; y < kh; y++) {
+          const int h = start_h + y * param_.dh;
+          if (h < 0 || h >= hi)
+            continue;
+          for (int k = 0; k < kw; k++) {
+            // output columns whose tap k lands inside the input row
+            const int shift = k * param_.dw - param_.pw / 2;
+            if (shift >= wi)
+              continue;
+            const int lo = shift >= 0 ? 0 : (-shift + sw - 1) / sw;
+            const int hi_w = (std::min)(wo, (wi - 1 - shift) / sw + 1);
+            if (lo >= hi_w)
+              continue;
+            for (int cii = 0; cii < ci; cii++) {
+              const uint8_t* x = input + input_tensor->offset(n, cii, h, 0) +
+                                 sw * lo + shift;
+              const WT* w = weight + (cii * kh + y) * kw + k;
+              for (int j = 0; j < num; j++) {
+                macRowKernel(&acc[j * wo] + lo, x, sw,
+                             w[(c0 + j) * ci * kh * kw] - weight_offset,
+                             input_offset, hi_w - lo);
+              }
+            }
+          }
+        }
+        for (int j = 0; j < num; j++) {
+          epilogue(&acc[j * wo], acc_scales[c0 + j],
+                   output_tensor->offset(n, c0 + j, hoo, 0), wo);
+        }
+      }
+    }
+  }
+}
+
+template<typename WT>
+void CPUConvOp::convolveGemm(int tile, int h0, int h1) {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+
+  const uint8_t* input = reinterpret_cast<uint8_t *>(input_tensor->data_ptr);
+  const WT* weight = reinterpret_cast<WT *>(weight_->data_ptr);
+
+  const int ni = input_tensor->n_batch;
+  const int ci = input_tensor->channel;
+  const int co = output_tensor->channel;
+  // pointwise: output rows [h0, h1) are the same pixels of the input
+  const int first = h0 * input_tensor->width;
+  const int pixels = h1 * input_tensor->width;
+  const size_t ldb = input_tensor->cstep;
+  const int32_t input_offset = input_tensor->zero_point;
+  const int32_t weight_offset = std::is_signed<WT>::value ? 0
+                                : weight_->zero_point;
+
+  // sum((x - xo) * w') = sum(x * w') - xo * sum(w') with w' = w - wo, the
+  // constant part (bias included) starts the accumulators
+  std::vector<int32_t> w(static_cast<size_t>(co) * ci);
+  std::vector<int32_t> acc_base(co);
+  std::vector<float> acc_scales(co);
+  for (int coo = 0; coo < co; coo++) {
+    int32_t weight_sum = 0;
+    for (int cii = 0; cii < ci; cii++) {
+      w[coo * ci + cii] = weight[coo * ci + cii] - weight_offset;
+      weight_sum += w[coo * ci + cii];
+    }
+    acc_base[coo] = biasValue(coo) - input_offset * weight_sum;
+    acc_scales[coo] = input_tensor->scale * weight_->channelScale(coo);
+  }
+
+  std::vector<int32_t> acc(tile);
+  for (int n = 0; n < ni; n++) {
+    const uint8_t* b = input + input_tensor->offset(n, 0, 0, 0);
+    for (int p0 = first; p0 < pixels; p0 += tile) {
+      // the panel of ci x num pixels stays in cache for all channels
+      const int num = (std::min)(tile, pixels - p0);
+      for (int coo = 0; coo < co; coo++) {
+        const int32_t* a = &w[coo * ci];
+        std::fill(acc.begin(), acc.begin() + num, acc_base[coo]);
+        int k = 0;
+        for (; k + 1 < ci; k += 2) {
+          macRow2Kernel(acc.data(), b + k * ldb + p0, a[k],
+                        b + (k + 1) * ldb + p0, a[k + 1], num);
+        }
+        if (k < ci)
+          macRowKernel(acc.data(), b + k * ldb + p0, 1, a[k], 0, num);
+        epilogue(acc.data(), acc_scales[coo],
+                 output_tensor->offset(n, coo, 0, 0) + p0, num);
+      }
+    }
+  }
+}
+
+template<typename WT>
+void CPUConvOp::pointwise(int h0, int h1) {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+
+  const uint8_t* input = reinterpret_cast<uint8_t *>(input_tensor->data_ptr);
+  const WT* weight = reinterpret_cast<WT *>(weight_->data_ptr);
+
+  const int ni = input_tensor->n_batch;
+  const int ci = input_tensor->channel;
+  const int co = output_tensor->channel;
+  const int width = input_tensor->width;
+  // pixels are block elements apart, channel views use part of the block
+  const int bi = input_tensor->block;
+  const int bo = output_tensor->block;
+
+  const int32_t input_offset = input_tensor->zero_point;
+  const int32_t weight_offset = std::is_signed<WT>::value ? 0
+                                : weight_->zero_point;
+
+  // sum((x - xo) * (w - wo)) = sum(x * w) - wo * sum(x) + const, the
+  // constant part (bias included) is folded per output channel so the
+  // inner loop is a plain dot product
+  std::vector<int32_t> acc_base(co);
+  std::vector<float> acc_scales(co);
+  for (int coo = 0; coo < co; coo++) {
+    int32_t weight_sum = 0;
+    for (int cii = 0; cii < ci; cii++)
+      weight_sum += weight[coo * ci + cii];
+    acc_base[coo] = biasValue(coo) - input_offset * weight_sum +
+                    ci * input_offset * weight_offset;
+    acc_scales[coo] = input_tensor->scale * weight_->channelScale(coo);
+  }
+
+  const bool quantized = output_tensor->element_size == 1;
+  if (!quantized && output_tensor->element_size != 4)
+    throw std::runtime_error("CPUConvOp unsupport output element size!");
+  std::vector<float> multipliers(co);
+  for (int coo = 0; coo < co; coo++)
+    multipliers[coo] = output_tensor->scale == 0.f ? 0.f
+                       : acc_scales[coo] / output_tensor->scale;
+  const float zero = static_cast<float>(output_tensor->zero_point);
+  const float lo = quantMin<uint8_t>(false);
+  const float hi = quantMax<uint8_t>();
+
+  for (int n = 0; n < ni; n++) {
+    for (int p = h0 * width; p < h1 * width; p++) {
+      const int h = p / width;
+      const int w = p % width;
+      const uint8_t* x = input + input_tensor->offset(n, 0, h, 0) + w * bi;
+      int32_t x_sum = 0;
+      for (int cii = 0; cii < ci; cii++)
+        x_sum += x[cii];
+      const size_t offset = output_tensor->offset(n, 0, h, 0) + w * bo;
+      for (int coo = 0; coo < co; coo++) {
+        const WT* w = weight + coo * ci;
+        const int32_t acc = acc_base[coo] - weight_offset * x_sum +
+                            dotKernel(x, w, ci, 1, 0, 0);
+        if (quantized) {
+          reinterpret_cast<uint8_t *>(output_tensor->data_ptr)[offset + coo] =
+              saturateCast<uint8_t>(std::fma(static_cast<float>(acc),
+                                    multipliers[coo], zero), lo, hi);
+        } else {
+          reinterpret_cast<float *>(output_tensor->data_ptr)[offset + coo] =
+              static_cast<float>(acc) * acc_scales[coo];
+        }
+      }
+    }
+  }
+}
+
+template<typename WT>
+void CPUConvOp::convolveBlocked(int h0, int h1) {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+
+  const uint8_t* input = reinterpret_cast<uint8_t *>(input_tensor->data_ptr);
+  const WT* weight = reinterpret_cast<WT *>(weight_->data_ptr);
+
+  const int ni = input_tensor->n_batch;
+  const int ci = input_tensor->channel;
+  const int hi = input_tensor->height;
+  const int wi = input_tensor->width;
+  const int co = output_tensor->channel;
+  const int wo = output_tensor->width;
+  const int kh = weight_->height;
+  const int kw = weight_->width;
+  const int sh = param_.sh;
+  const int sw = param_.sw;
+  // pixels are block elements apart, a block of output channels is the
+  // lanes of the accumulators
+  const int bi = input_tensor->block;
+  const int lanes = output_tensor->block;
+  const int groups = output_tensor->groups();
+  const int32_t input_offset = input_tensor->zero_point;
+  const int32_t weight_offset = std::is_signed<WT>::value ? 0
+                                : weight_->zero_point;
+
+  const size_t taps = static_cast<size_t>(ci) * kh * kw;
+  if (blocked_weight_.size() != taps * groups * lanes) {
+    // padding lanes get zero weights, their accumulators stay 0
+    blocked_weight_.assign(taps * groups * lanes, 0);
+    for (int coo = 0; coo < co; coo++) {
+      for (size_t t = 0; t < taps; t++) {
+        blocked_weight_[((coo / lanes) * taps + t) * lanes + coo % lanes] =
+            static_cast<int16_t>(weight[coo * taps + t] - weight_offset);
+      }
+    }
+  }
+
+  const bool quantized = output_tensor->element_size == 1;
+  if (!quantized && output_tensor->element_size != 4)
+    throw std::runtime_error("CPUConvOp unsupport output element size!");
+  std::vector<int32_t> bias(static_cast<size_t>(groups) * lanes, 0);
+  std::vector<float> acc_scales(bias.size(), 0.f);
+  std::vector<float> multipliers(bias.size(), 0.f);
+  for (int coo = 0; coo < co; coo++) {
+    bias[coo] = biasValue(coo);
+    acc_scales[coo] = input_tensor->scale * weight_->channelScale(coo);
+    multipliers[coo] = output_tensor->scale == 0.f ? 0.f
+                       : acc_scales[coo] / output_tensor->scale;
+  }
+  const float zero = static_cast<float>(output_tensor->zero_point);
+  const float q_min = quantMin<uint8_t>(false);
+  const float q_max = quantMax<uint8_t>();
+
+  std::vector<int32_t> acc(static_cast<size_t>(wo) * lanes);
+  for (int n = 0; n < ni; n++) {
+    for (int g = 0; g < groups; g++) {
+      const int c0 = g * lanes;
+      // channel views share their last block with channels of the parent
+      const int stored = output_tensor->wholeBlocks() ? lanes
+                         : (std::min)(lanes, co - c0);
+      for (int hoo = h0; hoo < h1; hoo++) {
+        for (int woo = 0; woo < wo; woo++)
+          std::copy(&bias[c0], &bias[c0] + lanes, &acc[woo * lanes]);
+        const int start_h = sh * hoo - param_.ph / 2;
+        for (int y = 0; y < kh; y++) {
+          const int h = start_h + y * param_.dh;
+          if (h < 0 || h >= hi)
+            continue;
+          for (int k = 0; k < kw; k++) {
+            // output columns whose tap k lands inside the input row
+            const int shift = k * param_.dw - param_.pw / 2;
+            if (shift >= wi)
+              continue;
+            const int lo = shift >= 0 ? 0 : (-shift + sw - 1) / sw;
+            const int hi_w = (std::min)(wo, (wi - 1 - shift) / sw + 1);
+            for (int cii = 0; cii < ci; cii++) {
+              const uint8_t* x = input + input_tensor->offset(n, cii, h, 0) +
+                                 static_cast<size_t>(sw * lo + shift) * bi;
+              const int16_t* w = &blocked_weight_[
+                  ((g * taps) + (cii * kh + y) * kw + k) * lanes];
+              int32_t* a = &acc[lo * lanes];
+              for (int woo = lo; woo < hi_w; woo++) {
+                const int32_t v = *x - input_offset;
+                for (int l = 0; l < lanes; l++)
+                  a[l] += v * w[l];
+                x += sw * bi;
+                a += lanes;
               }
             }
           }
-          if (bias != nullptr) {
-            output[n * co * stepo + coo * stepo + hoo * wo + woo] += bias[coo];
+        }
+        const size_t offset = output_tensor->offset(n, c0, hoo, 0);
+        for (int woo = 0; woo < wo; woo++) {
+          const int32_t* a = &acc[woo * lanes];
+          if (quantized) {
+            uint8_t* dst = reinterpret_cast<uint8_t *>(
+                             output_tensor->data_ptr) + offset + woo * lanes;
+            for (int l = 0; l < stored; l++) {
+              dst[l] = saturateCast<uint8_t>(std::fma(static_cast<float>(a[l]),
+                                             multipliers[c0 + l], zero),
+                                             q_min, q_max);
+            }
+          } else {
+            float* dst = reinterpret_cast<float *>(output_tensor->data_ptr) +
+                         offset + woo * lanes;
+            for (int l = 0; l < stored; l++)
+              dst[l] = static_cast<float>(a[l]) * acc_scales[c0 + l];
           }
         }
       }
     }
   }
-  if (dh > 1 || dw > 1) {
-    free(temp_weight);
+}
+
+template<typename TO>
+void CPUConvOp::convolveHalf() {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+
+  const uint16_t* input = reinterpret_cast<uint16_t *>(
+                            input_tensor->data_ptr);
+  const uint16_t* weight = reinterpret_cast<uint16_t *>(weight_->data_ptr);
+  TO* output = reinterpret_cast<TO *>(output_tensor->data_ptr);
+  const std::vector<float> bias = biasFloat();
+
+  const int ni = input_tensor->n_batch;
+  const int ci = input_tensor->channel;
+  const int hi = input_tensor->height;
+  const int wi = input_tensor->width;
+  const int co = output_tensor->channel;
+  const int ho = output_tensor->height;
+  const int wo = output_tensor->width;
+  const int kh = weight_->height;
+  const int kw = weight_->width;
+
+  if (isGemm()) {
+    for (int n = 0; n < ni; n++) {
+      gemmHalfKernel<TO>(co, hi * wi, ci, weight, ci,
+                         input + input_tensor->offset(n, 0, 0, 0),
+                         input_tensor->cstep,
+                         output + output_tensor->offset(n, 0, 0, 0),
+                         output_tensor->cstep, bias.data());
+    }
+    return;
+  }
+
+  // the kh input rows an output row reads are widened into a window, the
+  // weights of an output channel next to it; the scratch is kept by the op
+  const size_t window = static_cast<size_t>(ci) * kh * wi;
+  const size_t taps = static_cast<size_t>(ci) * kh * kw;
+  half_scratch_.resize(window + taps + wo);
+  float* x = half_scratch_.data();
+  float* w = x + window;
+  float* acc_row = w + taps;
+  for (int n = 0; n < ni; n++) {
+    for (int hoo = 0; hoo < ho; hoo++) {
+      const int start_h = param_.sh * hoo - param_.ph / 2;
+      for (int cii = 0; cii < ci; cii++) {
+        for (int y = 0; y < kh; y++) {
+          const int h = start_h + y * param_.dh;
+          if (h >= 0 && h < hi)
+            halfToFloatKernel(input + input_tensor->offset(n, cii, h, 0),
+                              &x[(cii * kh + y) * wi], wi);
+        }
+      }
+      for (int coo = 0; coo < co; coo++) {
+        halfToFloatKernel(weight + coo * taps, w, taps);
+        for (int woo = 0; woo < wo; woo++) {
+          const int start_w = param_.sw * woo - param_.pw / 2;
+          float acc = bias[coo];
+          for (int cii = 0; cii < ci; cii++) {
+            for (int y = 0; y < kh; y++) {
+              const int h = start_h + y * param_.dh;
+              if (h < 0 || h >= hi)
+                continue;
+              const float* x_row = &x[(cii * kh + y) * wi];
+              const float* w_row = &w[(cii * kh + y) * kw];
+              for (int k = 0; k < kw; k++) {
+                const int v = start_w + k * param_.dw;
+                if (v >= 0 && v < wi)
+                  acc += x_row[v] * w_row[k];
+              }
+            }
+          }
+          acc_row[woo] = acc;
+        }
+        TO* dst = output + output_tensor->offset(n, coo, hoo, 0);
+        for (int woo = 0; woo < wo; woo++)
+          storeFloat(acc_row[woo], dst + woo);
+      }
+    }
+  }
+}
+
+void CPUConvOp::convolveInt4() {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+
+  const uint8_t* input = reinterpret_cast<uint8_t *>(input_tensor->data_ptr);
+  const uint8_t* weight = reinterpret_cast<uint8_t *>(weight_->data_ptr);
+
+  const int ni = input_tensor->n_batch;
+  const int ci = input_tensor->channel;
+  const int hi = input_tensor->height;
+  const int wi = input_tensor->width;
+  const int co = output_tensor->channel;
+  const int ho = output_tensor->height;
+  const int wo = output_tensor->width;
+  const int kh = weight_->height;
+  const int kw = weight_->width;
+  // every output channel starts at a byte
+  const size_t row_bytes = int4Bytes(static_cast<size_t>(ci) * kh * kw);
+  const int32_t input_offset = input_tensor->zero_point;
+
+  std::vector<int32_t> bias(co);
+  std::vector<float> acc_scales(co);
+  for (int coo = 0; coo < co; coo++) {
+    bias[coo] = biasValue(coo);
+    acc_scales[coo] = input_tensor->scale * weight_->channelScale(coo);
+  }
+
+  if (isGemm()) {
+    // the planes are contiguous: GEMM of the weights and panels of pixels
+    const int pixels = hi * wi;
+    std::vector<int32_t> acc(static_cast<size_t>(co) * kGemmInt4Panel);
+    for (int n = 0; n < ni; n++) {
+      for (int p0 = 0; p0 < pixels; p0 += kGemmInt4Panel) {
+        const int num = (std::min)(kGemmInt4Panel, pixels - p0);
+        gemmInt4Kernel(co, num, ci, weight, row_bytes,
+                       input + input_tensor->offset(n, 0, 0, 0) + p0,
+                       input_tensor->cstep, input_offset,
+                       acc.data(), kGemmInt4Panel, bias.data());
+        for (int coo = 0; coo < co; coo++) {
+          epilogue(&acc[static_cast<size_t>(coo) * kGemmInt4Panel],
+                   acc_scales[coo], output_tensor->offset(n, coo, 0, 0) + p0,
+                   num);
+        }
+      }
+    }
+    return;
+  }
+
+  std::vector<int8_t> w(static_cast<size_t>(ci) * kh * kw);
+  std::vector<int32_t> acc_row(wo);
+  const int sh = param_.sh;
+  const int sw = param_.sw;
+  for (int n = 0; n < ni; n++) {
+    for (int coo = 0; coo < co; coo++) {
+      unpackInt4Kernel(weight + coo * row_bytes, w.data(), w.size());
+      for (int hoo = 0; hoo < ho; hoo++) {
+        std::fill(acc_row.begin(), acc_row.end(), bias[coo]);
+        const int start_h = sh * hoo - param_.ph / 2;
+        for (int y = 0; y < kh; y++) {
+          const int h = start_h + y * param_.dh;
+          if (h < 0 || h >= hi)
+            continue;
+          for (int k = 0; k < kw; k++) {
+            // output columns whose tap k lands inside the input row
+            const int shift = k * param_.dw - param_.pw / 2;
+            if (shift >= wi)
+              continue;
+            const int lo = shift >= 0 ? 0 : (-shift + sw - 1) / sw;
+            const int hi_w = (std::min)(wo, (wi - 1 - shift) / sw + 1);
+            if (lo >= hi_w)
+              continue;
+            for (int cii = 0; cii < ci; cii++) {
+              macRowKernel(acc_row.data() + lo,
+                           input + input_tensor->offset(n, cii, h, 0) +
+                           sw * lo + shift, sw, w[(cii * kh + y) * kw + k],
+                           input_offset, hi_w - lo);
+            }
+          }
+        }
+        epilogue(acc_row.data(), acc_scales[coo],
+                 output_tensor->offset(n, coo, hoo, 0), wo);
+      }
+    }
+  }
+}
+
+std::vector<float> CPUConvOp::biasFloat() const {
+  const int co = weight_->n_batch;
+  std::vector<float> bias(co, 0.f);
+  if (!bias_)
+    return bias;
+  for (int c = 0; c < co; c++) {
+    if (bias_->element_size == 2) {
+      bias[c] = halfToFloat(
+          reinterpret_cast<const uint16_t*>(bias_->data_ptr)[c]);
+    } else {
+      bias[c] = reinterpret_cast<const float*>(bias_->data_ptr)[c];
+    }
+  }
+  return bias;
+}
+
+inline int32_t CPUConvOp::biasValue(int c) const {
+  if (!bias_)
+    return 0;
+  if (bias_->element_size == 4)
+    return reinterpret_cast<const int32_t*>(bias_->data_ptr)[c];
+  return reinterpret_cast<const uint8_t*>(bias_->data_ptr)[c];
+}
+
+inline void CPUConvOp::epilogue(const int32_t* acc, float acc_scale,
+                                size_t offset, int num) {
+  auto output_tensor = getOutputs()[0];
+
+  if (output_tensor->element_size == 1) {
+    // quantize fused into the epilogue: no float output map and no
+    // separate QuantizeOp pass over it
+    uint8_t* output = reinterpret_cast<uint8_t *>(output_tensor->data_ptr);
+    const float multiplier = output_tensor->scale == 0.f ? 0.f
+                             : acc_scale / output_tensor->scale;
+    requantizeKernel<uint8_t>(acc, output + offset, num, multiplier,
+                              static_cast<float>(output_tensor->zero_point));
+  } else if (output_tensor->element_size == 4) {
+    float* output = reinterpret_cast<float *>(output_tensor->data_ptr);
+    for (int i = 0; i < num; i++)
+      output[offset + i] = static_cast<float>(acc[i]) * acc_scale;
+  } else {
+    throw std::runtime_error("CPUConvOp unsupport output element size!");
   }
 }
 
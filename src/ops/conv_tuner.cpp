@@ -0,0 +1,122 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "include/ops/conv_tuner.hpp"
+
+namespace RVTensor {
+
+static const char* const kConvAlgorithmNames[] = {
+  nullptr, "direct", "rows", "gemm"
+};
+
+ConvTuner& ConvTuner::instance() {
+  static ConvTuner tuner;
+  return tuner;
+}
+
+ConvTuner::ConvTuner() : tuning_(false), repeat_(5) {}
+
+void ConvTuner::setTuning(bool tuning, int repeat) {
+  LockGuard lock(&mutex_);
+  tuning_ = tuning;
+  repeat_ = repeat > 0 ? repeat : 1;
+}
+
+bool ConvTuner::isTuning() {
+  LockGuard lock(&mutex_);
+  return tuning_;
+}
+
+int ConvTuner::repeat() {
+  LockGuard lock(&mutex_);
+  return repeat_;
+}
+
+bool ConvTuner::find(const std::string& key, ConvTuning* tuning) {
+  LockGuard lock(&mutex_);
+  auto it = table_.find(key);
+  if (it == table_.end())
+    return false;
+  *tuning = it->second;
+  return true;
+}
+
+void ConvTuner::insert(const std::string& key, ConvTuning tuning) {
+  LockGuard lock(&mutex_);
+  table_[key] = tuning;
+}
+
+void ConvTuner::clear() {
+  LockGuard lock(&mutex_);
+  table_.clear();
+}
+
+std::map<std::string, ConvTuning> ConvTuner::entries() {
+  LockGuard lock(&mutex_);
+  return table_;
+}
+
+const char* ConvTuner::algorithmName(ConvAlgorithm algorithm) {
+  if (algorithm <= CONV_ALGO_DEFAULT || algorithm > CONV_ALGO_GEMM)
+    return nullptr;
+  return kConvAlgorithmNames[algorithm];
+}
+
+void ConvTuner::load(const std::string& path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("ConvTuner can not open " + path);
+
+  std::map<std::string, ConvTuning> entries;
+  std::string line;
+  for (int number = 1; std::getline(in, line); number++) {
+    const size_t comment = line.find('#');
+    if (comment != std::string::npos)
+      line.resize(comment);
+    std::istringstream tokens(line);
+    std::string key, name;
+    int tile = -1;
+    if (!(tokens >> key))
+      continue;
+    tokens >> name >> tile;
+    int algorithm = CONV_ALGO_DIRECT;
+    while (algorithm <= CONV_ALGO_GEMM &&
+           name != kConvAlgorithmNames[algorithm])
+      algorithm++;
+    if (algorithm > CONV_ALGO_GEMM || tile < 0) {
+      std::ostringstream error;
+      error << "ConvTuner line " << number << " of " << path
+            << " is wrong!";
+      throw std::runtime_error(error.str());
+    }
+    entries[key] = {static_cast<ConvAlgorithm>(algorithm), tile};
+  }
+
+  LockGuard lock(&mutex_);
+  for (auto& it : entries)
+    table_[it.first] = it.second;
+}
+
+void ConvTuner::save(const std::string& path) {
+  std::ostringstream text;
+  text << "# RVTensor conv tuning cache: <layer> <algorithm> <tile>\n";
+  for (auto& it : entries()) {
+    const char* name = algorithmName(it.second.algorithm);
+    if (name)
+      text << it.first << " " << name << " " << it.second.tile << "\n";
+  }
+
+  std::ofstream out(path);
+  out << text.str();
+  if (!out)
+    throw std::runtime_error("ConvTuner can not write " + path);
+}
+
+}  // namespace RVTensor
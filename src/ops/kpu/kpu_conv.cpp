@@ -10,11 +10,16 @@
 #include <cmath>
 #include <vector>
 #include <sys/time.h> // NOLINT
+#include "include/core/os.hpp"
 #include "include/ops/kpu/kpu_conv.hpp"
 #include "include/ops/kpu/kpu_extern.h"
+#include "include/ops/kpu/kpu_weights.hpp"
 
 namespace RVTensor {
 
+/// the KPU and its RAM are shared by all executors
+static Mutex kpu_mutex;
+
 KPUConvOp::sptr KPUConvOp::create() {
   return std::make_shared<KPUConvOp>();
 }
@@ -30,16 +35,20 @@ KPUConvOp::sptr KPUConvOp::create(ConvParam conv_param, RamTensor::sptr input,
 
 inline KPUConvOp::KPUConvOp() : Operation({}, {}),
        param_({0, 0, 1, 1, 0, 0, false}),
-       weight_(nullptr), bias_(nullptr) {}
+       weight_(nullptr), bias_(nullptr), next_weight_(nullptr) {}
 
 inline KPUConvOp::KPUConvOp(ConvParam conv_param, RamTensor::sptr input,
                             RamTensor::sptr output, FlashTensor::sptr weight,
                             FlashTensor::sptr bias)
   : Operation({input}, {output}), param_(conv_param),
-  weight_(weight), bias_(bias) {}
+  weight_(weight), bias_(bias), next_weight_(nullptr) {}
 
 inline KPUConvOp::~KPUConvOp() {}
 
+void KPUConvOp::prefetchNext(FlashTensor::sptr weight) {
+  next_weight_ = weight;
+}
+
 inline void KPUConvOp::checkOutputDims() {
   auto input = getInputs()[0];
   auto output = getOutputs()[0];
@@ -47,6 +56,21 @@ inline void KPUConvOp::checkOutputDims() {
     throw std::runtime_error("KPUConvOp channel of input is wrong!");
   }
 
+  if (input->layout != LAYOUT_NCHW || output->layout != LAYOUT_NCHW) {
+    throw std::runtime_error("KPUConvOp layout is not NCHW!");
+  }
+
+  // the KPU DMA moves whole planes
+  if (!input->isContiguous() || !output->isContiguous()) {
+    throw std::runtime_error("KPUConvOp unsupport tensor views!");
+  }
+
+  // the KPU loads 8-bit weights
+  if (weight_->element_size != 1 || weight_->data_type == DataType::INT4 ||
+      weight_->isCompressed()) {
+    throw std::runtime_error("KPUConvOp unsupport weight data type!");
+  }
+
   int input_h = input->height + param_.ph;
   int input_w = input->width + param_.pw;
   int kh = param_.dh > 1 ? (weight_->height - 1) * param_.dh + 1
@@ -89,11 +113,12 @@ inline uint64_t to_ui64(const T& reg) {
 }
 
 inline void KPUConvOp::forward_compute() {
+  LockGuard kpu_lock(&kpu_mutex);
   auto input_tensor = getInputs()[0];
   auto output_tensor = getOutputs()[0];
 
-  auto quantize_multiplier = [&] (int32_t* pm, int* ps) {
-    double real_multiplier = input_tensor->scale * weight_->scale /
+  auto quantize_multiplier = [&] (float weight_scale, int32_t* pm, int* ps) {
+    double real_multiplier = input_tensor->scale * weight_scale /
                              output_tensor->scale;
     const double q = std::frexp(real_multiplier, ps);
     auto q_fixed = static_cast<int64_t>(round(q * (1ll << 31)));
@@ -109,11 +134,11 @@ inline void KPUConvOp::forward_compute() {
   const int32_t output_offset = 0;
   int32_t multiplier;
   int shift;
-  quantize_multiplier(&multiplier, &shift);
+  quantize_multiplier(weight_->scale, &multiplier, &shift);
 
-  float* input = reinterpret_cast<float *>(input_tensor->data_ptr);
-  float* output = reinterpret_cast<float *>(output_tensor->data_ptr);
-  float* weight = reinterpret_cast<float *>(weight_->data_ptr);
+  const uint8_t* input = reinterpret_cast<const uint8_t*>(
+                           input_tensor->data_ptr);
+  uint8_t* output = reinterpret_cast<uint8_t*>(output_tensor->data_ptr);
   float* bias = bias_ ? reinterpret_cast<float *>(bias_->data_ptr) : nullptr;
 
   uint32_t ni = input_tensor->n_batch;
@@ -135,39 +160,15 @@ inline void KPUConvOp::forward_compute() {
   uint32_t ph = param_.ph;
   uint32_t pw = param_.pw;
 
-  uint32_t in_row_padding;
-  uint32_t in_row_group;
-  uint32_t in_row_length;
-  if (wi <= 16) {
-    in_row_padding = 16;
-    in_row_group = 4;
-    in_row_length = 1;
-  } else if (wi <= 32) {
-    in_row_padding = 32;
-    in_row_group = 2;
-    in_row_length = 1;
-  } else {
-    in_row_padding = 64;
-    in_row_group = 1;
-    in_row_length = (wi + 63) / 64;
-  }
-
-  uint32_t out_row_padding;
-  uint32_t out_row_group;
-  uint32_t out_row_length;
-  if (wo <= 16) {
-    out_row_padding = 16;
-    out_row_group = 4;
-    out_row_length = 1;
-  } else if (wo <= 32) {
-    out_row_padding = 32;
-    out_row_group = 2;
-    out_row_length = 1;
-  } else {
-    out_row_padding = 64;
-    out_row_group = 1;
-    out_row_length = (wo + 63) / 64;
-  }
+  // row layouts of the input and the output in the KPU RAM
+  int padding, group, row_length;
+  kpuRowLayout(wi, &padding, &group, &row_length);
+  const uint32_t in_row_padding = padding;
+  const uint32_t in_row_group = group;
+  const uint32_t in_row_length = row_length;
+  kpuRowLayout(wo, &padding, &group, &row_length);
+  const uint32_t out_row_group = group;
+  const uint32_t out_row_length = row_length;
 
   const uint32_t in_channels_of_group = std::min(ci, in_row_group);
   const uint32_t out_channels_of_group = std::min(co, out_row_group);
@@ -258,9 +259,24 @@ inline void KPUConvOp::forward_compute() {
     .dma_total_byte = (wo * ho * co) - 1
   };
 
+  // per output channel weight scales are folded into the batchnorm
+  // multiplier of each channel, so the whole layer stays 8-bit on the KPU
   auto kpu_bn_table = make_unique<kpu_batchnorm_argument_t[]>(co);
-  uint64_t mul = multiplier >> (12 - shift);
   for (int out_channel = 0; out_channel < co; ++out_channel) {
+    int32_t channel_multiplier = multiplier;
+    int channel_shift = shift;
+    if (weight_->channel_scales) {
+      quantize_multiplier(weight_->channelScale(out_channel),
+                          &channel_multiplier, &channel_shift);
+    }
+    // norm_mul holds the real multiplier with 19 fraction bits in 24 bits,
+    // multipliers below 2^-19 are 0
+    const int right_shift = 12 - channel_shift;
+    const uint64_t mul = right_shift < 32 ?
+        static_cast<uint32_t>(channel_multiplier) >> right_shift : 0;
+    if (right_shift < 0 || mul >= (1u << 24)) {
+      throw std::runtime_error("KPUConvOp multiplier is out of range!");
+    }
     int64_t add = bias ? bias[out_channel] : 0;
     add = (add * mul) >> 15;
     add += output_offset << 4;
@@ -269,7 +285,10 @@ inline void KPUConvOp::forward_compute() {
     };
   }
 
-  auto kernels = make_unique<uint8_t[]>(kw * kh * ci * co);
+  // the coefficients are in [co][ci][kh][kw] order already, the stage
+  // has them in RAM (prefetched by the previous layer)
+  KPUWeightStage& stage = KPUWeightStage::instance();
+  const uint8_t* kernels = stage.acquire(weight_);
   auto ai_inputs = reinterpret_cast<uint8_t*>(AI_IO_BASE_ADDR);
 
   size_t output_size =
@@ -278,7 +297,7 @@ inline void KPUConvOp::forward_compute() {
 
   layer.kernel_pool_type_cfg.data.bwsx_base_addr = (uint64_t)kpu_bn_table.get();
   layer.kernel_calc_type_cfg.data.active_addr = (uint64_t)&kpu_act_table;
-  layer.kernel_load_cfg.data.para_start_addr = (uint64_t)kernels.get();
+  layer.kernel_load_cfg.data.para_start_addr = (uint64_t)kernels;
 
   // init act
   kpu_act_table.activate_para[0].data =
@@ -320,35 +339,45 @@ inline void KPUConvOp::forward_compute() {
     .result_bias = {0, 0, 0, 0, 0, 0, 0, 0}
   };
 
-  // init kernels
-  uint8_t *k_it = kernels.get();
-  for (int out_channel = 0; out_channel < co; ++out_channel) {
-    for (int in_channel = 0; in_channel < ci; ++in_channel) {
-      for (int filter_y = 0; filter_y < kh; ++filter_y) {
-        for (int filter_x = 0; filter_x < kw; ++filter_x) {
-          *k_it++ = weight[out_channel * ci * kh * kw +
-                           in_channel * kh * kw + filter_y * kw + filter_x];
-        }
-      }
-    }
-  }
 #if KPU_DEBUG
   printk("kernels\n");
   for (int i = 0; i < 64; i++)
-    printk("%p: %d ", kernels.get(), kernels[i]);
+    printk("%p: %d ", kernels, kernels[i]);
 #endif
 
+  // KPU setup is done once for the whole batch
+  volatile kpu_config_t *const kpu = (volatile kpu_config_t *)AI_BASE_ADDR;
+  kpu->interrupt_clear.reg = to_ui64(kpu_config_interrupt_t {
+      .calc_done_int = 1,
+      .layer_cfg_almost_empty_int = 1,
+      .layer_cfg_almost_full_int = 1
+  });
+  kpu->eight_bit_mode.reg = to_ui64(kpu_config_eight_bit_mode_t {
+      .eight_bit_mode = 1
+  });
+  kpu->fifo_threshold.reg = to_ui64(kpu_config_fifo_threshold_t {
+      .fifo_full_threshold = 10, .fifo_empty_threshold = 1
+  });
+  kpu->interrupt_mask.reg = to_ui64(kpu_config_interrupt_t {
+      .calc_done_int = 0,
+      .layer_cfg_almost_empty_int = 1,
+      .layer_cfg_almost_full_int = 1
+  });
+  handle_t dma = dma_open_free();
+  dma_set_request_source(dma, SYSCTL_DMA_SELECT_AI_RX_REQ);
+
   for (int batch = 0; batch < ni; ++batch) {
     // init inputs
     for (int in_channel = 0; in_channel < ci; ++in_channel) {
       auto channel_origin = ai_inputs +
-                            ci / in_row_group * in_row_length * hi * 64 +
-                            ci % in_row_group * in_row_padding;
+                            in_channel / in_row_group * in_row_length *
+                            hi * 64 +
+                            in_channel % in_row_group * in_row_padding;
+      const uint8_t* src = input + (batch * ci + in_channel) * stepi;
       for (int in_y = 0; in_y < hi; ++in_y) {
         auto y_origin = channel_origin + in_y * in_row_length * 64;
         for (int in_x = 0; in_x < wi; ++in_x) {
-          y_origin[in_x] = input[batch * ci * hi * wi + in_channel * hi * wi +
-                                 in_y * wi + in_x];
+          y_origin[in_x] = src[in_y * wi + in_x];
         }
       }
     }
@@ -356,26 +385,13 @@ inline void KPUConvOp::forward_compute() {
 #if KPU_DEBUG
     printk("ai_inputs\n");
     for (int i = 0; i < 64; i++)
-      printk("%d ", input_data[i]);
+      printk("%d ", ai_inputs[i]);
 #endif
 
-    volatile kpu_config_t *const kpu = (volatile kpu_config_t *)AI_BASE_ADDR;
-    kpu->interrupt_clear.reg = to_ui64(kpu_config_interrupt_t {
-        .calc_done_int = 1,
-        .layer_cfg_almost_empty_int = 1,
-        .layer_cfg_almost_full_int = 1
-    });
-    kpu->eight_bit_mode.reg = to_ui64(kpu_config_eight_bit_mode_t {
-        .eight_bit_mode = 1
-    });
-    kpu->fifo_threshold.reg = to_ui64(kpu_config_fifo_threshold_t {
-        .fifo_full_threshold = 10, .fifo_empty_threshold = 1
-    });
-    kpu->interrupt_mask.reg = to_ui64(kpu_config_interrupt_t {
-        .calc_done_int = 0,
-        .layer_cfg_almost_empty_int = 1,
-        .layer_cfg_almost_full_int = 1
-    });
+    // when all kernels fit the KPU weight buffer in one load they are
+    // still there for the following batch items
+    layer.kernel_pool_type_cfg.data.load_para =
+        (batch == 0 || load_time > 1) ? 1 : 0;
 
     kpu->layer_argument_fifo = layer.interrupt_enabe.reg;
     kpu->layer_argument_fifo = layer.image_addr.reg;
@@ -390,21 +406,19 @@ inline void KPUConvOp::forward_compute() {
     kpu->layer_argument_fifo = layer.conv_value2.reg;
     kpu->layer_argument_fifo = layer.dma_parameter.reg;
 
-    handle_t dma = dma_open_free();
-    dma_set_request_source(dma, SYSCTL_DMA_SELECT_AI_RX_REQ);
+    // the KPU runs now: stage the next layer meanwhile
+    if (batch == 0)
+      stage.prefetch(next_weight_);
+
     dma_transmit(dma, (void*)(&kpu->fifo_data_out),  // NOLINT
                  ai_outputs.get(), false, true, 8,
                  (layer.dma_parameter.data.dma_total_byte + 8) / 8, 8);
-    dma_close(dma);
 
     uint8_t *o_it = ai_outputs.get();
     for (int out_channel = 0; out_channel < co; ++out_channel) {
-      for (int out_y = 0; out_y < ho; ++out_y) {
-        for (int out_x = 0; out_x < wo; ++out_x) {
-          output[batch * co * ho * wo + out_channel * ho * wo +
-                 out_y * wo + out_x] = *o_it++;
-        }
-      }
+      uint8_t* dst = output + (batch * co + out_channel) * stepo;
+      for (int i = 0; i < ho * wo; ++i)
+        dst[i] = *o_it++;
     }
 #if KPU_DEBUG
     printk("ai_outputs\n");
@@ -416,6 +430,7 @@ inline void KPUConvOp::forward_compute() {
           (tv.tv_sec * 1000 + tv.tv_usec / 1e3)));
 #endif
   }
+  dma_close(dma);
 }
 
 }  // namespace RVTensor
@@ -0,0 +1,108 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include "include/ops/kpu/kpu_weights.hpp"
+#include "include/ops/kpu/kpu_extern.h"
+
+namespace RVTensor {
+
+/// the DMA moves 8 byte elements, the tail is copied by the CPU
+static const size_t kDmaElement = 8;
+
+KPUWeightStage& KPUWeightStage::instance() {
+  static KPUWeightStage stage;
+  return stage;
+}
+
+KPUWeightStage::KPUWeightStage() : current_(0), dma_(0) {
+  for (auto& buffer : buffers_) {
+    buffer.data = nullptr;
+    buffer.pending = false;
+    buffer.done = xSemaphoreCreateBinary();
+    if (buffer.done == NULL)
+      throw std::runtime_error("KPUWeightStage semaphore create failed!");
+  }
+}
+
+KPUWeightStage::~KPUWeightStage() {
+  for (auto& buffer : buffers_) {
+    wait(&buffer);
+    vSemaphoreDelete(buffer.done);
+  }
+  if (dma_)
+    dma_close(dma_);
+}
+
+void KPUWeightStage::prefetch(FlashTensor::sptr weight) {
+  if (!weight || find(weight))
+    return;
+  load(&buffers_[1 - current_], weight, true);
+}
+
+const uint8_t* KPUWeightStage::acquire(FlashTensor::sptr weight) {
+  Buffer* buffer = find(weight);
+  if (buffer) {
+    wait(buffer);
+  } else {
+    buffer = &buffers_[1 - current_];
+    load(buffer, weight, false);
+  }
+  current_ = static_cast<int>(buffer - buffers_);
+  return reinterpret_cast<const uint8_t*>(buffer->data->data_ptr);
+}
+
+void KPUWeightStage::load(Buffer* buffer, FlashTensor::sptr weight,
+                          bool async) {
+  wait(buffer);
+  buffer->weight.reset();
+  const size_t size = weight->trueSize();
+  if (!buffer->data || buffer->data->trueSize() < size) {
+    buffer->data = nullptr;
+    buffer->data = RamTensor::create(1, 1, 1, static_cast<int>(size), 1u,
+                                     CACHE_LINE_ALIGN);
+  }
+
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(weight->data_ptr);
+  uint8_t* dst = reinterpret_cast<uint8_t*>(buffer->data->data_ptr);
+  const size_t count = reinterpret_cast<size_t>(src) % kDmaElement == 0
+                       ? size / kDmaElement : 0;
+  const size_t tail = count * kDmaElement;
+  memcpy(dst + tail, src + tail, size - tail);
+  buffer->weight = weight;
+  if (count == 0)
+    return;
+
+  if (!dma_)
+    dma_ = dma_open_free();
+  if (async) {
+    buffer->pending = true;
+    dma_transmit_async(dma_, src, dst, true, true, kDmaElement, count, 4,
+                       buffer->done);
+  } else {
+    dma_transmit(dma_, src, dst, true, true, kDmaElement, count, 4);
+  }
+}
+
+void KPUWeightStage::wait(Buffer* buffer) {
+  if (!buffer->pending)
+    return;
+  xSemaphoreTake(buffer->done, portMAX_DELAY);
+  buffer->pending = false;
+}
+
+KPUWeightStage::Buffer* KPUWeightStage::find(
+    const FlashTensor::sptr& weight) {
+  for (auto& buffer : buffers_) {
+    if (buffer.weight.lock() == weight)
+      return &buffer;
+  }
+  return nullptr;
+}
+
+}  // namespace RVTensor
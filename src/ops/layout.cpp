@@ -0,0 +1,105 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <stdexcept>
+#include "include/ops/layout.hpp"
+
+namespace RVTensor {
+
+LayoutOp::sptr LayoutOp::create() {
+  return std::make_shared<LayoutOp>();
+}
+
+LayoutOp::sptr LayoutOp::create(RamTensor::sptr input,
+                                RamTensor::sptr output) {
+  LayoutOp::sptr ptr = std::make_shared<LayoutOp>(input, output);
+  ptr->checkOutputDims();
+  return ptr;
+}
+
+inline LayoutOp::LayoutOp() : Operation({}, {}) {}
+
+inline LayoutOp::LayoutOp(RamTensor::sptr input, RamTensor::sptr output)
+  : Operation({input}, {output}) {}
+
+inline LayoutOp::~LayoutOp() {}
+
+inline void LayoutOp::checkOutputDims() {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  if (input->n_batch != output->n_batch ||
+      input->channel != output->channel ||
+      input->height != output->height ||
+      input->width != output->width) {
+    throw std::runtime_error("LayoutOp shape of input or output is wrong!");
+  }
+
+  if (input->element_size != output->element_size) {
+    throw std::runtime_error("LayoutOp element size is wrong!");
+  }
+  output->setDataType(input->data_type);
+}
+
+template<typename T>
+void LayoutOp::convert() {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+  const T* input = reinterpret_cast<const T*>(input_tensor->data_ptr);
+  T* output = reinterpret_cast<T*>(output_tensor->data_ptr);
+  const int height = input_tensor->height;
+  const int width = input_tensor->width;
+  const int step_i = input_tensor->block;
+  const int step_o = output_tensor->block;
+
+  for (int n = 0; n < input_tensor->n_batch; n++) {
+    for (int c = 0; c < input_tensor->channel; c++) {
+      for (int h = 0; h < height; h++) {
+        const T* src = input + input_tensor->offset(n, c, h, 0);
+        T* dst = output + output_tensor->offset(n, c, h, 0);
+        for (int w = 0; w < width; w++)
+          dst[w * step_o] = src[w * step_i];
+      }
+    }
+
+    // padding channels of the last block hold 0 (float) or the zero point,
+    // in channel views they are channels of the parent
+    if (!output_tensor->wholeBlocks())
+      continue;
+    const T zero = sizeof(T) == 4 ? 0
+                   : static_cast<T>(output_tensor->zero_point);
+    const int padded = output_tensor->groups() * output_tensor->block;
+    for (int c = output_tensor->channel; c < padded; c++) {
+      for (int h = 0; h < height; h++) {
+        T* dst = output + output_tensor->offset(n, c, h, 0);
+        for (int w = 0; w < width; w++)
+          dst[w * step_o] = zero;
+      }
+    }
+  }
+}
+
+inline void LayoutOp::forward_compute() {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  output->setQuantizeParams(input->min_range, input->max_range,
+                            input->scale, input->zero_point);
+  switch (input->element_size) {
+    case 1:
+      convert<uint8_t>();
+      break;
+    case 2:
+      convert<uint16_t>();
+      break;
+    case 4:
+      convert<uint32_t>();
+      break;
+    default:
+      throw std::runtime_error("LayoutOp unsupport element size!");
+  }
+}
+
+}  // namespace RVTensor
@@ -0,0 +1,174 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "include/ops/pool.hpp"
+#include "include/ops/quantize_kernel.hpp"
+
+namespace RVTensor {
+
+PoolOp::sptr PoolOp::create() {
+  return std::make_shared<PoolOp>();
+}
+
+PoolOp::sptr PoolOp::create(PoolParam param, RamTensor::sptr input,
+                            RamTensor::sptr output) {
+  PoolOp::sptr ptr = std::make_shared<PoolOp>(param, input, output);
+  ptr->checkOutputDims();
+  return ptr;
+}
+
+inline PoolOp::PoolOp() : Operation({}, {}),
+                          param_({POOL_MAX, 1, 1, 1, 1, 0, 0}) {}
+
+inline PoolOp::PoolOp(PoolParam param, RamTensor::sptr input,
+                      RamTensor::sptr output)
+  : Operation({input}, {output}), param_(param) {}
+
+inline PoolOp::~PoolOp() {}
+
+inline void PoolOp::checkOutputDims() {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  if (param_.type < POOL_MAX || param_.type > POOL_AVERAGE ||
+      param_.kw < 1 || param_.kh < 1 || param_.sw < 1 || param_.sh < 1 ||
+      param_.pw < 0 || param_.ph < 0) {
+    throw std::runtime_error("PoolOp param is wrong!");
+  }
+
+  if (input->width + param_.pw < param_.kw ||
+      input->height + param_.ph < param_.kh) {
+    throw std::runtime_error("PoolOp window is wrong!");
+  }
+
+  const int output_h = (input->height + param_.ph - param_.kh) / param_.sh +
+                       1;
+  const int output_w = (input->width + param_.pw - param_.kw) / param_.sw +
+                       1;
+  if (input->n_batch != output->n_batch ||
+      input->channel != output->channel ||
+      output->height != output_h || output->width != output_w) {
+    throw std::runtime_error("PoolOp output shape is wrong!");
+  }
+
+  if (input->layout != output->layout || input->block != output->block ||
+      !input->wholeBlocks() || !output->wholeBlocks()) {
+    throw std::runtime_error("PoolOp layout of input or output is wrong!");
+  }
+
+  if (input->element_size != output->element_size ||
+      (input->element_size != 1 && input->element_size != 4)) {
+    throw std::runtime_error("PoolOp unsupport element size!");
+  }
+
+  const DataType type = input->element_size == 1 ? UINT8 : FLOAT32;
+  input->setDataType(type);
+  output->setDataType(type);
+}
+
+inline void PoolOp::forward_compute() {
+  forwardRows(0, getOutputs()[0]->height);
+}
+
+bool PoolOp::supportsRows() {
+  return true;
+}
+
+void PoolOp::inputRows(int h0, int h1, int* begin, int* end) {
+  const int hi = getInputs()[0]->height;
+  *begin = (std::min)((std::max)(h0 * param_.sh - param_.ph / 2, 0), hi);
+  *end = (std::max)((std::min)((h1 - 1) * param_.sh - param_.ph / 2 +
+                               param_.kh, hi), *begin);
+}
+
+void PoolOp::forwardRows(int h0, int h1) {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  if (input->element_size == 1) {
+    if (output->scale == 0.f) {
+      output->setQuantizeParams(input->min_range, input->max_range,
+                                input->scale, input->zero_point);
+    }
+    pool<uint8_t>(h0, h1);
+  } else {
+    output->setQuantizeRange(input->min_range, input->max_range);
+    pool<float>(h0, h1);
+  }
+}
+
+template<typename T>
+void PoolOp::pool(int h0, int h1) {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  const T* src = reinterpret_cast<T *>(input->data_ptr);
+  T* dst = reinterpret_cast<T *>(output->data_ptr);
+
+  const int hi = input->height;
+  const int wi = input->width;
+  const int wo = output->width;
+  // pixels are block elements apart
+  const int bi = input->block;
+  const int bo = output->block;
+  const bool average = param_.type == POOL_AVERAGE;
+
+  // uint8: q_out = (q_in - zero_in) * scale_in / scale_out + zero_out,
+  // windows without taps are real 0
+  const bool quantized = sizeof(T) == 1;
+  const float multiplier = !quantized || output->scale == 0.f ? 1.f
+                           : input->scale / output->scale;
+  const float input_zero = quantized ? input->zero_point : 0.f;
+  const float output_zero = quantized ? output->zero_point : 0.f;
+  const float lo = quantMin<uint8_t>(false);
+  const float hi_q = quantMax<uint8_t>();
+
+  // first and last input columns of every output column
+  std::vector<int> x0(wo), x1(wo);
+  for (int woo = 0; woo < wo; woo++) {
+    const int start_w = woo * param_.sw - param_.pw / 2;
+    x0[woo] = (std::max)(start_w, 0);
+    x1[woo] = (std::min)(start_w + param_.kw, wi);
+  }
+
+  for (int n = 0; n < input->n_batch; n++) {
+    for (int c = 0; c < input->channel; c++) {
+      for (int hoo = h0; hoo < h1; hoo++) {
+        const int start_h = hoo * param_.sh - param_.ph / 2;
+        const int y0 = (std::max)(start_h, 0);
+        const int y1 = (std::min)(start_h + param_.kh, hi);
+        T* out = dst + output->offset(n, c, hoo, 0);
+        for (int woo = 0; woo < wo; woo++) {
+          float v = average ? 0.f : -std::numeric_limits<float>::infinity();
+          for (int y = y0; y < y1; y++) {
+            const T* row = src + input->offset(n, c, y, 0);
+            for (int x = x0[woo]; x < x1[woo]; x++) {
+              const float value = static_cast<float>(row[x * bi]);
+              v = average ? v + value : (std::max)(v, value);
+            }
+          }
+          const int taps = (y1 - y0) * (x1[woo] - x0[woo]);
+          if (taps <= 0)
+            v = input_zero;
+          else if (average)
+            v /= taps;
+          if (quantized) {
+            out[woo * bo] = static_cast<T>(saturateCast<uint8_t>(
+                std::fma(v - input_zero, multiplier, output_zero), lo,
+                hi_q));
+          } else {
+            out[woo * bo] = static_cast<T>(v);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace RVTensor
@@ -0,0 +1,200 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "include/ops/preprocess.hpp"
+#include "include/ops/quantize_kernel.hpp"
+
+namespace RVTensor {
+
+/// bits of the bilinear weights
+#define RESIZE_BITS 11
+
+/**
+ * planar RGB24 frame
+ */
+struct PlanarReader {
+  const uint8_t* data;
+  size_t cstep;
+  int width;
+
+  inline int operator()(int c, int y, int x) const {
+    return data[c * cstep + y * width + x];
+  }
+};
+
+/**
+ * RGB565 frame, one native endian uint16_t per pixel
+ */
+struct RGB565Reader {
+  const uint16_t* data;
+  size_t cstep;
+  int width;
+
+  inline int operator()(int c, int y, int x) const {
+    const int p = data[y * width + x];
+    if (c == 0) {
+      const int r = p >> 11;
+      return (r << 3) | (r >> 2);
+    } else if (c == 1) {
+      const int g = (p >> 5) & 0x3f;
+      return (g << 2) | (g >> 4);
+    }
+    const int b = p & 0x1f;
+    return (b << 3) | (b >> 2);
+  }
+};
+
+PreprocessOp::sptr PreprocessOp::create(PreprocessParam param,
+                                        RamTensor::sptr input,
+                                        RamTensor::sptr output) {
+  PreprocessOp::sptr ptr = std::make_shared<PreprocessOp>(param, input,
+                                                          output);
+  ptr->checkOutputDims();
+  return ptr;
+}
+
+PreprocessOp::PreprocessOp(PreprocessParam param, RamTensor::sptr input,
+                           RamTensor::sptr output)
+  : Operation({input}, {output}), param_(param) {}
+
+PreprocessOp::~PreprocessOp() {}
+
+void PreprocessOp::checkOutputDims() {
+  auto input = getInputs()[0];
+  auto output = getOutputs()[0];
+  const bool rgb565 = input->channel == 1 && input->element_size == 2;
+  const bool planar = input->channel == 3 && input->element_size == 1;
+  if (!rgb565 && !planar)
+    throw std::runtime_error("PreprocessOp input format is wrong!");
+  if (input->n_batch != output->n_batch || output->channel != 3 ||
+      (output->element_size != 1 && output->element_size != 4))
+    throw std::runtime_error("PreprocessOp output dims is wrong!");
+  if (output->layout != LAYOUT_NCHW)
+    throw std::runtime_error("PreprocessOp layout is not NCHW!");
+  if (!input->isContiguous() || !output->isContiguous())
+    throw std::runtime_error("PreprocessOp unsupport tensor views!");
+  for (int c = 0; c < 3; c++) {
+    if (param_.channel_order[c] < 0 || param_.channel_order[c] > 2 ||
+        param_.std[c] == 0.f)
+      throw std::runtime_error("PreprocessOp param is wrong!");
+  }
+
+  buildAxis(input->width, output->width, &x_index_, &x_weight_);
+  buildAxis(input->height, output->height, &y_index_, &y_weight_);
+}
+
+void PreprocessOp::buildAxis(int src, int dst, std::vector<int>* index,
+                             std::vector<int>* weight) {
+  index->resize(dst);
+  weight->resize(dst);
+  const float scale = static_cast<float>(src) / dst;
+  for (int i = 0; i < dst; i++) {
+    if (param_.resize == RESIZE_NEAREST) {
+      (*index)[i] = std::min(static_cast<int>((i + 0.5f) * scale), src - 1);
+      (*weight)[i] = 0;
+      continue;
+    }
+    // align centers, as most training pipelines resize
+    const float f = std::max((i + 0.5f) * scale - 0.5f, 0.f);
+    int idx = static_cast<int>(f);
+    int w = static_cast<int>((f - idx) * (1 << RESIZE_BITS) + 0.5f);
+    if (idx >= src - 1) {
+      idx = src - 1;
+      w = 0;
+    }
+    (*index)[i] = idx;
+    (*weight)[i] = w;
+  }
+}
+
+template<typename Reader, typename T>
+void PreprocessOp::process(const Reader& reader, const T* lut) {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+  const int ih = input_tensor->height;
+  const int iw = input_tensor->width;
+  const int oh = output_tensor->height;
+  const int ow = output_tensor->width;
+  const int one = 1 << RESIZE_BITS;
+  const int round = 1 << (2 * RESIZE_BITS - 1);
+
+  for (int n = 0; n < output_tensor->n_batch; n++) {
+    Reader frame = reader;
+    frame.data += n * input_tensor->channel * input_tensor->cstep;
+    for (int y = 0; y < oh; y++) {
+      const int y0 = y_index_[y];
+      const int y1 = y0 + (y0 < ih - 1);
+      const int fy = y_weight_[y];
+      for (int c = 0; c < 3; c++) {
+        const int sc = param_.channel_order[c];
+        const T* table = lut + c * 256;
+        T* dst = reinterpret_cast<T*>(output_tensor->data_ptr) +
+                 (n * 3 + c) * output_tensor->cstep + y * ow;
+
+        if (param_.resize == RESIZE_NEAREST) {
+          for (int x = 0; x < ow; x++)
+            dst[x] = table[frame(sc, y0, x_index_[x])];
+          continue;
+        }
+        for (int x = 0; x < ow; x++) {
+          const int x0 = x_index_[x];
+          const int x1 = x0 + (x0 < iw - 1);
+          const int fx = x_weight_[x];
+          const int top = frame(sc, y0, x0) * (one - fx) +
+                          frame(sc, y0, x1) * fx;
+          const int bottom = frame(sc, y1, x0) * (one - fx) +
+                             frame(sc, y1, x1) * fx;
+          dst[x] = table[(top * (one - fy) + bottom * fy + round) >>
+                         (2 * RESIZE_BITS)];
+        }
+      }
+    }
+  }
+}
+
+void PreprocessOp::forward_compute() {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+
+  // normalize + quantize of every 8 bit value of a channel
+  uint8_t lut_u8[3 * 256];
+  float lut_f32[3 * 256];
+  const float scale = output_tensor->scale == 0.f ? 1.f
+                      : output_tensor->scale;
+  for (int c = 0; c < 3; c++) {
+    const float inv_std = 1.f / param_.std[c];
+    for (int v = 0; v < 256; v++) {
+      const float normalized = (v - param_.mean[c]) * inv_std;
+      lut_f32[c * 256 + v] = normalized;
+      lut_u8[c * 256 + v] = saturateCast<uint8_t>(
+          normalized / scale + output_tensor->zero_point,
+          quantMin<uint8_t>(false), quantMax<uint8_t>());
+    }
+  }
+
+  if (input_tensor->element_size == 2) {
+    RGB565Reader reader = {reinterpret_cast<const uint16_t*>(
+                             input_tensor->data_ptr),
+                           input_tensor->cstep, input_tensor->width};
+    if (output_tensor->element_size == 1)
+      process(reader, lut_u8);
+    else
+      process(reader, lut_f32);
+  } else {
+    PlanarReader reader = {reinterpret_cast<const uint8_t*>(
+                             input_tensor->data_ptr),
+                           input_tensor->cstep, input_tensor->width};
+    if (output_tensor->element_size == 1)
+      process(reader, lut_u8);
+    else
+      process(reader, lut_f32);
+  }
+}
+
+}  // namespace RVTensor
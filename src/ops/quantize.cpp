@@ -6,8 +6,12 @@
  */
 
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <stdexcept>
 #include "include/ops/quantize.hpp"
+#include "include/ops/quantize_kernel.hpp"
+#include "include/ops/half_kernel.hpp"
 #include "include/core/tensor.hpp"
 
 namespace RVTensor {
@@ -24,7 +28,7 @@ QuantizeOp::sptr QuantizeOp::create(QuantizeParam qp, RamTensor::sptr input,
 }
 
 inline QuantizeOp::QuantizeOp() : Operation({}, {}),
-       param_({0, 0, QuantizeStrategy::NONE}) {}
+       param_({0, 0, QuantizeStrategy::NONE, false}) {}
 
 inline QuantizeOp::QuantizeOp(QuantizeParam qp, RamTensor::sptr input,
                               RamTensor::sptr output)
@@ -32,6 +36,34 @@ inline QuantizeOp::QuantizeOp(QuantizeParam qp, RamTensor::sptr input,
 
 inline QuantizeOp::~QuantizeOp() {}
 
+/// element sizes and data types (input, output) of each strategy
+static const struct {
+  int input_elemsize;
+  int output_elemsize;
+  DataType input_type;
+  DataType output_type;
+} kStrategyTable[] = {
+  {4, 1, FLOAT32, UINT8},  // AFFINE_QUANTIZE_FLOAT32TOUINT8
+  {4, 2, FLOAT32, UINT16},  // AFFINE_QUANTIZE_FLOAT32TOUINT16
+  {4, 1, FLOAT32, INT8},  // SYMMETRIC_QUANTIZE_FLOAT32TOINT8
+  {4, 2, FLOAT32, INT16},  // SYMMETRIC_QUANTIZE_FLOAT32TOINT16
+  {1, 4, UINT8, FLOAT32},  // AFFINE_DEQUANTIZE_UINT8TOFLOAT32
+  {2, 4, UINT16, FLOAT32},  // AFFINE_DEQUANTIZE_UINT16TOFLOAT32
+  {1, 4, INT8, FLOAT32},  // SYMMETRIC_DEQUANTIZE_INT8TOFLOAT32
+  {2, 4, INT16, FLOAT32},  // SYMMETRIC_DEQUANTIZE_INT16TOFLOAT32
+  {0, 0, FLOAT32, FLOAT32},  // NONE
+  {4, 2, FLOAT32, FLOAT16},  // CAST_FLOAT32TOFLOAT16
+  {2, 4, FLOAT16, FLOAT32},  // CAST_FLOAT16TOFLOAT32
+  {2, 1, FLOAT16, UINT8},  // AFFINE_QUANTIZE_FLOAT16TOUINT8
+  {1, 2, UINT8, FLOAT16},  // AFFINE_DEQUANTIZE_UINT8TOFLOAT16
+};
+
+static const int kStrategyNum = sizeof(kStrategyTable) /
+                                sizeof(kStrategyTable[0]);
+
+/// float16 rows are widened/narrowed through a float32 buffer of this size
+static const size_t kChunkSize = 256;
+
 inline void QuantizeOp::checkOutputDims() {
   auto input = getInputs()[0];
   auto output = getOutputs()[0];
@@ -43,71 +75,218 @@ inline void QuantizeOp::checkOutputDims() {
         "QuantizeOp shape of input or output is wrong!");
   }
 
-  if (input->element_size != param_.input_elemsize ||
-      output->element_size != param_.output_elemsize) {
+  if (input->layout != output->layout || input->block != output->block ||
+      !input->wholeBlocks() || !output->wholeBlocks()) {
+    throw std::runtime_error("QuantizeOp layout of input or output is wrong!");
+  }
+
+  if (input->element_size != static_cast<size_t>(param_.input_elemsize) ||
+      output->element_size != static_cast<size_t>(param_.output_elemsize)) {
     throw std::runtime_error("QuantizeOp Param is wrong!");
   }
+
+  if (param_.quant_type == NONE || param_.quant_type < 0 ||
+      param_.quant_type >= kStrategyNum) {
+    throw std::runtime_error("QuantizeOP unsupport quantize strategy!");
+  }
+
+  const auto& entry = kStrategyTable[param_.quant_type];
+  if (param_.input_elemsize != entry.input_elemsize ||
+      param_.output_elemsize != entry.output_elemsize) {
+    throw std::runtime_error("QuantizeOp element size mismatch strategy!");
+  }
+
+  input->setDataType(entry.input_type);
+  output->setDataType(entry.output_type);
 }
 
-inline void QuantizeOp::forward_compute() {
+/**
+ * fn(input row, output row, elements) over the rows of every channel
+ * group, planes of packed tensors are a single row
+ */
+template<typename TI, typename TO, typename F>
+static void forEachRow(RamTensor::sptr input, RamTensor::sptr output, F fn) {
+  const bool packed = input->isContiguous() && output->isContiguous();
+  const int rows = packed ? 1 : input->height;
+  const size_t row_size = input->width * input->block *
+                          (input->height / rows);
+  TI* in = reinterpret_cast<TI *>(input->data_ptr);
+  TO* out = reinterpret_cast<TO *>(output->data_ptr);
+  for (int n = 0; n < input->n_batch; n++) {
+    for (int g = 0; g < input->groups(); g++) {
+      const int c = g * input->block;
+      for (int h = 0; h < rows; h++)
+        fn(in + input->offset(n, c, h, 0), out + output->offset(n, c, h, 0),
+           row_size);
+    }
+  }
+}
+
+/**
+ * float32 rows are used in place, float16 (uint16_t) rows go through a
+ * float32 buffer of at most kChunkSize elements
+ */
+static inline const float* widenRow(const float* src, float*, size_t) {
+  return src;
+}
+
+static inline const float* widenRow(const uint16_t* src, float* buf,
+                                    size_t n) {
+  halfToFloatKernel(src, buf, n);
+  return buf;
+}
+
+static inline float* rowBuffer(float* dst, float*) {
+  return dst;
+}
+
+static inline float* rowBuffer(uint16_t*, float* buf) {
+  return buf;
+}
+
+static inline void narrowRow(const float* src, float* dst, size_t n) {
+  if (src != dst)
+    memcpy(dst, src, n * sizeof(float));
+}
+
+static inline void narrowRow(const float* src, uint16_t* dst, size_t n) {
+  floatToHalfKernel(src, dst, n);
+}
+
+template<typename TI, typename T>
+void QuantizeOp::quantize(bool symmetric) {
   auto input_tensor = getInputs()[0];
   auto output_tensor = getOutputs()[0];
+  const float quant_min = quantMin<T>(symmetric);
+  const float quant_max = quantMax<T>();
 
-  if (param_.quant_type == AFFINE_QUANTIZE_FLOAT32TOUINT8) {
-    float* input = reinterpret_cast<float *>(input_tensor->data_ptr);
-    uint8_t* output = reinterpret_cast<uint8_t *>(output_tensor->data_ptr);
-    int element_num = input_tensor->count();
-    float min = *std::min_element(input, input + element_num);
-    float max = *std::max_element(input, input + element_num);
+  if (!param_.static_range) {
+    // the range always covers 0 so that zero is exactly representable
+    float min = 0.f;
+    float max = 0.f;
+    forEachRow<TI, T>(input_tensor, output_tensor,
+        [&](const TI* src, T*, size_t n) {
+          float buf[kChunkSize];
+          for (size_t i = 0; i < n; i += kChunkSize) {
+            const size_t len = (std::min)(n - i, kChunkSize);
+            rangeKernel(widenRow(src + i, buf, len), len, &min, &max);
+          }
+        });
     input_tensor->setQuantizeRange(min, max);
 
-    const float quant_min = std::min(static_cast<float>(0), 0.0f);
-    const float quant_max = std::max(static_cast<float>(255), 0.0f);
-    const float scale = (max - min) / (quant_max - quant_min);
-    const float zero_point_from_min = min - min / scale;
-    int64_t zero_point;
-    if (zero_point_from_min < quant_min) {
-      zero_point = static_cast<int64_t>(quant_min);
-    } else if (zero_point_from_min > quant_max) {
-      zero_point = static_cast<int64_t>(quant_max);
+    float scale = 0.f;
+    int32_t zero_point = 0;
+    if (symmetric) {
+      scale = (std::max)(-min, max) / quant_max;
     } else {
-      zero_point = static_cast<int64_t>(round(zero_point_from_min));
-    }
-    output_tensor->setQuantizer(scale, zero_point);
-
-    const double inverse_scale = 1. / output_tensor->scale;
-    for (int i = 0; i < element_num; i++) {
-      const float src_val = input[i];
-      double scaled_val;
-      if (output_tensor->scale == 0) {
-        scaled_val = output_tensor->zero_point;
-      } else {
-        scaled_val = output_tensor->zero_point + inverse_scale * src_val;
+      scale = (max - min) / (quant_max - quant_min);
+      if (scale != 0.f) {
+        const float zero_point_from_min = quant_min - min / scale;
+        if (zero_point_from_min < quant_min) {
+          zero_point = static_cast<int32_t>(quant_min);
+        } else if (zero_point_from_min > quant_max) {
+          zero_point = static_cast<int32_t>(quant_max);
+        } else {
+          zero_point = static_cast<int32_t>(std::lrint(zero_point_from_min));
+        }
       }
-      output[i] = static_cast<uint8_t>(round(scaled_val));
-    }
-    min = *std::min_element(output, output + element_num);
-    max = *std::max_element(output, output + element_num);
-    output_tensor->setQuantizeRange(min, max);
-  } else if (param_.quant_type == AFFINE_DEQUANTIZE_UINT8TOFLOAT32) {
-    uint8_t* input = reinterpret_cast<uint8_t *>(input_tensor->data_ptr);
-    float* output = reinterpret_cast<float *>(output_tensor->data_ptr);
-    int element_num = input_tensor->count();
-    float min = *std::min_element(input, input + element_num);
-    float max = *std::max_element(input, input + element_num);
-
-    const int64_t number_of_steps = static_cast<int64_t>(1)
-                                    << (sizeof(uint8_t) * 8);
-    const float scale = (max - min) / (number_of_steps - 1.0);
-    const float range_min_rounded = max == min ? min
-                                    : round(min / scale) * scale;
-    const float lowest = min;
-    for (int i = 0; i < element_num; i++) {
-      float val = static_cast<float>(input[i]);
-      output[i] = (range_min_rounded - lowest * scale) + val * scale;
     }
-  } else {
-    throw std::runtime_error("QuantizeOP unsupport quantize strategy!");
+    output_tensor->setQuantizeParams(min, max, scale, zero_point);
+  }
+
+  const float inverse_scale = output_tensor->scale == 0.f ? 0.f
+                              : 1.f / output_tensor->scale;
+  const float zero_point = static_cast<float>(output_tensor->zero_point);
+  forEachRow<TI, T>(input_tensor, output_tensor,
+      [&](const TI* src, T* dst, size_t n) {
+        float buf[kChunkSize];
+        for (size_t i = 0; i < n; i += kChunkSize) {
+          const size_t len = (std::min)(n - i, kChunkSize);
+          quantizeKernel<T>(widenRow(src + i, buf, len), dst + i, len,
+                            inverse_scale, zero_point, quant_min, quant_max);
+        }
+      });
+}
+
+template<typename T, typename TO>
+void QuantizeOp::dequantize() {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+  // the quantizer of a quantized tensor is always known from its producer
+  const float scale = input_tensor->scale;
+  const float zero_point = static_cast<float>(input_tensor->zero_point);
+  output_tensor->setQuantizeRange(input_tensor->min_range,
+                                  input_tensor->max_range);
+  forEachRow<T, TO>(input_tensor, output_tensor,
+      [&](const T* src, TO* dst, size_t n) {
+        float buf[kChunkSize];
+        for (size_t i = 0; i < n; i += kChunkSize) {
+          const size_t len = (std::min)(n - i, kChunkSize);
+          float* out = rowBuffer(dst + i, buf);
+          dequantizeKernel<T>(src + i, out, len, scale, zero_point);
+          narrowRow(out, dst + i, len);
+        }
+      });
+}
+
+template<typename TI, typename TO>
+void QuantizeOp::cast() {
+  auto input_tensor = getInputs()[0];
+  auto output_tensor = getOutputs()[0];
+  output_tensor->setQuantizeParams(input_tensor->min_range,
+                                   input_tensor->max_range,
+                                   input_tensor->scale,
+                                   input_tensor->zero_point);
+  forEachRow<TI, TO>(input_tensor, output_tensor,
+      [&](const TI* src, TO* dst, size_t n) {
+        float buf[kChunkSize];
+        for (size_t i = 0; i < n; i += kChunkSize) {
+          const size_t len = (std::min)(n - i, kChunkSize);
+          narrowRow(widenRow(src + i, buf, len), dst + i, len);
+        }
+      });
+}
+
+inline void QuantizeOp::forward_compute() {
+  switch (param_.quant_type) {
+    case AFFINE_QUANTIZE_FLOAT32TOUINT8:
+      quantize<float, uint8_t>(false);
+      break;
+    case AFFINE_QUANTIZE_FLOAT32TOUINT16:
+      quantize<float, uint16_t>(false);
+      break;
+    case SYMMETRIC_QUANTIZE_FLOAT32TOINT8:
+      quantize<float, int8_t>(true);
+      break;
+    case SYMMETRIC_QUANTIZE_FLOAT32TOINT16:
+      quantize<float, int16_t>(true);
+      break;
+    case AFFINE_DEQUANTIZE_UINT8TOFLOAT32:
+      dequantize<uint8_t, float>();
+      break;
+    case AFFINE_DEQUANTIZE_UINT16TOFLOAT32:
+      dequantize<uint16_t, float>();
+      break;
+    case SYMMETRIC_DEQUANTIZE_INT8TOFLOAT32:
+      dequantize<int8_t, float>();
+      break;
+    case SYMMETRIC_DEQUANTIZE_INT16TOFLOAT32:
+      dequantize<int16_t, float>();
+      break;
+    case CAST_FLOAT32TOFLOAT16:
+      cast<float, uint16_t>();
+      break;
+    case CAST_FLOAT16TOFLOAT32:
+      cast<uint16_t, float>();
+      break;
+    case AFFINE_QUANTIZE_FLOAT16TOUINT8:
+      quantize<uint16_t, uint8_t>(false);
+      break;
+    case AFFINE_DEQUANTIZE_UINT8TOFLOAT16:
+      dequantize<uint8_t, uint16_t>();
+      break;
+    default:
+      throw std::runtime_error("QuantizeOP unsupport quantize strategy!");
   }
 }
 
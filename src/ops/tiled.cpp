@@ -0,0 +1,189 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include "include/ops/tiled.hpp"
+
+namespace RVTensor {
+
+TiledOp::sptr TiledOp::create() {
+  return std::make_shared<TiledOp>();
+}
+
+TiledOp::sptr TiledOp::create(std::vector<Operation::sptr> chain, int rows) {
+  TiledOp::sptr ptr = std::make_shared<TiledOp>(chain, rows);
+  ptr->checkOutputDims();
+  ptr->bindScratch();
+  return ptr;
+}
+
+/**
+ * first input of the chain, last output of the chain
+ */
+static std::vector<RamTensor::sptr> chainInputs(
+    const std::vector<Operation::sptr>& chain) {
+  if (chain.empty() || chain.front()->getInputs().empty())
+    return {};
+  return {chain.front()->getInputs()[0]};
+}
+
+static std::vector<RamTensor::sptr> chainOutputs(
+    const std::vector<Operation::sptr>& chain) {
+  if (chain.empty() || chain.back()->getOutputs().empty())
+    return {};
+  return {chain.back()->getOutputs()[0]};
+}
+
+inline TiledOp::TiledOp() : Operation({}, {}), rows_(0),
+                            allocator_(nullptr), scratch_(nullptr),
+                            scratch_size_(0) {}
+
+inline TiledOp::TiledOp(std::vector<Operation::sptr> chain, int rows)
+  : Operation(chainInputs(chain), chainOutputs(chain)), chain_(chain),
+    rows_(rows), allocator_(nullptr), scratch_(nullptr), scratch_size_(0) {}
+
+inline TiledOp::~TiledOp() {
+  if (scratch_)
+    allocator_->deallocate(scratch_);
+}
+
+inline void TiledOp::checkOutputDims() {
+  if (chain_.empty() || rows_ < 1)
+    throw std::runtime_error("TiledOp chain or rows is wrong!");
+
+  tensors_.clear();
+  for (auto& op : chain_) {
+    if (!op->supportsRows() || op->getInputs().size() != 1 ||
+        op->getOutputs().size() != 1)
+      throw std::runtime_error("TiledOp op can not run by bands!");
+    if (!tensors_.empty() && op->getInputs()[0] != tensors_.back())
+      throw std::runtime_error("TiledOp ops are not a chain!");
+    if (tensors_.empty())
+      tensors_.push_back(op->getInputs()[0]);
+    tensors_.push_back(op->getOutputs()[0]);
+  }
+
+  for (size_t t = 1; t + 1 < tensors_.size(); t++) {
+    const RamTensor::sptr& tensor = tensors_[t];
+    if (!tensor->isContiguous() || tensor->data_type == DataType::INT4 ||
+        tensor == tensors_.front() || tensor == tensors_.back())
+      throw std::runtime_error("TiledOp intermediate tensor is wrong!");
+  }
+}
+
+void TiledOp::bandRows(int h0, int h1, std::vector<int>* begin,
+                       std::vector<int>* end) {
+  const size_t count = tensors_.size();
+  begin->resize(count);
+  end->resize(count);
+  (*begin)[count - 1] = h0;
+  (*end)[count - 1] = h1;
+  for (size_t i = chain_.size(); i-- > 0;) {
+    if ((*begin)[i + 1] >= (*end)[i + 1]) {
+      (*begin)[i] = 0;
+      (*end)[i] = 0;
+      continue;
+    }
+    chain_[i]->inputRows((*begin)[i + 1], (*end)[i + 1], &(*begin)[i],
+                         &(*end)[i]);
+  }
+}
+
+void TiledOp::bindScratch() {
+  const int height = tensors_.back()->height;
+  const size_t count = tensors_.size();
+
+  // rows of the largest band of every intermediate
+  std::vector<int> capacity(count, 1);
+  std::vector<int> begin, end;
+  for (int h0 = 0; h0 < height; h0 += rows_) {
+    bandRows(h0, (std::min)(h0 + rows_, height), &begin, &end);
+    for (size_t t = 1; t + 1 < count; t++)
+      capacity[t] = (std::max)(capacity[t], end[t] - begin[t]);
+  }
+
+  offsets_.assign(count, 0);
+  size_t alignment = MALLOC_ALIGN;
+  for (size_t t = 1; t + 1 < count; t++) {
+    RamTensor::sptr tensor = tensors_[t];
+    const size_t plane = alignSize(capacity[t] * tensor->rowStep() *
+                                   tensor->element_size,
+                                   tensor->alignment);
+    scratch_size_ = alignSize(scratch_size_, tensor->alignment);
+    offsets_[t] = scratch_size_;
+    scratch_size_ += plane * tensor->groups() * tensor->n_batch;
+    alignment = (std::max)(alignment, tensor->alignment);
+  }
+
+  if (scratch_size_ > 0) {
+    allocator_ = Allocator::getDefault();
+    scratch_ = reinterpret_cast<uint8_t*>(allocator_->allocate(
+                                            scratch_size_, alignment));
+    if (!scratch_)
+      throw std::runtime_error("TiledOp out of memory!");
+  }
+  for (size_t t = 1; t + 1 < count; t++) {
+    RamTensor::sptr tensor = tensors_[t];
+    // the whole map is released, planes are one band apart
+    tensor->bindData(scratch_ + offsets_[t]);
+    tensor->cstep = alignSize(capacity[t] * tensor->rowStep() *
+                              tensor->element_size, tensor->alignment) /
+                    tensor->element_size;
+  }
+}
+
+size_t TiledOp::scratchSize() const {
+  return scratch_size_;
+}
+
+void TiledOp::moveBand(size_t t, int begin, int held_begin,
+                       int held_end) {
+  RamTensor::sptr tensor = tensors_[t];
+  uint8_t* slice = scratch_ + offsets_[t];
+  const size_t row_bytes = tensor->rowStep() * tensor->element_size;
+  if (begin > held_begin && begin < held_end) {
+    const size_t plane_bytes = tensor->cstep * tensor->element_size;
+    for (int p = 0; p < tensor->n_batch * tensor->groups(); p++) {
+      uint8_t* plane = slice + p * plane_bytes;
+      memmove(plane, plane + (begin - held_begin) * row_bytes,
+              (held_end - begin) * row_bytes);
+    }
+  }
+  // row begin is the first row of the slice
+  tensor->data_ptr = slice - static_cast<size_t>(begin) * row_bytes;
+}
+
+inline void TiledOp::forward_compute() {
+  const int height = tensors_.back()->height;
+  const size_t count = tensors_.size();
+  std::vector<int> begin, end;
+  // rows of the intermediates computed by the bands before, and the first
+  // row every op computes for this band
+  std::vector<int> held_begin(count, 0), held_end(count, 0);
+  std::vector<int> first(count);
+  for (int h0 = 0; h0 < height; h0 += rows_) {
+    bandRows(h0, (std::min)(h0 + rows_, height), &begin, &end);
+    first[count - 1] = h0;
+    for (size_t t = 1; t + 1 < count; t++) {
+      if (begin[t] >= end[t])
+        continue;
+      const bool held = begin[t] >= held_begin[t] && begin[t] < held_end[t];
+      moveBand(t, begin[t], held_begin[t], held_end[t]);
+      first[t] = held ? held_end[t] : begin[t];
+      held_begin[t] = begin[t];
+      held_end[t] = (std::max)(end[t], first[t]);
+    }
+    for (size_t i = 0; i < chain_.size(); i++) {
+      if (begin[i + 1] < end[i + 1] && first[i + 1] < end[i + 1])
+        chain_[i]->forwardRows(first[i + 1], end[i + 1]);
+    }
+  }
+}
+
+}  // namespace RVTensor
@@ -0,0 +1,282 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "tools/calibrator/calibrator.hpp"
+#include "include/ops/quantize_kernel.hpp"
+
+namespace RVTensor {
+
+/// markers of the generated calibration block in *_model_data.hpp
+static const char kBlockBegin[] = "// RVTensor calibration begin";
+static const char kBlockEnd[] = "// RVTensor calibration end";
+
+/// quantized levels the KL divergence search maps a distribution onto
+static const int kQuantizeLevels = 128;
+
+Calibrator::sptr Calibrator::create(CalibrationMethod method, int bins,
+                                    float percentile) {
+  return std::make_shared<Calibrator>(method, bins, percentile);
+}
+
+Calibrator::Calibrator(CalibrationMethod method, int bins, float percentile)
+  : method_(method), bins_(bins), percentile_(percentile),
+    pass_(RANGE_PASS) {
+  if (bins_ < kQuantizeLevels)
+    throw std::runtime_error("Calibrator needs at least 128 bins!");
+}
+
+Calibrator::~Calibrator() {}
+
+void Calibrator::beginPass(Pass pass) {
+  pass_ = pass;
+  if (pass_ == HISTOGRAM_PASS) {
+    for (auto& it : stats_) {
+      it.second.histogram.assign(bins_, 0);
+      it.second.abs_histogram.assign(bins_, 0);
+    }
+  }
+}
+
+void Calibrator::observe(RamTensor::sptr tensor, void* userdata) {
+  reinterpret_cast<Calibrator*>(userdata)->collect(tensor);
+}
+
+void Calibrator::collect(RamTensor::sptr tensor) {
+  if (tensor->name.empty() || tensor->data_ptr == nullptr)
+    return;
+
+  const size_t plane_size = tensor->height * tensor->width;
+  const int plane_num = tensor->n_batch * tensor->channel;
+  std::vector<float> plane(plane_size);
+  for (int p = 0; p < plane_num; p++) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(tensor->data_ptr) +
+                         p * tensor->cstep * tensor->element_size;
+    const float zero = static_cast<float>(tensor->zero_point);
+    switch (tensor->data_type) {
+      case FLOAT32:
+        collect(tensor->name, reinterpret_cast<const float*>(src), plane_size);
+        continue;
+      case UINT8:
+        dequantizeKernel(src, plane.data(), plane_size, tensor->scale, zero);
+        break;
+      case INT8:
+        dequantizeKernel(reinterpret_cast<const int8_t*>(src), plane.data(),
+                         plane_size, tensor->scale, zero);
+        break;
+      case UINT16:
+        dequantizeKernel(reinterpret_cast<const uint16_t*>(src), plane.data(),
+                         plane_size, tensor->scale, zero);
+        break;
+      case INT16:
+        dequantizeKernel(reinterpret_cast<const int16_t*>(src), plane.data(),
+                         plane_size, tensor->scale, zero);
+        break;
+      default:
+        throw std::runtime_error("Calibrator unsupport data type!");
+    }
+    collect(tensor->name, plane.data(), plane_size);
+  }
+}
+
+void Calibrator::collect(const std::string& name, const float* data,
+                         size_t n) {
+  if (pass_ == RANGE_PASS) {
+    auto it = stats_.find(name);
+    if (it == stats_.end()) {
+      // the range always covers 0 so that zero is exactly representable
+      it = stats_.insert(std::make_pair(name, Statistic{0.f, 0.f, {}, {}}))
+           .first;
+    }
+    rangeKernel(data, n, &it->second.min, &it->second.max);
+    return;
+  }
+
+  auto it = stats_.find(name);
+  if (it == stats_.end())
+    throw std::runtime_error("Calibrator tensor missed in range pass!");
+  Statistic& stat = it->second;
+  const float width = stat.max - stat.min;
+  const float abs_max = (std::max)(-stat.min, stat.max);
+  if (width <= 0.f)
+    return;
+  for (size_t i = 0; i < n; i++) {
+    int bin = static_cast<int>((data[i] - stat.min) / width * bins_);
+    stat.histogram[(std::min)((std::max)(bin, 0), bins_ - 1)]++;
+    int abs_bin = static_cast<int>(std::fabs(data[i]) / abs_max * bins_);
+    stat.abs_histogram[(std::min)(abs_bin, bins_ - 1)]++;
+  }
+}
+
+float Calibrator::percentileRange(const Statistic& stat, float* min) const {
+  uint64_t total = 0;
+  for (auto count : stat.histogram)
+    total += count;
+  const double tail = total * (1.0 - percentile_ / 100.0);
+  const float bin_width = (stat.max - stat.min) / bins_;
+
+  int low = 0;
+  for (double sum = 0; low < bins_; low++) {
+    sum += stat.histogram[low];
+    if (sum > tail)
+      break;
+  }
+  int high = bins_ - 1;
+  for (double sum = 0; high > low; high--) {
+    sum += stat.histogram[high];
+    if (sum > tail)
+      break;
+  }
+  *min = stat.min + low * bin_width;
+  return stat.min + (high + 1) * bin_width;
+}
+
+float Calibrator::klThreshold(const Statistic& stat) const {
+  const std::vector<uint64_t>& hist = stat.abs_histogram;
+  const float bin_width = (std::max)(-stat.min, stat.max) / bins_;
+
+  int best = bins_;
+  double best_divergence = std::numeric_limits<double>::max();
+  std::vector<double> p(bins_);
+  std::vector<double> q(bins_);
+  for (int i = kQuantizeLevels; i <= bins_; i++) {
+    // reference distribution clipped at bin i, outliers folded into the edge
+    double outliers = 0;
+    for (int j = i; j < bins_; j++)
+      outliers += hist[j];
+    for (int j = 0; j < i; j++)
+      p[j] = static_cast<double>(hist[j]);
+    p[i - 1] += outliers;
+
+    // the same distribution after quantization to kQuantizeLevels
+    const double merge = static_cast<double>(i) / kQuantizeLevels;
+    for (int level = 0; level < kQuantizeLevels; level++) {
+      const int start = static_cast<int>(level * merge);
+      const int end = (std::min)(static_cast<int>((level + 1) * merge), i);
+      double sum = 0;
+      int nonzero = 0;
+      for (int j = start; j < end; j++) {
+        sum += p[j];
+        nonzero += p[j] != 0;
+      }
+      for (int j = start; j < end; j++)
+        q[j] = p[j] != 0 ? sum / nonzero : 0;
+    }
+
+    double p_sum = 0;
+    double q_sum = 0;
+    for (int j = 0; j < i; j++) {
+      p_sum += p[j];
+      q_sum += q[j];
+    }
+    if (p_sum == 0 || q_sum == 0)
+      continue;
+
+    double divergence = 0;
+    for (int j = 0; j < i; j++) {
+      if (p[j] == 0)
+        continue;
+      const double pj = p[j] / p_sum;
+      const double qj = q[j] == 0 ? 1e-12 : q[j] / q_sum;
+      divergence += pj * std::log(pj / qj);
+    }
+    if (divergence < best_divergence) {
+      best_divergence = divergence;
+      best = i;
+    }
+  }
+  return (best + 0.5f) * bin_width;
+}
+
+Calibrator::Result Calibrator::pickRange(const Statistic& stat) const {
+  float min = stat.min;
+  float max = stat.max;
+  if (method_ == CALIBRATE_PERCENTILE && !stat.histogram.empty()) {
+    max = percentileRange(stat, &min);
+  } else if (method_ == CALIBRATE_KL_DIVERGENCE &&
+             !stat.abs_histogram.empty()) {
+    const float threshold = klThreshold(stat);
+    min = (std::max)(min, -threshold);
+    max = (std::min)(max, threshold);
+  }
+  min = (std::min)(min, 0.f);
+  max = (std::max)(max, 0.f);
+
+  Result result = {min, max, 0.f, 0};
+  result.scale = (max - min) / 255.f;
+  if (result.scale != 0.f) {
+    long zero_point = std::lrint(-min / result.scale);  // NOLINT
+    result.zero_point = static_cast<int32_t>(
+                          (std::min)((std::max)(zero_point, 0l), 255l));
+  }
+  return result;
+}
+
+std::map<std::string, Calibrator::Result> Calibrator::compute() const {
+  std::map<std::string, Result> results;
+  for (auto& it : stats_)
+    results[it.first] = pickRange(it.second);
+  return results;
+}
+
+void Calibrator::writeModelData(const std::string& path) const {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("Calibrator can not read " + path);
+  std::stringstream buf;
+  buf << in.rdbuf();
+  std::string text = buf.str();
+  in.close();
+
+  std::ostringstream block;
+  block << kBlockBegin << "\n";
+  auto float_line = [&](const std::string& name, const char* field,
+                        float value) {
+    char literal[32];
+    snprintf(literal, sizeof(literal), "%.9ef", value);
+    block << "static const float " << name << "_" << field << " = "
+          << literal << ";\n";
+  };
+  for (auto& it : compute()) {
+    float_line(it.first, "min_range", it.second.min_range);
+    float_line(it.first, "max_range", it.second.max_range);
+    float_line(it.first, "scale", it.second.scale);
+    block << "static const int32_t " << it.first << "_zero_point = "
+          << it.second.zero_point << ";\n";
+  }
+  block << kBlockEnd << "\n";
+
+  size_t begin = text.find(kBlockBegin);
+  if (begin != std::string::npos) {
+    size_t end = text.find(kBlockEnd, begin);
+    if (end == std::string::npos)
+      throw std::runtime_error("Calibrator broken calibration block!");
+    end = text.find('\n', end);
+    text.replace(begin, end == std::string::npos ? std::string::npos
+                        : end + 1 - begin, block.str());
+  } else {
+    // insert before the brace closing the namespace
+    size_t guard = text.rfind("#endif");
+    size_t brace = text.rfind("\n}", guard);
+    if (brace == std::string::npos)
+      throw std::runtime_error("Calibrator unknown model data layout!");
+    text.insert(brace + 1, "\n" + block.str());
+  }
+
+  std::ofstream out(path);
+  if (!out)
+    throw std::runtime_error("Calibrator can not write " + path);
+  out << text;
+}
+
+}  // namespace RVTensor
@@ -0,0 +1,113 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef TOOLS_CALIBRATOR_CALIBRATOR_HPP_
+#define TOOLS_CALIBRATOR_CALIBRATOR_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include "include/core/tensor.hpp"
+
+namespace RVTensor {
+
+/// how the static range of a tensor is picked from its histogram
+enum CalibrationMethod {
+  CALIBRATE_MINMAX         = 0,  // observed min/max
+  CALIBRATE_PERCENTILE     = 1,  // clip both tails at a percentile
+  CALIBRATE_KL_DIVERGENCE  = 2   // threshold with minimal KL divergence
+};
+
+/**
+ * Calibrator collects activation statistics of a float model over sample
+ * inputs and turns them into static quantize params (affine uint8). The
+ * model runs as the float32 reference pass of the compiler,
+ * <model>_model_calibrate, so that the ranges do not depend on the params
+ * of an earlier calibration.
+ *
+ * Statistics are gathered in two passes over the same samples:
+ *   RANGE_PASS:     min/max of every tensor
+ *   HISTOGRAM_PASS: histograms over the ranges found by the first pass
+ */
+class Calibrator {
+ public:
+    using sptr = std::shared_ptr<Calibrator>;
+    static sptr create(CalibrationMethod method, int bins = 2048,
+                       float percentile = 99.99f);
+
+    enum Pass {
+      RANGE_PASS     = 0,
+      HISTOGRAM_PASS = 1
+    };
+
+    /**
+     * Constructor & Deconstructor
+     */
+    Calibrator(CalibrationMethod method, int bins, float percentile);
+    ~Calibrator();
+
+    /**
+     * start collecting the given pass
+     */
+    void beginPass(Pass pass);
+
+    /**
+     * collect statistics of a named tensor; integer tensors are
+     * dequantized with their current quantizer
+     */
+    void collect(RamTensor::sptr tensor);
+
+    /**
+     * tensor observer usable with Operation::setObserver,
+     * userdata is the Calibrator
+     */
+    static void observe(RamTensor::sptr tensor, void* userdata);
+
+    struct Result {
+      float min_range;
+      float max_range;
+      float scale;
+      int32_t zero_point;
+    };
+
+    /**
+     * pick the ranges of all collected tensors
+     */
+    std::map<std::string, Result> compute() const;
+
+    /**
+     * write the results into the calibration block of a generated
+     * compiled/<model>_model_data.hpp, replacing a previous block
+     */
+    void writeModelData(const std::string& path) const;
+
+ private:
+    struct Statistic {
+      float min;
+      float max;
+      /// signed histogram over [min, max]
+      std::vector<uint64_t> histogram;
+      /// histogram of absolute values over [0, max(|min|, |max|)]
+      std::vector<uint64_t> abs_histogram;
+    };
+
+    void collect(const std::string& name, const float* data, size_t n);
+    Result pickRange(const Statistic& stat) const;
+    float percentileRange(const Statistic& stat, float* min) const;
+    float klThreshold(const Statistic& stat) const;
+
+    CalibrationMethod method_;
+    int bins_;
+    float percentile_;
+    Pass pass_;
+    std::map<std::string, Statistic> stats_;
+};
+
+}  // namespace RVTensor
+
+#endif  // TOOLS_CALIBRATOR_CALIBRATOR_HPP_
@@ -0,0 +1,150 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <dirent.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "include/core/operation.hpp"
+#include "compiled/model_execute.hpp"
+#include "tools/calibrator/calibrator.hpp"
+
+using RVTensor::Calibrator;
+using RVTensor::RamTensor;
+
+/// float32 reference passes of the compiled models the calibrator can run
+static const struct {
+  const char* name;
+  RamTensor::sptr (*calibrate)(RamTensor::sptr input);
+  int channel;
+  int height;
+  int width;
+} kModels[] = {
+  {"yolov3", RVTensor::yolov3_model_calibrate, 3, 240, 320},
+};
+
+/**
+ * read a binary PPM (P6) image into a planar RGB tensor
+ */
+static bool loadPPM(const std::string& path, RamTensor::sptr input) {
+  std::ifstream in(path, std::ios::binary);
+  std::string magic;
+  int width = 0, height = 0, max_value = 0;
+  in >> magic >> width >> height >> max_value;
+  in.get();
+  if (!in || magic != "P6" || max_value != 255 ||
+      width != input->width || height != input->height) {
+    std::cerr << "skip " << path << ": not a " << input->width << "x"
+              << input->height << " P6 image" << std::endl;
+    return false;
+  }
+
+  std::vector<uint8_t> pixels(width * height * 3);
+  in.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+  if (!in)
+    return false;
+  uint8_t* data = reinterpret_cast<uint8_t*>(input->data_ptr);
+  for (int c = 0; c < input->channel; c++) {
+    for (int i = 0; i < width * height; i++)
+      data[c * input->cstep + i] = pixels[i * 3 + c];
+  }
+  return true;
+}
+
+static void usage(const char* argv0) {
+  std::cerr << "usage: " << argv0
+            << " <model> <image_dir> <model_data.hpp>"
+            << " [minmax|percentile|kl]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const std::string model_name = argv[1];
+  const std::string image_dir = argv[2];
+  const std::string model_data = argv[3];
+  const std::string method_name = argc > 4 ? argv[4] : "minmax";
+
+  RVTensor::CalibrationMethod method;
+  if (method_name == "minmax") {
+    method = RVTensor::CALIBRATE_MINMAX;
+  } else if (method_name == "percentile") {
+    method = RVTensor::CALIBRATE_PERCENTILE;
+  } else if (method_name == "kl") {
+    method = RVTensor::CALIBRATE_KL_DIVERGENCE;
+  } else {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const auto* model = std::find_if(std::begin(kModels), std::end(kModels),
+      [&](decltype(kModels[0]) m) { return model_name == m.name; });
+  if (model == std::end(kModels)) {
+    std::cerr << "unknown model " << model_name << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> images;
+  DIR* dir = opendir(image_dir.c_str());
+  if (dir == nullptr) {
+    std::cerr << "can not open " << image_dir << std::endl;
+    return 1;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    const std::string file = entry->d_name;
+    if (file.size() > 4 && file.compare(file.size() - 4, 4, ".ppm") == 0)
+      images.push_back(image_dir + "/" + file);
+  }
+  closedir(dir);
+  std::sort(images.begin(), images.end());
+
+  try {
+    Calibrator::sptr calibrator = Calibrator::create(method);
+    RVTensor::Operation::setObserver(Calibrator::observe, calibrator.get());
+    RamTensor::sptr input = RamTensor::create(1, model->channel,
+        model->height, model->width, 1u);
+
+    const Calibrator::Pass passes[] = {Calibrator::RANGE_PASS,
+                                       Calibrator::HISTOGRAM_PASS};
+    size_t used = 0;
+    for (auto pass : passes) {
+      calibrator->beginPass(pass);
+      used = 0;
+      for (auto& image : images) {
+        if (!loadPPM(image, input))
+          continue;
+        RamTensor::sptr output = model->calibrate(input);
+        calibrator->collect(input);
+        used++;
+      }
+    }
+    RVTensor::Operation::setObserver(nullptr, nullptr);
+
+    if (used == 0) {
+      std::cerr << "no usable images in " << image_dir << std::endl;
+      return 1;
+    }
+    calibrator->writeModelData(model_data);
+    for (auto& it : calibrator->compute()) {
+      std::cout << it.first << ": [" << it.second.min_range << ", "
+                << it.second.max_range << "] scale " << it.second.scale
+                << " zero_point " << it.second.zero_point << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
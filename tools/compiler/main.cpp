@@ -0,0 +1,52 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "tools/compiler/model_compiler.hpp"
+
+static void usage(const char* argv0) {
+  std::cerr << "usage: " << argv0
+            << " <model.rvt> <out_dir> [--binary <model.rvtm>]"
+            << " [--tuning <tuning_cache>]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  std::string binary, tuning;
+  bool valid = argc >= 3 && argc % 2 == 1;
+  for (int i = 3; valid && i < argc; i += 2) {
+    if (std::string(argv[i]) == "--binary")
+      binary = argv[i + 1];
+    else if (std::string(argv[i]) == "--tuning")
+      tuning = argv[i + 1];
+    else
+      valid = false;
+  }
+  if (!valid) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    RVTensor::ModelDesc model = RVTensor::parseModelDesc(argv[1]);
+    if (!tuning.empty()) {
+      std::cout << model.name << ": "
+                << RVTensor::applyConvTuning(&model, tuning)
+                << " tuned convs" << std::endl;
+    }
+    RVTensor::emitCompiledModel(model, argv[2]);
+    if (!binary.empty())
+      RVTensor::emitSerializedModel(model, binary);
+    std::cout << model.name << ": " << model.tensors.size() << " tensors, "
+              << model.ops.size() << " ops" << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,870 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include "tools/compiler/model_compiler.hpp"
+#include "include/core/allocator.hpp"
+#include "include/core/half.hpp"
+#include "include/core/int4.hpp"
+#include "include/core/model_format.hpp"
+#include "include/core/weight_codec.hpp"
+#include "include/ops/conv_tuner.hpp"
+
+namespace RVTensor {
+
+static const struct {
+  const char* name;
+  DataType type;
+  size_t element_size;
+  const char* c_type;
+} kTypeTable[] = {
+  {"float32", FLOAT32, 4, "float"},
+  {"int32",   INT32,   4, "int32_t"},
+  {"uint16",  UINT16,  2, "uint16_t"},
+  {"int16",   INT16,   2, "int16_t"},
+  {"float16", FLOAT16, 2, "uint16_t"},
+  {"uint8",   UINT8,   1, "uint8_t"},
+  {"int8",    INT8,    1, "int8_t"},
+  {"int4",    INT4,    1, "uint8_t"},
+};
+
+static const struct {
+  const char* name;
+  ActivationType type;
+} kActivationTable[] = {
+  {"relu",       ACTIVATION_RELU},
+  {"relu6",      ACTIVATION_RELU6},
+  {"leaky_relu", ACTIVATION_LEAKY_RELU},
+  {"sigmoid",    ACTIVATION_SIGMOID},
+  {"tanh",       ACTIVATION_TANH},
+};
+
+static const struct {
+  const char* name;
+  PoolType type;
+} kPoolTable[] = {
+  {"max",     POOL_MAX},
+  {"average", POOL_AVERAGE},
+};
+
+static const char* typeName(DataType type) {
+  for (auto& entry : kTypeTable) {
+    if (entry.type == type)
+      return entry.name;
+  }
+  return "float32";
+}
+
+static const char* cTypeName(DataType type) {
+  for (auto& entry : kTypeTable) {
+    if (entry.type == type)
+      return entry.c_type;
+  }
+  return "float";
+}
+
+static std::string dataTypeEnum(DataType type) {
+  std::string name = typeName(type);
+  for (auto& ch : name)
+    ch = toupper(ch);
+  return name;
+}
+
+/// float literal that is valid C++ for any value
+static std::string floatLiteral(float value) {
+  char literal[32];
+  snprintf(literal, sizeof(literal), "%.9ef", value);
+  return literal;
+}
+
+/// real range represented by a quantized tensor
+static void quantizedRange(const TensorDesc& t, float* min, float* max) {
+  double lo = 0, hi = 0;
+  switch (t.type) {
+    case UINT8:  lo = 0; hi = 255; break;
+    case INT8:   lo = -128; hi = 127; break;
+    case UINT16: lo = 0; hi = 65535; break;
+    case INT16:  lo = -32768; hi = 32767; break;
+    case INT4:   lo = -kInt4Max; hi = kInt4Max; break;
+    default: *min = 0.f; *max = 0.f; return;
+  }
+  *min = static_cast<float>((lo - t.zero_point) * t.scale);
+  *max = static_cast<float>((hi - t.zero_point) * t.scale);
+}
+
+static void appendValue(TensorDesc* t, double value) {
+  uint8_t bytes[4];
+  switch (t->type) {
+    case FLOAT32: { float v = static_cast<float>(value);
+                    memcpy(bytes, &v, 4); break; }
+    case INT32:   { int32_t v = static_cast<int32_t>(value);
+                    memcpy(bytes, &v, 4); break; }
+    case UINT16:  { uint16_t v = static_cast<uint16_t>(value);
+                    memcpy(bytes, &v, 2); break; }
+    case INT16:   { int16_t v = static_cast<int16_t>(value);
+                    memcpy(bytes, &v, 2); break; }
+    case FLOAT16: { uint16_t v = floatToHalf(static_cast<float>(value));
+                    memcpy(bytes, &v, 2); break; }
+    case UINT8:   { bytes[0] = static_cast<uint8_t>(value); break; }
+    case INT8:    { bytes[0] = static_cast<uint8_t>(
+                                 static_cast<int8_t>(value)); break; }
+    // one value per byte until packInt4Data
+    case INT4:    { bytes[0] = static_cast<uint8_t>(
+                                 static_cast<int8_t>(value)); break; }
+    default: break;
+  }
+  t->data.insert(t->data.end(), bytes, bytes + t->element_size);
+}
+
+/// pack the int8 values of an INT4 constant, two per byte per batch item
+static void packInt4Data(TensorDesc* t) {
+  const size_t item = static_cast<size_t>(t->c) * t->h * t->w;
+  std::vector<uint8_t> packed(t->n * int4Bytes(item));
+  std::vector<int32_t> values(item);
+  for (int n = 0; n < t->n; n++) {
+    for (size_t i = 0; i < item; i++)
+      values[i] = static_cast<int8_t>(t->data[n * item + i]);
+    packInt4(values.data(), &packed[n * int4Bytes(item)], item);
+  }
+  t->data.swap(packed);
+}
+
+const TensorDesc& ModelDesc::tensor(const std::string& tensor_name) const {
+  for (auto& t : tensors) {
+    if (t.name == tensor_name)
+      return t;
+  }
+  throw std::runtime_error("unknown tensor " + tensor_name);
+}
+
+ModelDesc parseModelDesc(const std::string& path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("can not read " + path);
+  std::string dir = path.substr(0, path.find_last_of('/') + 1);
+
+  ModelDesc model;
+  std::string line;
+  int line_no = 0;
+  while (std::getline(in, line)) {
+    line_no++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    std::string keyword;
+    if (!(tokens >> keyword))
+      continue;
+
+    auto fail = [&](const std::string& what) {
+      throw std::runtime_error(path + ":" + std::to_string(line_no) + ": " +
+                               what);
+    };
+
+    if (keyword == "model") {
+      tokens >> model.name;
+    } else if (keyword == "input" || keyword == "tensor" ||
+               keyword == "const") {
+      TensorDesc t;
+      std::string type;
+      if (!(tokens >> t.name >> t.n >> t.c >> t.h >> t.w >> type))
+        fail("expect <name> <n> <c> <h> <w> <type>");
+      bool known = false;
+      for (auto& entry : kTypeTable) {
+        if (type == entry.name) {
+          t.type = entry.type;
+          t.element_size = entry.element_size;
+          known = true;
+        }
+      }
+      if (!known)
+        fail("unknown type " + type);
+      t.scale = 1.f;
+      t.zero_point = 0;
+      t.is_input = keyword == "input";
+      t.is_const = keyword == "const";
+      t.alignment = 0;
+      t.compress_block = 0;
+
+      std::string next;
+      tokens >> next;
+      if (!next.empty() && next != "fill" && next != "data" &&
+          next != "file" && next != "scales" && next != "compress") {
+        t.scale = std::stof(next);
+        if (!(tokens >> t.zero_point))
+          fail("expect <scale> <zero_point>");
+        next.clear();
+        tokens >> next;
+      }
+      while (next == "scales" || next == "compress") {
+        if (next == "scales") {
+          t.channel_scales.resize(t.n);
+          for (auto& scale : t.channel_scales) {
+            if (!(tokens >> scale))
+              fail("expect scales <s0> ... <s" + std::to_string(t.n - 1) +
+                   ">");
+          }
+        } else if (!(tokens >> t.compress_block) || t.compress_block <= 0) {
+          fail("expect compress <channels>");
+        }
+        next.clear();
+        tokens >> next;
+      }
+
+      if (t.is_const) {
+        const size_t count = static_cast<size_t>(t.n) * t.c * t.h * t.w;
+        double value;
+        if (next == "fill") {
+          if (!(tokens >> value))
+            fail("expect fill <value>");
+          for (size_t i = 0; i < count; i++)
+            appendValue(&t, value);
+        } else if (next == "data") {
+          while (tokens >> value)
+            appendValue(&t, value);
+        } else if (next == "file") {
+          std::string file;
+          tokens >> file;
+          std::ifstream raw(file[0] == '/' ? file : dir + file,
+                            std::ios::binary);
+          if (!raw)
+            fail("can not read " + file);
+          t.data.assign(std::istreambuf_iterator<char>(raw),
+                        std::istreambuf_iterator<char>());
+        } else {
+          fail("const needs fill, data or file");
+        }
+        // raw files of INT4 constants are already packed
+        if (t.type == INT4 && next != "file") {
+          if (t.data.size() != count)
+            fail("const " + t.name + " data size mismatch");
+          packInt4Data(&t);
+        }
+        const size_t size = t.type == INT4
+            ? t.n * int4Bytes(static_cast<size_t>(t.c) * t.h * t.w)
+            : count * t.element_size;
+        if (t.data.size() != size)
+          fail("const " + t.name + " data size mismatch");
+        if (t.compress_block) {
+          t.data = encodeWeights(t.data.data(), size / t.n, t.n,
+                                 t.compress_block);
+        }
+      } else if (!t.channel_scales.empty() || t.type == INT4 ||
+                 t.compress_block) {
+        fail("int4, scales and compress are for const only");
+      }
+      if (t.is_input)
+        model.input = t.name;
+      model.tensors.push_back(t);
+    } else if (keyword == "conv" || keyword == "kpu_conv") {
+      OpDesc op;
+      op.type = keyword;
+      op.params.resize(6);
+      if (!(tokens >> op.name >> op.input >> op.output >> op.weight >>
+            op.bias >> op.params[0] >> op.params[1] >> op.params[2] >>
+            op.params[3] >> op.params[4] >> op.params[5]))
+        fail("expect <op> <input> <output> <weight> <bias|-> "
+             "<sw> <sh> <dw> <dh> <pw> <ph>");
+      if (op.bias == "-")
+        op.bias.clear();
+      op.tuning = {CONV_ALGO_DEFAULT, 0};
+      model.ops.push_back(op);
+    } else if (keyword == "quantize") {
+      OpDesc op;
+      op.type = keyword;
+      op.params.resize(1);
+      if (!(tokens >> op.name >> op.input >> op.output >> op.params[0]))
+        fail("expect <op> <input> <output> <strategy>");
+      model.ops.push_back(op);
+    } else if (keyword == "activation") {
+      OpDesc op;
+      op.type = keyword;
+      op.alpha = 0.f;
+      std::string type;
+      if (!(tokens >> op.name >> op.input >> op.output >> type))
+        fail("expect <op> <input> <output> <activation>");
+      for (auto& entry : kActivationTable) {
+        if (type == entry.name)
+          op.params.push_back(entry.type);
+      }
+      if (op.params.empty())
+        fail("unknown activation " + type);
+      if (op.params[0] == ACTIVATION_LEAKY_RELU && !(tokens >> op.alpha))
+        fail("expect leaky_relu <alpha>");
+      model.ops.push_back(op);
+    } else if (keyword == "pool") {
+      OpDesc op;
+      op.type = keyword;
+      op.params.resize(7, -1);
+      std::string type;
+      if (!(tokens >> op.name >> op.input >> op.output >> type >>
+            op.params[1] >> op.params[2] >> op.params[3] >> op.params[4] >>
+            op.params[5] >> op.params[6]))
+        fail("expect <op> <input> <output> (max | average) "
+             "<kw> <kh> <sw> <sh> <pw> <ph>");
+      for (auto& entry : kPoolTable) {
+        if (type == entry.name)
+          op.params[0] = entry.type;
+      }
+      if (op.params[0] < 0)
+        fail("unknown pool " + type);
+      model.ops.push_back(op);
+    } else if (keyword == "output") {
+      tokens >> model.output;
+    } else {
+      fail("unknown statement " + keyword);
+    }
+  }
+
+  if (model.name.empty() || model.input.empty() || model.output.empty())
+    throw std::runtime_error(path + ": model, input and output are required");
+  for (auto& op : model.ops) {
+    model.tensor(op.input);
+    model.tensor(op.output);
+    if (!op.weight.empty() && !model.tensor(op.weight).is_const)
+      throw std::runtime_error(op.name + ": weight must be const");
+    if (!op.bias.empty() && !model.tensor(op.bias).is_const)
+      throw std::runtime_error(op.name + ": bias must be const");
+    if (op.type == "kpu_conv" && (model.tensor(op.weight).type == INT4 ||
+                                  model.tensor(op.weight).compress_block))
+      throw std::runtime_error(op.name +
+                               ": the KPU has no int4 or compressed weights");
+    if (!op.bias.empty() && model.tensor(op.bias).compress_block)
+      throw std::runtime_error(op.name + ": bias can not be compressed");
+    const DataType input_type = model.tensor(op.input).type;
+    if ((op.type == "activation" || op.type == "pool") &&
+        (input_type != model.tensor(op.output).type ||
+         (input_type != FLOAT32 && input_type != UINT8)))
+      throw std::runtime_error(op.name + ": " + op.type + " takes float32 "
+                               "or uint8 tensors of one type");
+    if ((op.type == "kpu_conv" || (op.type == "conv" &&
+         model.tensor(op.weight).type != FLOAT16)) && input_type != UINT8)
+      throw std::runtime_error(op.name + ": integer convs take uint8 input");
+    if ((op.type == "kpu_conv" || (op.type == "conv" &&
+         model.tensor(op.weight).type != FLOAT16)) &&
+        model.tensor(op.output).type != UINT8 &&
+        model.tensor(op.output).type != FLOAT32)
+      throw std::runtime_error(op.name + ": integer convs write uint8 or "
+                               "float32 output");
+  }
+  model.tensor(model.output);
+
+  // the KPU moves its activations in DMA bursts of KPU_ROW_ALIGN bytes
+  for (auto& op : model.ops) {
+    if (op.type != "kpu_conv")
+      continue;
+    for (auto& t : model.tensors) {
+      if (t.name == op.input || t.name == op.output)
+        t.alignment = KPU_ROW_ALIGN;
+    }
+  }
+  return model;
+}
+
+static void writeFile(const std::string& path, const std::string& text) {
+  std::ofstream out(path);
+  if (!out)
+    throw std::runtime_error("can not write " + path);
+  out << text;
+}
+
+static std::string emitModelData(const ModelDesc& model) {
+  std::string guard = "COMPILED_" + model.name + "_MODEL_DATA_HPP_";
+  for (auto& ch : guard)
+    ch = toupper(ch);
+
+  std::ostringstream out;
+  out << "// Auto generated by RVTensor_compiler\n\n"
+      << "#ifndef " << guard << "\n#define " << guard << "\n"
+      << "namespace RVTensor {\n\n";
+  for (auto& t : model.tensors) {
+    if (!t.is_const)
+      continue;
+    out << "static uint8_t " << t.name
+        << "_data[] __attribute__((aligned(128))) = {\n";
+    for (size_t i = 0; i < t.data.size(); i++) {
+      char byte[8];
+      snprintf(byte, sizeof(byte), "0x%02x,", t.data[i]);
+      out << byte << ((i % 16 == 15 || i + 1 == t.data.size()) ? "\n" : " ");
+    }
+    out << "};\n\n";
+    if (t.channel_scales.empty())
+      continue;
+    out << "static const float " << t.name << "_scales[] = {\n";
+    for (size_t i = 0; i < t.channel_scales.size(); i++) {
+      out << floatLiteral(t.channel_scales[i])
+          << ((i % 4 == 3 || i + 1 == t.channel_scales.size()) ? ",\n"
+                                                               : ", ");
+    }
+    out << "};\n\n";
+  }
+
+  // static quantize params, rewritten by rvtensor_calibrate
+  out << "// RVTensor calibration begin\n";
+  for (auto& t : model.tensors) {
+    if (t.is_const)
+      continue;
+    float min, max;
+    quantizedRange(t, &min, &max);
+    out << "static const float " << t.name << "_min_range = "
+        << floatLiteral(min) << ";\n"
+        << "static const float " << t.name << "_max_range = "
+        << floatLiteral(max) << ";\n"
+        << "static const float " << t.name << "_scale = "
+        << floatLiteral(t.scale) << ";\n"
+        << "static const int32_t " << t.name << "_zero_point = "
+        << t.zero_point << ";\n";
+  }
+  out << "// RVTensor calibration end\n\n"
+      << "}\n#endif // " << guard << "\n";
+  return out.str();
+}
+
+static void emitConstTensor(std::ostringstream& out, const TensorDesc& t) {
+  out << "  FlashTensor::sptr " << t.name << " =\n"
+      << "    FlashTensor::create(" << t.n << ", " << t.c << ", " << t.h
+      << ", " << t.w << ", "
+      << (t.compress_block ? "" : t.name + "_data, ") << t.element_size
+      << "u);\n"
+      << "  " << t.name << "->setDataType(" << dataTypeEnum(t.type) << ");\n"
+      << "  " << t.name << "->setQuantizer(" << floatLiteral(t.scale) << ", "
+      << t.zero_point << ");\n";
+  if (t.compress_block) {
+    out << "  " << t.name << "->bindCompressedData(" << t.name << "_data, "
+        << "sizeof(" << t.name << "_data));\n";
+  }
+  if (!t.channel_scales.empty()) {
+    out << "  " << t.name << "->bindChannelScales(" << t.name << "_scales, "
+        << t.channel_scales.size() << ");\n";
+  }
+}
+
+static std::string emitOp(const ModelDesc& model, const OpDesc& op) {
+  const TensorDesc& input = model.tensor(op.input);
+  const TensorDesc& output = model.tensor(op.output);
+  std::ostringstream out;
+  out << "static void " << op.name << "_execute(RamTensor::sptr input_0,\n"
+      << "    RamTensor::sptr output_0) {\n";
+
+  if (op.type == "quantize") {
+    out << "  QuantizeParam " << op.name << "_param = {"
+        << input.element_size << ", " << output.element_size
+        << ", static_cast<QuantizeStrategy>(" << op.params[0]
+        << "), true};\n"
+        << "  QuantizeOp::sptr " << op.name << " = QuantizeOp::create("
+        << op.name << "_param,\n        input_0, output_0);\n"
+        << "  " << op.name << "->run();\n}\n";
+    return out.str();
+  }
+  if (op.type == "activation") {
+    out << "  ActivationParam " << op.name << "_param = {"
+        << "static_cast<ActivationType>(" << op.params[0] << "), "
+        << floatLiteral(op.alpha) << "};\n"
+        << "  ActivationOp::sptr " << op.name << " = ActivationOp::create("
+        << op.name << "_param,\n        input_0, output_0);\n"
+        << "  " << op.name << "->run();\n}\n";
+    return out.str();
+  }
+  if (op.type == "pool") {
+    const std::vector<int>& p = op.params;
+    out << "  PoolParam " << op.name << "_param = {"
+        << "static_cast<PoolType>(" << p[0] << "), " << p[1] << ", " << p[2]
+        << ", " << p[3] << ", " << p[4] << ", " << p[5] << ", " << p[6]
+        << "};\n"
+        << "  PoolOp::sptr " << op.name << " = PoolOp::create("
+        << op.name << "_param,\n        input_0, output_0);\n"
+        << "  " << op.name << "->run();\n}\n";
+    return out.str();
+  }
+
+  const TensorDesc& weight = model.tensor(op.weight);
+  emitConstTensor(out, weight);
+  std::string bias = "nullptr";
+  if (!op.bias.empty()) {
+    emitConstTensor(out, model.tensor(op.bias));
+    bias = op.bias;
+  }
+  const std::vector<int>& p = op.params;
+
+  if (op.type == "conv" && weight.type != FLOAT16 && weight.type != INT4 &&
+      !weight.compress_block && op.tuning.algorithm == CONV_ALGO_DEFAULT) {
+    // all shapes are compile time constants of the kernel
+    out << "  typedef StaticConvOp<" << input.n << ", " << input.c << ", "
+        << input.h << ", " << input.w << ", " << weight.n << ", "
+        << weight.h << ", " << weight.w << ",\n"
+        << "      " << p[1] << ", " << p[0] << ", " << p[5] << ", " << p[4]
+        << ", " << p[3] << ", " << p[2] << ", " << cTypeName(weight.type)
+        << "> " << op.name << "_op;\n"
+        << "  " << op.name << "_op::sptr " << op.name << " = " << op.name
+        << "_op::create(\n        input_0, output_0, " << weight.name
+        << ", " << bias << ");\n";
+  } else if (op.type == "conv") {
+    // float16, int4 and compressed weights and tuned layers run on
+    // CPUConvOp
+    out << "  ConvParam " << op.name << "_param = {" << p[0] << ", " << p[1]
+        << ", " << p[2] << ", " << p[3] << ", " << p[4] << ", " << p[5]
+        << (weight.type == FLOAT16 ? ", false};\n" : ", true};\n")
+        << "  CPUConvOp::sptr " << op.name << " = CPUConvOp::create("
+        << op.name << "_param,\n        input_0, output_0, " << weight.name
+        << ", " << bias << ");\n";
+    if (op.tuning.algorithm != CONV_ALGO_DEFAULT) {
+      out << "  " << op.name << "->setTuning({static_cast<ConvAlgorithm>("
+          << op.tuning.algorithm << "), " << op.tuning.tile << "});\n";
+    }
+  } else {
+    out << "  ConvParam " << op.name << "_param = {" << p[0] << ", " << p[1]
+        << ", " << p[2] << ", " << p[3] << ", " << p[4] << ", " << p[5]
+        << ", true};\n"
+        << "#if RVTENSOR_KENDRYTE\n"
+        << "  KPUConvOp::sptr " << op.name << " = KPUConvOp::create("
+        << op.name << "_param,\n        input_0, output_0, " << weight.name
+        << ", " << bias << ");\n"
+        << "#else\n"
+        << "  CPUConvOp::sptr " << op.name << " = CPUConvOp::create("
+        << op.name << "_param,\n        input_0, output_0, " << weight.name
+        << ", " << bias << ");\n"
+        << "#endif\n";
+  }
+  out << "  " << op.name << "->run();\n}\n";
+  return out.str();
+}
+
+/**
+ * float32 reference pass for rvtensor_calibrate: the uint8 outputs of
+ * conv, activation and pool ops become float32 tensors holding their real
+ * values, quantize ops scan their input, and ops reading a uint8 input get
+ * a copy quantized by its own range; no calibrated range is used but the
+ * model input's
+ */
+static std::string emitModelCalibrate(const ModelDesc& model) {
+  std::set<std::string> promoted;
+  for (auto& op : model.ops) {
+    if (op.type != "quantize" && model.tensor(op.output).type == UINT8)
+      promoted.insert(op.output);
+  }
+
+  // the ops first: the cast helper is emitted when some op needs it
+  std::ostringstream ops;
+  bool cast = false;
+  for (auto& op : model.ops) {
+    const TensorDesc& input = model.tensor(op.input);
+    const TensorDesc& output = model.tensor(op.output);
+    std::string source = op.input;
+    if ((op.type == "activation" || op.type == "pool") &&
+        promoted.count(op.output) && !promoted.count(op.input)) {
+      source = "calibrationCast(" + op.input +
+               ", AFFINE_DEQUANTIZE_UINT8TOFLOAT32, 4u)";
+    } else if (op.type != "activation" && op.type != "pool" &&
+               promoted.count(op.input)) {
+      source = "calibrationCast(" + op.input +
+               ", AFFINE_QUANTIZE_FLOAT32TOUINT8, 1u)";
+    }
+    cast = cast || source != op.input;
+    if (op.type == "quantize") {
+      ops << "  QuantizeParam " << op.name << "_param = {"
+          << input.element_size << ", " << output.element_size
+          << ", static_cast<QuantizeStrategy>(" << op.params[0]
+          << "), false};\n"
+          << "  QuantizeOp::create(" << op.name << "_param, " << source
+          << ", " << op.output << ")->run();\n";
+    } else {
+      ops << "  " << op.name << "_execute(" << source << ", " << op.output
+          << ");\n";
+    }
+  }
+
+  std::ostringstream out;
+  out << "#if !RVTENSOR_KENDRYTE\n";
+  if (cast) {
+    out << "static RamTensor::sptr calibrationCast(RamTensor::sptr input,\n"
+        << "    QuantizeStrategy strategy, size_t element_size) {\n"
+        << "  RamTensor::sptr output = RamTensor::create(input->n_batch,\n"
+        << "      input->channel, input->height, input->width, "
+        << "element_size);\n"
+        << "  QuantizeParam param = {static_cast<int>(input->element_size),"
+        << "\n      static_cast<int>(element_size), strategy, false};\n"
+        << "  QuantizeOp::create(param, input, output)->run();\n"
+        << "  return output;\n}\n\n";
+  }
+  out << "RamTensor::sptr " << model.name << "_model_calibrate("
+      << "RamTensor::sptr " << model.input << ") {\n";
+  for (auto& t : model.tensors) {
+    if (t.is_const)
+      continue;
+    const bool real = promoted.count(t.name) != 0;
+    if (!t.is_input) {
+      out << "  RamTensor::sptr " << t.name << " = RamTensor::create("
+          << t.n << ", " << t.c << ", " << t.h << ", " << t.w << ", "
+          << (real ? 4 : t.element_size) << "u);\n"
+          << "  " << t.name << "->setDataType("
+          << dataTypeEnum(real ? FLOAT32 : t.type) << ");\n";
+    }
+    out << "  " << t.name << "->setName(\"" << t.name << "\");\n";
+    if (!real) {
+      out << "  " << t.name << "->setQuantizeParams(" << t.name
+          << "_min_range,\n      " << t.name << "_max_range, " << t.name
+          << "_scale, " << t.name << "_zero_point);\n";
+    }
+  }
+  out << "\n" << ops.str();
+  out << "\n  return " << model.output << ";\n}\n"
+      << "#endif  // !RVTENSOR_KENDRYTE\n\n";
+  return out.str();
+}
+
+static std::string emitModelExecute(const ModelDesc& model) {
+  std::ostringstream out;
+  out << "// Auto generated by RVTensor_compiler\n\n"
+      << "#include \"include/core/tensor.hpp\"\n"
+      << "#include \"include/core/types.hpp\"\n"
+      << "#include \"include/ops/activation.hpp\"\n"
+      << "#include \"include/ops/conv.hpp\"\n"
+      << "#include \"include/ops/conv_static.hpp\"\n"
+      << "#include \"include/ops/pool.hpp\"\n"
+      << "#include \"include/ops/quantize.hpp\"\n"
+      << "#if RVTENSOR_KENDRYTE\n"
+      << "#include \"include/ops/kpu/kpu_conv.hpp\"\n"
+      << "#endif\n"
+      << "#include \"model_execute.hpp\"\n"
+      << "#include \"" << model.name << "_model_data.hpp\"\n\n"
+      << "namespace RVTensor {\n\n";
+  for (auto& op : model.ops)
+    out << emitOp(model, op) << "\n";
+
+  out << "RamTensor::sptr " << model.name << "_model_execute("
+      << "RamTensor::sptr " << model.input
+      << ",\n    RamTensor::sptr output) {\n";
+  for (auto& t : model.tensors) {
+    if (t.is_const)
+      continue;
+    if (!t.is_input) {
+      out << "  RamTensor::sptr " << t.name << " = "
+          << (t.name == model.output ? "output ? output :\n      " : "")
+          << "RamTensor::create(" << t.n << ", " << t.c << ", " << t.h
+          << ", " << t.w << ", " << t.element_size << "u"
+          << (t.alignment ? ", " + std::to_string(t.alignment) + "u" : "")
+          << ");\n"
+          << "  " << t.name << "->setDataType(" << dataTypeEnum(t.type)
+          << ");\n";
+    }
+    out << "  " << t.name << "->setName(\"" << t.name << "\");\n"
+        << "  " << t.name << "->setQuantizeParams(" << t.name
+        << "_min_range,\n      " << t.name << "_max_range, " << t.name
+        << "_scale, " << t.name << "_zero_point);\n";
+  }
+  out << "\n";
+  for (auto& op : model.ops)
+    out << "  " << op.name << "_execute(" << op.input << ", " << op.output
+        << ");\n";
+  out << "\n  return " << model.output << ";\n}\n\n"
+      << emitModelCalibrate(model)
+      << "} // namespace RVTensor\n";
+  return out.str();
+}
+
+/**
+ * replace the declaration of an earlier compile starting with prefix, or
+ * add decl at the end of the namespace
+ */
+static void declare(std::string* text, const std::string& prefix,
+                    const std::string& decl, const std::string& path) {
+  size_t begin = text->find(prefix);
+  if (begin != std::string::npos) {
+    size_t end = text->find(";\n", begin);
+    if (end == std::string::npos)
+      throw std::runtime_error("unknown layout of " + path);
+    text->replace(begin, end + 2 - begin, decl);
+    return;
+  }
+  size_t brace = text->rfind("\n}", text->rfind("#endif"));
+  if (brace == std::string::npos)
+    throw std::runtime_error("unknown layout of " + path);
+  text->insert(brace + 1, decl);
+}
+
+static void declareModel(const ModelDesc& model, const std::string& path) {
+  const std::string execute = "RamTensor::sptr " + model.name +
+                              "_model_execute(";
+  const std::string calibrate = "RamTensor::sptr " + model.name +
+                                "_model_calibrate(";
+  std::string text;
+  std::ifstream in(path);
+  if (in) {
+    std::stringstream buf;
+    buf << in.rdbuf();
+    text = buf.str();
+  } else {
+    text = "// Auto generated by RVTensor_compiler\n\n"
+           "#ifndef COMPILED_MODEL_EXECUTE_HPP_\n"
+           "#define COMPILED_MODEL_EXECUTE_HPP_\n"
+           "#include \"include/core/tensor.hpp\"\n"
+           "namespace RVTensor {\n"
+           "}\n"
+           "#endif // COMPILED_MODEL_EXECUTE_HPP_\n";
+  }
+  declare(&text, execute, execute + "RamTensor::sptr input_" + model.name +
+          "_0,\n    RamTensor::sptr output = nullptr);\n", path);
+  // float32 reference pass of rvtensor_calibrate, host builds only
+  declare(&text, calibrate, calibrate + "RamTensor::sptr input_" +
+          model.name + "_0);\n", path);
+  writeFile(path, text);
+}
+
+void emitCompiledModel(const ModelDesc& model, const std::string& dir) {
+  writeFile(dir + "/" + model.name + "_model_data.hpp",
+            emitModelData(model));
+  writeFile(dir + "/" + model.name + "_model_execute.cpp",
+            emitModelExecute(model));
+  declareModel(model, dir + "/model_execute.hpp");
+}
+
+int applyConvTuning(ModelDesc* model, const std::string& path) {
+  ConvTuner& tuner = ConvTuner::instance();
+  tuner.clear();
+  tuner.load(path);
+  int tuned = 0;
+  for (auto& op : model->ops) {
+    if (op.type != "conv")
+      continue;
+    const TensorDesc& input = model->tensor(op.input);
+    const TensorDesc& weight = model->tensor(op.weight);
+    if ((weight.type != UINT8 && weight.type != INT8) ||
+        weight.compress_block) {
+      continue;
+    }
+    const std::vector<int>& p = op.params;
+    const ConvParam param = {p[0], p[1], p[2], p[3], p[4], p[5], true};
+    if (tuner.find(convTuningKey(weight.type, input.c, input.h, input.w,
+                                 weight.n, weight.h, weight.w, param),
+                   &op.tuning)) {
+      tuned++;
+    }
+  }
+  return tuned;
+}
+
+static uint32_t alignBlob(size_t offset) {
+  return static_cast<uint32_t>((offset + MODEL_BLOB_ALIGN - 1) /
+                               MODEL_BLOB_ALIGN * MODEL_BLOB_ALIGN);
+}
+
+void emitSerializedModel(const ModelDesc& model, const std::string& path) {
+  std::map<std::string, uint32_t> index;
+  for (size_t i = 0; i < model.tensors.size(); i++)
+    index[model.tensors[i].name] = static_cast<uint32_t>(i);
+
+  ModelFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MODEL_FILE_MAGIC;
+  header.version = MODEL_FILE_VERSION;
+  header.tensor_count = static_cast<uint32_t>(model.tensors.size());
+  header.op_count = static_cast<uint32_t>(model.ops.size());
+  header.tensor_offset = sizeof(ModelFileHeader);
+  header.op_offset = header.tensor_offset +
+                     header.tensor_count * sizeof(ModelFileTensor);
+  header.blob_offset = alignBlob(header.op_offset +
+                                 header.op_count * sizeof(ModelFileOp));
+  header.input_tensor = index.at(model.input);
+  header.output_tensor = index.at(model.output);
+
+  std::vector<ModelFileTensor> tensors(model.tensors.size());
+  std::vector<uint8_t> blobs;
+  for (size_t i = 0; i < model.tensors.size(); i++) {
+    const TensorDesc& t = model.tensors[i];
+    ModelFileTensor& ft = tensors[i];
+    memset(&ft, 0, sizeof(ft));
+    strncpy(ft.name, t.name.c_str(), MODEL_NAME_LENGTH);
+    ft.n = t.n;
+    ft.c = t.c;
+    ft.h = t.h;
+    ft.w = t.w;
+    ft.element_size = static_cast<uint32_t>(t.element_size);
+    ft.data_type = t.type;
+    ft.kind = t.is_const ? MODEL_TENSOR_CONSTANT
+              : (t.is_input ? MODEL_TENSOR_INPUT : MODEL_TENSOR_ACTIVATION);
+    quantizedRange(t, &ft.min_range, &ft.max_range);
+    ft.scale = t.scale;
+    ft.zero_point = t.zero_point;
+    ft.alignment = static_cast<uint32_t>(t.alignment);
+    if (t.is_const) {
+      blobs.resize(alignBlob(blobs.size()));
+      ft.data_offset = header.blob_offset +
+                       static_cast<uint32_t>(blobs.size());
+      ft.data_size = static_cast<uint32_t>(t.data.size());
+      ft.compressed = t.compress_block ? 1 : 0;
+      blobs.insert(blobs.end(), t.data.begin(), t.data.end());
+    }
+    if (!t.channel_scales.empty()) {
+      blobs.resize(alignBlob(blobs.size()));
+      ft.channel_scale_offset = header.blob_offset +
+                                static_cast<uint32_t>(blobs.size());
+      const uint8_t* scales = reinterpret_cast<const uint8_t*>(
+                                t.channel_scales.data());
+      blobs.insert(blobs.end(), scales,
+                   scales + t.channel_scales.size() * sizeof(float));
+    }
+  }
+
+  std::vector<ModelFileOp> ops(model.ops.size());
+  for (size_t i = 0; i < model.ops.size(); i++) {
+    const OpDesc& op = model.ops[i];
+    ModelFileOp& fo = ops[i];
+    memset(&fo, 0, sizeof(fo));
+    for (uint32_t k = 0; k < MODEL_MAX_OP_TENSORS; k++) {
+      fo.inputs[k] = MODEL_NONE_INDEX;
+      fo.outputs[k] = MODEL_NONE_INDEX;
+    }
+    fo.input_count = 1;
+    fo.output_count = 1;
+    fo.inputs[0] = index.at(op.input);
+    fo.outputs[0] = index.at(op.output);
+    fo.weight = op.weight.empty() ? MODEL_NONE_INDEX : index.at(op.weight);
+    fo.bias = op.bias.empty() ? MODEL_NONE_INDEX : index.at(op.bias);
+    if (op.type == "quantize") {
+      fo.type = MODEL_OP_QUANTIZE;
+      fo.params[0] = static_cast<int32_t>(model.tensor(op.input).element_size);
+      fo.params[1] = static_cast<int32_t>(
+                       model.tensor(op.output).element_size);
+      fo.params[2] = op.params[0];
+      fo.params[3] = 1;
+    } else if (op.type == "activation") {
+      fo.type = MODEL_OP_ACTIVATION;
+      fo.params[0] = op.params[0];
+      memcpy(&fo.params[1], &op.alpha, sizeof(op.alpha));
+    } else if (op.type == "pool") {
+      fo.type = MODEL_OP_POOL;
+      for (int k = 0; k < 7; k++)
+        fo.params[k] = op.params[k];
+    } else {
+      fo.type = op.type == "conv" ? MODEL_OP_CONV : MODEL_OP_KPU_CONV;
+      for (int k = 0; k < 6; k++)
+        fo.params[k] = op.params[k];
+      fo.params[6] = model.tensor(op.weight).type == FLOAT16 ? 0 : 1;
+      if (op.type == "conv")
+        fo.params[7] = packConvTuning(op.tuning);
+    }
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+    throw std::runtime_error("can not write " + path);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(tensors.data()),
+            tensors.size() * sizeof(ModelFileTensor));
+  out.write(reinterpret_cast<const char*>(ops.data()),
+            ops.size() * sizeof(ModelFileOp));
+  std::vector<char> padding(header.blob_offset - header.op_offset -
+                            ops.size() * sizeof(ModelFileOp), 0);
+  out.write(padding.data(), padding.size());
+  out.write(reinterpret_cast<const char*>(blobs.data()), blobs.size());
+}
+
+}  // namespace RVTensor
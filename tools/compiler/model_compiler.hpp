@@ -0,0 +1,133 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#ifndef TOOLS_COMPILER_MODEL_COMPILER_HPP_
+#define TOOLS_COMPILER_MODEL_COMPILER_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "include/core/types.hpp"
+
+namespace RVTensor {
+
+/**
+ * Model description read by RVTensor_compiler, one statement per line:
+ *
+ *   model    <name>
+ *   input    <tensor> <n> <c> <h> <w> <type> [<scale> <zero_point>]
+ *   tensor   <tensor> <n> <c> <h> <w> <type> [<scale> <zero_point>]
+ *   const    <tensor> <n> <c> <h> <w> <type> [<scale> <zero_point>]
+ *            [scales <s0> ... <sn-1>] [compress <channels>]
+ *            (fill <v> | data <v0> <v1> ... | file <raw file>)
+ *   conv     <op> <input> <output> <weight> <bias|-> <sw> <sh> <dw> <dh>
+ *            <pw> <ph>
+ *   kpu_conv <op> <input> <output> <weight> <bias|-> <sw> <sh> <dw> <dh>
+ *            <pw> <ph>
+ *   quantize <op> <input> <output> <QuantizeStrategy>
+ *   activation <op> <input> <output> (relu | relu6 | leaky_relu <alpha> |
+ *            sigmoid | tanh)
+ *   pool     <op> <input> <output> (max | average) <kw> <kh> <sw> <sh>
+ *            <pw> <ph>
+ *   output   <tensor>
+ *
+ * <type> is one of float32 int32 uint16 int16 uint8 int8 float16 int4
+ * (const values are given as floats), '#' starts a comment. Tensors read or
+ * written by kpu_conv are KPU_ROW_ALIGN aligned; conv with float16 weights
+ * takes a float16 input, a float32 or float16 output and a float32 or
+ * float16 bias, the other convs a uint8 input (int8/int16 activations are
+ * dequantized first) and a uint8 or float32 output.
+ *
+ * scales are per output channel (n) quantize scales of a const. int4 is
+ * for conv weights only: values in [-7, 7] are packed two per byte (a raw
+ * file holds the packed bytes, see include/core/int4.hpp), the input is
+ * uint8 and there is no kpu_conv support. compress stores conv weights
+ * as a container of RLE blocks of <channels> output channels
+ * (include/core/weight_codec.hpp) that CPUConvOp decodes while it runs,
+ * two blocks at a time.
+ *
+ * activation takes float32 or uint8 tensors of the same type, uint8 ones
+ * go through a table of the 256 input levels (include/ops/activation.hpp).
+ * pool takes them as well; its windows are placed like conv kernels and
+ * count the taps inside the input only (include/ops/pool.hpp).
+ */
+struct TensorDesc {
+  std::string name;
+  int n, c, h, w;
+  DataType type;
+  size_t element_size;
+  float scale;
+  int32_t zero_point;
+  bool is_input;
+  bool is_const;
+  /// RamTensor alignment, 0 for MALLOC_ALIGN
+  size_t alignment;
+  /// raw little endian data of constants, packed for INT4
+  std::vector<uint8_t> data;
+  /// per batch item (output channel) scales of constants, empty for none
+  std::vector<float> channel_scales;
+  /// batch items per compressed block, 0 for plain data; data holds the
+  /// weight container then
+  int compress_block;
+};
+
+struct OpDesc {
+  std::string type;
+  std::string name;
+  std::string input;
+  std::string output;
+  std::string weight;
+  std::string bias;
+  /// conv: ConvParam order (sw sh dw dh pw ph); quantize: strategy;
+  /// activation: ActivationType; pool: PoolParam order
+  std::vector<int> params;
+  /// activation: slope of leaky_relu below 0
+  float alpha;
+  /// conv: entry of the tuning cache, CONV_ALGO_DEFAULT for none
+  ConvTuning tuning;
+};
+
+struct ModelDesc {
+  std::string name;
+  std::string input;
+  std::string output;
+  std::vector<TensorDesc> tensors;
+  std::vector<OpDesc> ops;
+
+  const TensorDesc& tensor(const std::string& tensor_name) const;
+};
+
+/**
+ * parse a model description file, throws std::runtime_error with the line
+ * number on errors
+ */
+ModelDesc parseModelDesc(const std::string& path);
+
+/**
+ * set the tuning of the uint8/int8 conv ops that have an entry in a
+ * tuning cache file (include/ops/conv_tuner.hpp), returns their number;
+ * tuned convs are emitted as CPUConvOps running the entry instead of
+ * StaticConvOps
+ */
+int applyConvTuning(ModelDesc* model, const std::string& path);
+
+/**
+ * emit <dir>/<model>_model_execute.cpp and <dir>/<model>_model_data.hpp,
+ * and declare the entry points in <dir>/model_execute.hpp:
+ * <model>_model_execute and <model>_model_calibrate, the float32 reference
+ * pass rvtensor_calibrate runs (host builds only)
+ */
+void emitCompiledModel(const ModelDesc& model, const std::string& dir);
+
+/**
+ * emit the serialized form (include/core/model_format.hpp)
+ */
+void emitSerializedModel(const ModelDesc& model, const std::string& path);
+
+}  // namespace RVTensor
+
+#endif  // TOOLS_COMPILER_MODEL_COMPILER_HPP_
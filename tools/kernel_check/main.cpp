@@ -0,0 +1,314 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+#include "include/ops/quantize_kernel.hpp"
+#include "include/ops/vector_kernel.hpp"
+
+using RVTensor::quantMax;
+using RVTensor::quantMin;
+
+/**
+ * Check the inner loops of include/ops/vector_kernel.hpp (and the x86
+ * strips behind them, include/ops/x86_kernel.hpp) against plain scalar
+ * loops over random rows of every length up to kMaxLength, strides and
+ * offsets. Integer and quantize results must be equal, float sums may be
+ * fused or not. Run it on every build: the host one at each
+ * RVTENSOR_X86_LEVEL and the riscv64 one under qemu-riscv64 at several
+ * vlen values. Exits with 1 on a mismatch.
+ */
+
+/// longer than a strip of e32m4 at vlen 1024 plus a tail
+static const int kMaxLength = 300;
+
+static std::mt19937 random_engine(1);
+
+static int randomInt(int lo, int hi) {
+  return std::uniform_int_distribution<int>(lo, hi)(random_engine);
+}
+
+static float randomFloat(float lo, float hi) {
+  return std::uniform_real_distribution<float>(lo, hi)(random_engine);
+}
+
+template<typename T>
+static std::vector<T> randomBytes(size_t n) {
+  std::vector<T> v(n);
+  for (size_t i = 0; i < n; i++)
+    v[i] = static_cast<T>(randomInt(std::numeric_limits<T>::min(),
+                                    std::numeric_limits<T>::max()));
+  return v;
+}
+
+static std::vector<float> randomFloats(size_t n, float lo, float hi) {
+  std::vector<float> v(n);
+  for (size_t i = 0; i < n; i++)
+    v[i] = randomFloat(lo, hi);
+  return v;
+}
+
+/**
+ * cases and mismatches of one kernel
+ */
+struct Result {
+  const char* name;
+  int cases;
+  int fails;
+};
+
+static std::vector<Result> results;
+
+static void report(const char* name, int cases, int fails) {
+  results.push_back({name, cases, fails});
+}
+
+/**
+ * a * x + y rounded once (fused) or twice
+ */
+static bool sumMatches(float got, float a, float x, float y) {
+  volatile float product = a * x;
+  return got == product + y || got == std::fma(a, x, y);
+}
+
+template<typename WT>
+static void checkDot(const char* name, int w_offset_max) {
+  int cases = 0, fails = 0;
+  for (int num = 0; num <= kMaxLength; num++) {
+    for (int stride = 1; stride <= 3; stride++) {
+      std::vector<uint8_t> x = randomBytes<uint8_t>(num * stride + 1);
+      std::vector<WT> w = randomBytes<WT>(num * stride + 1);
+      const int32_t x_offset = randomInt(0, 255);
+      const int32_t w_offset = randomInt(0, w_offset_max);
+      int32_t expected = 0;
+      for (int j = 0; j < num; j++)
+        expected += (x[j * stride] - x_offset) * (w[j * stride] - w_offset);
+      const int32_t got = RVTensor::dotKernel(x.data(), w.data(), num, stride,
+                                              x_offset, w_offset);
+      cases++;
+      fails += got != expected;
+    }
+  }
+  report(name, cases, fails);
+}
+
+static void checkMacRow() {
+  int cases = 0, fails = 0;
+  for (int num = 0; num <= kMaxLength; num++) {
+    for (int stride = 1; stride <= 3; stride++) {
+      std::vector<uint8_t> x = randomBytes<uint8_t>(num * stride + 1);
+      std::vector<int32_t> acc(num + 1);
+      for (int32_t& a : acc)
+        a = randomInt(-100000, 100000);
+      std::vector<int32_t> expected = acc;
+      const int32_t w = randomInt(-255, 255);
+      const int32_t x_offset = randomInt(0, 255);
+      for (int j = 0; j < num; j++)
+        expected[j] += w * (x[j * stride] - x_offset);
+      RVTensor::macRowKernel(acc.data(), x.data(), stride, w, x_offset, num);
+      cases++;
+      fails += acc != expected;
+    }
+  }
+  report("macRowKernel", cases, fails);
+}
+
+static void checkMacRow2() {
+  int cases = 0, fails = 0;
+  for (int num = 0; num <= kMaxLength; num++) {
+    std::vector<uint8_t> x0 = randomBytes<uint8_t>(num + 1);
+    std::vector<uint8_t> x1 = randomBytes<uint8_t>(num + 1);
+    std::vector<int32_t> acc(num + 1);
+    for (int32_t& a : acc)
+      a = randomInt(-100000, 100000);
+    std::vector<int32_t> expected = acc;
+    const int32_t w0 = randomInt(-255, 255);
+    const int32_t w1 = randomInt(-255, 255);
+    for (int j = 0; j < num; j++)
+      expected[j] += w0 * x0[j] + w1 * x1[j];
+    RVTensor::macRow2Kernel(acc.data(), x0.data(), w0, x1.data(), w1, num);
+    cases++;
+    fails += acc != expected;
+  }
+  report("macRow2Kernel", cases, fails);
+}
+
+static void checkAxpy() {
+  int cases = 0, fails = 0;
+  for (int num = 0; num <= kMaxLength; num++) {
+    std::vector<float> x = randomFloats(num + 1, -4.f, 4.f);
+    std::vector<float> y = randomFloats(num + 1, -4.f, 4.f);
+    const std::vector<float> y0 = y;
+    const float a = randomFloat(-2.f, 2.f);
+    RVTensor::axpyKernel(a, x.data(), y.data(), num);
+    bool ok = y[num] == y0[num];
+    for (int j = 0; j < num; j++)
+      ok = ok && sumMatches(y[j], a, x[j], y0[j]);
+    cases++;
+    fails += !ok;
+  }
+  report("axpyKernel", cases, fails);
+}
+
+static void checkLut() {
+  int cases = 0, fails = 0;
+  const std::vector<uint8_t> lut = randomBytes<uint8_t>(256);
+  for (int num = 0; num <= kMaxLength; num++) {
+    std::vector<uint8_t> src = randomBytes<uint8_t>(num + 1);
+    std::vector<uint8_t> dst(num + 1, 0), expected(num + 1, 0);
+    for (int i = 0; i < num; i++)
+      expected[i] = lut[src[i]];
+    RVTensor::lutKernel(lut.data(), src.data(), dst.data(), num);
+    cases++;
+    fails += dst != expected;
+  }
+  report("lutKernel", cases, fails);
+}
+
+static void checkClamp() {
+  int cases = 0, fails = 0;
+  for (int num = 0; num <= kMaxLength; num++) {
+    std::vector<float> src = randomFloats(num + 1, -8.f, 8.f);
+    std::vector<float> dst(num + 1, 0.f), expected(num + 1, 0.f);
+    const float lo = randomFloat(-6.f, 0.f);
+    const float hi = randomFloat(0.f, 6.f);
+    for (int i = 0; i < num; i++)
+      expected[i] = src[i] < lo ? lo : (src[i] > hi ? hi : src[i]);
+    RVTensor::clampKernel(src.data(), dst.data(), num, lo, hi);
+    cases++;
+    fails += dst != expected;
+  }
+  report("clampKernel", cases, fails);
+}
+
+static void checkRange() {
+  int cases = 0, fails = 0;
+  for (int num = 0; num <= kMaxLength; num++) {
+    std::vector<float> src = randomFloats(num, -100.f, 100.f);
+    float lo = randomFloat(-1.f, 0.f), hi = randomFloat(0.f, 1.f);
+    float expected_lo = lo, expected_hi = hi;
+    for (int i = 0; i < num; i++) {
+      expected_lo = src[i] < expected_lo ? src[i] : expected_lo;
+      expected_hi = src[i] > expected_hi ? src[i] : expected_hi;
+    }
+    RVTensor::rangeKernel(src.data(), num, &lo, &hi);
+    cases++;
+    fails += lo != expected_lo || hi != expected_hi;
+  }
+  report("rangeKernel", cases, fails);
+}
+
+template<typename T>
+static T saturateRef(float v, float lo, float hi) {
+  v = v < lo ? lo : (v > hi ? hi : v);
+  return static_cast<T>(std::lrint(v));
+}
+
+template<typename T>
+static void checkQuantize(const char* name) {
+  int cases = 0, fails = 0;
+  const float lo = quantMin<T>(false);
+  const float hi = quantMax<T>();
+  for (int num = 0; num <= kMaxLength; num++) {
+    // half steps of the values and the scale hit the ties of the rounding
+    std::vector<float> src(num + 1);
+    for (float& v : src)
+      v = randomInt(-600, 600) * 0.5f;
+    std::vector<T> dst(num + 1, 0), expected(num + 1, 0);
+    const float inv_scale = randomInt(1, 4) * 0.5f;
+    const float zero = static_cast<float>(randomInt(0, 10));
+    for (int i = 0; i < num; i++)
+      expected[i] = saturateRef<T>(std::fma(src[i], inv_scale, zero), lo, hi);
+    RVTensor::quantizeKernel(src.data(), dst.data(), num, inv_scale, zero);
+    cases++;
+    fails += dst != expected;
+  }
+  report(name, cases, fails);
+}
+
+template<typename T>
+static void checkDequantize(const char* name) {
+  int cases = 0, fails = 0;
+  for (int num = 0; num <= kMaxLength; num++) {
+    std::vector<T> src = randomBytes<T>(num + 1);
+    std::vector<float> dst(num + 1, 0.f), expected(num + 1, 0.f);
+    const float scale = randomFloat(0.001f, 0.1f);
+    const float zero = static_cast<float>(randomInt(0, 10));
+    for (int i = 0; i < num; i++)
+      expected[i] = std::fma(static_cast<float>(src[i]), scale,
+                             -zero * scale);
+    RVTensor::dequantizeKernel(src.data(), dst.data(), num, scale, zero);
+    cases++;
+    fails += dst != expected;
+  }
+  report(name, cases, fails);
+}
+
+template<typename T>
+static void checkRequantize(const char* name) {
+  int cases = 0, fails = 0;
+  const float lo = quantMin<T>(false);
+  const float hi = quantMax<T>();
+  for (int num = 0; num <= kMaxLength; num++) {
+    std::vector<int32_t> acc(num + 1);
+    for (int32_t& a : acc)
+      a = randomInt(-200000, 200000);
+    std::vector<T> dst(num + 1, 0), expected(num + 1, 0);
+    const float multiplier = randomFloat(0.0001f, 0.002f);
+    const float zero = static_cast<float>(randomInt(0, 10));
+    for (int i = 0; i < num; i++) {
+      expected[i] = saturateRef<T>(std::fma(static_cast<float>(acc[i]),
+                                            multiplier, zero), lo, hi);
+    }
+    RVTensor::requantizeKernel(acc.data(), dst.data(), num, multiplier,
+                               zero);
+    cases++;
+    fails += dst != expected;
+  }
+  report(name, cases, fails);
+}
+
+int main() {
+#if RVTENSOR_RVV
+  // 4 registers of 32 bit lanes
+  printf("kernels: rvv, vlen %zu\n", __riscv_vsetvlmax_e32m4() * 32 / 4);
+#elif RVTENSOR_X86
+  static const char* const kLevels[] = {"scalar", "sse4.1", "avx2"};
+  printf("kernels: x86 %s\n", kLevels[RVTensor::x86Level()]);
+#else
+  printf("kernels: scalar\n");
+#endif
+
+  checkDot<uint8_t>("dotKernel<uint8_t>", 255);
+  checkDot<int8_t>("dotKernel<int8_t>", 0);
+  checkMacRow();
+  checkMacRow2();
+  checkAxpy();
+  checkLut();
+  checkClamp();
+  checkRange();
+  checkQuantize<uint8_t>("quantizeKernel<uint8_t>");
+  checkQuantize<int8_t>("quantizeKernel<int8_t>");
+  checkDequantize<uint8_t>("dequantizeKernel<uint8_t>");
+  checkDequantize<int8_t>("dequantizeKernel<int8_t>");
+  checkRequantize<uint8_t>("requantizeKernel<uint8_t>");
+  checkRequantize<int8_t>("requantizeKernel<int8_t>");
+
+  int fails = 0;
+  for (const Result& result : results) {
+    printf("%-28s %5d cases %5d mismatches\n", result.name, result.cases,
+           result.fails);
+    fails += result.fails;
+  }
+  printf(fails ? "FAILED\n" : "all kernels match the scalar loops\n");
+  return fails ? 1 : 0;
+}
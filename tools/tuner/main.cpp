@@ -0,0 +1,89 @@
+/*  The MIT License
+ *
+ *  Copyright (c) 2019, Institute of Software Chinese Academy of Sciences(ISCAS)
+ *  All rights reserved.
+ *
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include "include/core/model.hpp"
+#include "include/ops/conv.hpp"
+#include "include/ops/conv_tuner.hpp"
+
+using RVTensor::ConvTuner;
+using RVTensor::ConvTuning;
+
+static void usage(const char* argv0) {
+  std::cerr << "usage: " << argv0
+            << " <model.rvtm> <tuning_cache> [repeat]" << std::endl;
+}
+
+/**
+ * Benchmark the algorithms and tiles of every conv layer of a serialized
+ * model on this machine and add the fastest ones to a tuning cache; layers
+ * the cache already has are kept. The cache is used at runtime through
+ * ConvTuner::load or compiled in with RVTensor_compiler --tuning.
+ */
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 4) {
+    usage(argv[0]);
+    return 1;
+  }
+  const std::string cache = argv[2];
+  const int repeat = argc > 3 ? atoi(argv[3]) : 5;
+  if (repeat <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    // in tuning mode the model keeps the convs NCHW, where the tunings run
+    ConvTuner& tuner = ConvTuner::instance();
+    if (std::ifstream(cache))
+      tuner.load(cache);
+    tuner.setTuning(true, repeat);
+    RVTensor::Model::sptr model = RVTensor::Model::loadFile(argv[1]);
+
+    // the run time of the kernels does not depend on the input values
+    RVTensor::RamTensor::sptr layout = model->getInput();
+    RVTensor::RamTensor::sptr input = RVTensor::RamTensor::create(
+        layout->n_batch, layout->channel, layout->height, layout->width,
+        layout->element_size, layout->alignment);
+    input->setLayout(layout->layout);
+    std::mt19937 random(1);
+    uint8_t* data = reinterpret_cast<uint8_t*>(input->data_ptr);
+    if (input->element_size == 4) {
+      std::uniform_real_distribution<float> value(0.f, 1.f);
+      for (size_t i = 0; i < input->totalSize() / 4; i++)
+        reinterpret_cast<float*>(data)[i] = value(random);
+    } else {
+      for (size_t i = 0; i < input->totalSize(); i++)
+        data[i] = static_cast<uint8_t>(random());
+    }
+
+    model->bindInput(input);
+
+    model->compute();
+    tuner.setTuning(false);
+    tuner.save(cache);
+
+    for (auto& op : model->getOps()) {
+      auto conv = std::dynamic_pointer_cast<RVTensor::CPUConvOp>(op);
+      if (!conv || conv->tunings().size() < 2)
+        continue;
+      const ConvTuning tuning = conv->getTuning();
+      std::cout << conv->tuningKey() << ": "
+                << ConvTuner::algorithmName(tuning.algorithm) << " "
+                << tuning.tile << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}